@@ -0,0 +1,302 @@
+/*
+ * Adaptors and codecs generated from DIRECT_FIELDS / DIRECT_MSGPACK_ADAPTOR.
+ *
+ * Round trips ngps_output and a second sysDefs-typed struct (every integer width, signed and
+ * unsigned, plus SysBool) through the generated pack<>/convert<> and through DirectCodec in both
+ * encodings, on type extremes and a random trace, and compares the generated pack<> byte for byte
+ * with a hand-written field-by-field packer. Then times generated against hand-written pack and
+ * convert, and compact against fixed-width encode/decode.
+ *
+ * usage: adaptorBench [records] [rounds]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <limits>
+#include <random>
+#include <vector>
+#include "ngpsOutput.h"
+#include "ngpsTrace.h"
+#include "allocCount.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct track_status
+{
+    UTiny   zone = 0;
+    STiny   grade = 0;
+    SShort  cant = 0;
+    SLong   correction = 0;
+    ULong   distance = 0;
+    SysBool occupied = FALSE;
+    UShort  circuit = 0;
+
+    bool operator==(const track_status &rhs) const {
+        return zone == rhs.zone && grade == rhs.grade && cant == rhs.cant && correction == rhs.correction &&
+               distance == rhs.distance && occupied == rhs.occupied && circuit == rhs.circuit;
+    }
+    bool operator!=(const track_status &rhs) const { return !(rhs == *this); }
+};
+
+typedef DIRECT_FIELDS(track_status, zone, grade, cant, correction, distance, occupied, circuit) TrackStatusFields;
+DIRECT_MSGPACK_ADAPTOR(track_status, TrackStatusFields)
+
+typedef DirectCodec<track_status, TrackStatusFields> TrackStatusCodec;
+typedef DirectCodec<track_status, TrackStatusFields, DirectFixedEncoding> TrackStatusFixedCodec;
+
+static_assert(TrackStatusFixedCodec::maxSize == 1 + 2 + 2 + 3 + 1 + sizeof(SLong) + 1 + sizeof(ULong) + 1 + 3,
+              "fixed encoding size");
+
+/* The hand-written style the generated adaptors replace */
+struct ReferencePacker
+{
+    template <typename Stream>
+    static void pack(msgpack::packer<Stream> &o, const ngps_output &r)
+    {
+        o.pack_array(11);
+        o.pack(r.edge_id);
+        o.pack(r.offset);
+        o.pack(r.uncertainty);
+        o.pack(!!r.pos_valid);
+        o.pack(r.speed);
+        o.pack(!!r.speed_valid);
+        o.pack(!!r.gd0);
+        o.pack(!!r.reversing);
+        o.pack(!!r.stationary);
+        o.pack(r.accel);
+        o.pack(r.sensorCnt);
+    }
+
+    template <typename Stream>
+    static void pack(msgpack::packer<Stream> &o, const track_status &r)
+    {
+        o.pack_array(7);
+        o.pack(r.zone);
+        o.pack(r.grade);
+        o.pack(r.cant);
+        o.pack(r.correction);
+        o.pack(r.distance);
+        o.pack(!!r.occupied);
+        o.pack(r.circuit);
+    }
+
+    static ngps_output convert(const msgpack::object &o, const ngps_output &)
+    {
+        if (o.type != msgpack::type::ARRAY || o.via.array.size != 11) throw msgpack::type_error();
+        const msgpack::object *p = o.via.array.ptr;
+        return ngps_output(p[0].as<UShort>(), p[1].as<ULong>(), p[2].as<ULong>(), (SysBool)p[3].as<bool>(),
+                           p[4].as<ULong>(), (SysBool)p[5].as<bool>(), (SysBool)p[6].as<bool>(),
+                           (SysBool)p[7].as<bool>(), (SysBool)p[8].as<bool>(), p[9].as<SShort>(), p[10].as<UShort>());
+    }
+};
+
+static unsigned long failures = 0;
+
+#define CHECK(cond, what, i) \
+    do { if (!(cond)) { ++failures; fprintf(stderr, "%s failed at %zu\n", what, (size_t)(i)); } } while (0)
+
+template <typename Struct, typename Codec, typename FixedCodec>
+static void roundTrip(const std::vector<Struct> &values, const char *name)
+{
+    for (size_t i = 0; i < values.size(); ++i) {
+        const Struct &v = values[i];
+
+        msgpack::sbuffer generated;
+        msgpack::pack(generated, v);
+        msgpack::sbuffer reference;
+        msgpack::packer<msgpack::sbuffer> rp(reference);
+        ReferencePacker::pack(rp, v);
+        CHECK(generated.size() == reference.size() && memcmp(generated.data(), reference.data(), reference.size()) == 0,
+              name, i);
+
+        Struct converted;
+        msgpack::object_handle oh = msgpack::unpack(generated.data(), generated.size());
+        oh.get().convert(converted);
+        CHECK(converted == v, name, i);
+
+        char buf[FixedCodec::maxSize];
+        Struct decoded;
+        size_t used = 0;
+        size_t n = Codec::encode(v, buf, sizeof(buf));
+        CHECK(n == generated.size() && Codec::decode(buf, n, decoded, &used) == DIRECT_CODEC_OK && used == n &&
+              decoded == v, name, i);
+
+        // Fixed-width records decode through both codecs and through msgpack::unpack
+        n = FixedCodec::encode(v, buf, sizeof(buf));
+        CHECK(n == (size_t)FixedCodec::maxSize, name, i);
+        decoded = Struct();
+        CHECK(FixedCodec::decode(buf, n, decoded, &used) == DIRECT_CODEC_OK && decoded == v, name, i);
+        decoded = Struct();
+        CHECK(Codec::decode(buf, n, decoded, &used) == DIRECT_CODEC_OK && decoded == v, name, i);
+        msgpack::object_handle fh = msgpack::unpack(buf, n);
+        CHECK(fh.get().as<Struct>() == v, name, i);
+    }
+}
+
+template <typename T>
+static T pick(std::mt19937 &rng)
+{
+    switch (rng() % 4) {
+    case 0:
+        return std::numeric_limits<T>::min();
+    case 1:
+        return std::numeric_limits<T>::max();
+    case 2:
+        return (T)(rng() % 256 - 128);
+    default:
+        return (T)((uint64_t)rng() << 32 | rng());
+    }
+}
+
+static std::vector<track_status> makeStatusTrace(size_t count)
+{
+    std::mt19937 rng(20001);
+    std::vector<track_status> values(count);
+    for (size_t i = 0; i < count; ++i) {
+        track_status &s = values[i];
+        s.zone = pick<UTiny>(rng);
+        s.grade = pick<STiny>(rng);
+        s.cant = pick<SShort>(rng);
+        s.correction = pick<SLong>(rng);
+        s.distance = pick<ULong>(rng);
+        s.occupied = (rng() & 1) ? TRUE : FALSE;
+        s.circuit = pick<UShort>(rng);
+    }
+    return values;
+}
+
+static std::vector<ngps_output> ngpsExtremes()
+{
+    std::vector<ngps_output> values;
+    const ULong wide[] = {0, 0x7f, 0x80, 0xff, 0x100, 0xffff, 0x10000, 0xffffffffUL,
+                          std::numeric_limits<ULong>::max()};
+    const SShort accel[] = {std::numeric_limits<SShort>::min(), -129, -128, -33, -32, -1, 0, 127, 128,
+                            std::numeric_limits<SShort>::max()};
+    for (size_t w = 0; w < LENGTHOF(wide); ++w) {
+        for (size_t a = 0; a < LENGTHOF(accel); ++a) {
+            values.push_back(ngps_output((UShort)(w * 0x2000), wide[w], wide[LENGTHOF(wide) - 1 - w], (SysBool)(a & 1),
+                                         wide[(w + a) % LENGTHOF(wide)], (SysBool)(w & 1), TRUE, FALSE, (SysBool)(a & 1),
+                                         accel[a], std::numeric_limits<UShort>::max()));
+        }
+    }
+    return values;
+}
+
+template <typename Body>
+static double nsPerRecord(size_t records, unsigned int rounds, Body body)
+{
+    Clock::time_point start = Clock::now();
+    for (unsigned int r = 0; r < rounds; ++r) {
+        body();
+    }
+    std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+    return elapsed.count() / ((double)records * rounds);
+}
+
+int main(int argc, char **argv)
+{
+    size_t records = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+    unsigned int rounds = argc > 2 ? (unsigned int)strtoul(argv[2], NULL, 10) : 20;
+
+    std::vector<ngps_output> trace = makeNgpsTrace(records);
+    roundTrip<ngps_output, NgpsCodec, NgpsFixedCodec>(ngpsExtremes(), "ngps_output extremes");
+    roundTrip<ngps_output, NgpsCodec, NgpsFixedCodec>(trace, "ngps_output trace");
+    roundTrip<track_status, TrackStatusCodec, TrackStatusFixedCodec>(makeStatusTrace(records), "track_status");
+
+    // convert<> rejects what the hand-written adaptor rejected
+    msgpack::sbuffer shortArray;
+    msgpack::packer<msgpack::sbuffer> sp(shortArray);
+    sp.pack_array(10);
+    for (int k = 0; k < 10; ++k) {
+        sp.pack(k);
+    }
+    bool threw = false;
+    try {
+        msgpack::unpack(shortArray.data(), shortArray.size()).get().as<ngps_output>();
+    }
+    catch (const msgpack::type_error &) {
+        threw = true;
+    }
+    CHECK(threw, "short array rejected", 0);
+    printf("round trips:  %lu failures\n", failures);
+
+    std::vector<NgpsPackBuffer> wire(records);
+    std::vector<char> fixed(records * NgpsFixedCodec::maxSize);
+    for (size_t i = 0; i < records; ++i) {
+        msgpack::pack(wire[i], trace[i]);
+        NgpsFixedCodec::encode(trace[i], &fixed[i * NgpsFixedCodec::maxSize], NgpsFixedCodec::maxSize);
+    }
+    std::vector<ngps_output> out(records);
+    volatile size_t sink = 0;
+
+    double referencePackNs = nsPerRecord(records, rounds, [&]() {
+        for (size_t i = 0; i < records; ++i) {
+            NgpsPackBuffer pbuf;
+            msgpack::packer<NgpsPackBuffer> pk(pbuf);
+            ReferencePacker::pack(pk, trace[i]);
+            escape(pbuf.data());
+            sink = sink + pbuf.size();
+        }
+    });
+    double generatedPackNs = nsPerRecord(records, rounds, [&]() {
+        for (size_t i = 0; i < records; ++i) {
+            NgpsPackBuffer pbuf;
+            msgpack::pack(pbuf, trace[i]);
+            escape(pbuf.data());
+            sink = sink + pbuf.size();
+        }
+    });
+    double referenceConvertNs = nsPerRecord(records, rounds, [&]() {
+        for (size_t i = 0; i < records; ++i) {
+            msgpack::object_handle oh = msgpack::unpack(wire[i].data(), wire[i].size());
+            out[i] = ReferencePacker::convert(oh.get(), out[i]);
+        }
+    });
+    double generatedConvertNs = nsPerRecord(records, rounds, [&]() {
+        for (size_t i = 0; i < records; ++i) {
+            msgpack::object_handle oh = msgpack::unpack(wire[i].data(), wire[i].size());
+            oh.get().convert(out[i]);
+        }
+    });
+    double compactEncodeNs = nsPerRecord(records, rounds, [&]() {
+        for (size_t i = 0; i < records; ++i) {
+            char buf[NgpsCodec::maxSize];
+            sink = sink + NgpsCodec::encode(trace[i], buf, sizeof(buf));
+            escape(buf);
+        }
+    });
+    double fixedEncodeNs = nsPerRecord(records, rounds, [&]() {
+        for (size_t i = 0; i < records; ++i) {
+            char buf[NgpsFixedCodec::maxSize];
+            sink = sink + NgpsFixedCodec::encode(trace[i], buf, sizeof(buf));
+            escape(buf);
+        }
+    });
+    double compactDecodeNs = nsPerRecord(records, rounds, [&]() {
+        for (size_t i = 0; i < records; ++i) {
+            sink = sink + NgpsCodec::decode(wire[i].data(), wire[i].size(), out[i]);
+        }
+    });
+    double fixedDecodeNs = nsPerRecord(records, rounds, [&]() {
+        for (size_t i = 0; i < records; ++i) {
+            sink = sink + NgpsFixedCodec::decode(&fixed[i * NgpsFixedCodec::maxSize], NgpsFixedCodec::maxSize, out[i]);
+        }
+    });
+
+    size_t compactBytes = 0;
+    for (size_t i = 0; i < records; ++i) {
+        compactBytes += wire[i].size();
+    }
+    printf("records: %zu x %u rounds\n", records, rounds);
+    printf("pack     hand-written          %8.2f ns/record\n", referencePackNs);
+    printf("pack     generated             %8.2f ns/record (x%.2f)\n", generatedPackNs, referencePackNs / generatedPackNs);
+    printf("convert  hand-written          %8.2f ns/record\n", referenceConvertNs);
+    printf("convert  generated             %8.2f ns/record (x%.2f)\n", generatedConvertNs,
+           referenceConvertNs / generatedConvertNs);
+    printf("encode   compact / fixed       %8.2f / %.2f ns/record\n", compactEncodeNs, fixedEncodeNs);
+    printf("decode   compact / fixed       %8.2f / %.2f ns/record\n", compactDecodeNs, fixedDecodeNs);
+    printf("size     compact / fixed       %8.2f / %d bytes/record\n", (double)compactBytes / records,
+           (int)NgpsFixedCodec::maxSize);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,19 @@
+#ifndef ALLOCCOUNT_H
+#define ALLOCCOUNT_H
+
+/*
+ * Process-wide heap allocation counter for benchmarks. Linking allocCount.cpp
+ * interposes malloc/calloc/realloc (and therefore operator new) and counts calls.
+ */
+unsigned long allocCount();
+
+/*
+ * Make p escape, so the compiler cannot prove the memory behind it unused and drop the
+ * allocation (new/delete and malloc/free pairs may be elided when nothing reads the buffer).
+ */
+inline void escape(const void *p)
+{
+    asm volatile("" : : "r"(p) : "memory");
+}
+
+#endif //ALLOCCOUNT_H
@@ -0,0 +1,140 @@
+/*
+ * Receive-path decoding with a fresh zone per datagram (msgpack::unpack into an object_handle)
+ * against one reused UnpackArena:
+ *   - offline: decode a trace from memory, checking every record, reporting ns and heap
+ *     allocations per record
+ *   - loopback: UdpSequencedSender -> UdpSequencedReceiver (which decodes through an UnpackArena)
+ *     on one thread, batch by batch, counting heap allocations over the steady state (expected:
+ *     none) and records/s
+ *
+ * usage: arenaBench [records] [rounds]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <chrono>
+#include <vector>
+#include "unpackArena.h"
+#include "udpSequence.h"
+#include "allocCount.h"
+#include "ngpsTrace.h"
+#include "loopbackSocket.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct Encoded
+{
+    std::vector<char> bytes;
+    std::vector<size_t> offsets;        /* offsets.size() == records + 1 */
+};
+
+static Encoded encodeTrace(const std::vector<ngps_output> &trace)
+{
+    Encoded e;
+    e.offsets.push_back(0);
+    for (size_t i = 0; i < trace.size(); ++i) {
+        NgpsPackBuffer buf;
+        msgpack::pack(buf, trace[i]);
+        e.bytes.insert(e.bytes.end(), buf.data(), buf.data() + buf.size());
+        e.offsets.push_back(e.bytes.size());
+    }
+    return e;
+}
+
+template <typename DecodeOne>
+static unsigned long runOffline(const char *name, const std::vector<ngps_output> &trace, const Encoded &e,
+                                 unsigned long rounds, DecodeOne decodeOne)
+{
+    unsigned long bad = 0;
+    ngps_output r;
+    unsigned long allocs = allocCount();
+    Clock::time_point start = Clock::now();
+    for (unsigned long round = 0; round < rounds; ++round) {
+        for (size_t i = 0; i < trace.size(); ++i) {
+            decodeOne(&e.bytes[e.offsets[i]], e.offsets[i + 1] - e.offsets[i], r);
+            if (!(r == trace[i])) {
+                ++bad;
+            }
+        }
+    }
+    std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+    allocs = allocCount() - allocs;
+    unsigned long records = rounds * trace.size();
+    printf("%-16s %8.1f ns/record %8.3f allocs/record %lu bad\n", name, elapsed.count() / records,
+           (double)allocs / records, bad);
+    return bad;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long records = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+    unsigned long rounds = argc > 2 ? strtoul(argv[2], NULL, 10) : 10;
+
+    std::vector<ngps_output> trace = makeNgpsTrace(records);
+    Encoded e = encodeTrace(trace);
+    unsigned long offlineBad = 0;
+
+    offlineBad += runOffline("zone per record", trace, e, rounds, [](const char *data, size_t size, ngps_output &r) {
+        msgpack::object_handle oh = msgpack::unpack(data, size);
+        oh.get().convert(r);
+    });
+
+    UnpackArena arena;
+    offlineBad += runOffline("UnpackArena", trace, e, rounds, [&](const char *data, size_t size, ngps_output &r) {
+        arena.unpack(data, size).convert(r);
+    });
+
+    // Loopback through UdpSequencedReceiver; the first round warms up socket buffers, the arena
+    // and the sender's reorder buffer
+    sockaddr_in rxAddr, txAddr;
+    int rx = openLoopback(rxAddr);
+    int tx = openLoopback(txAddr);
+    const size_t batch = 32;
+    UdpSequencedSender sender(tx, rxAddr, 1);
+    UdpSequencedReceiver receiver(rx);
+    std::vector<NgpsEnvelope> out(batch);
+
+    unsigned long received = 0;
+    unsigned long bad = 0;
+    unsigned long allocs = 0;
+    Clock::time_point start = Clock::now();
+    for (unsigned long round = 0; round <= rounds; ++round) {
+        unsigned long before = allocCount();
+        if (round == 1) {
+            received = 0;
+            start = Clock::now();
+        }
+        for (size_t i = 0; i < trace.size(); i += batch) {
+            size_t count = MIN(batch, trace.size() - i);
+            for (size_t k = 0; k < count; ++k) {
+                sender.send(trace[i + k]);
+            }
+            size_t got = 0;
+            while (got < count) {
+                int n = receiver.receive(out.data(), (unsigned int)(count - got));
+                if (n <= 0) {
+                    break;
+                }
+                for (int k = 0; k < n; ++k) {
+                    if (!(out[k].payload == trace[i + got + k])) {
+                        ++bad;
+                    }
+                }
+                got += (size_t)n;
+            }
+            received += got;
+        }
+        if (round > 0) {
+            allocs += allocCount() - before;
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    printf("loopback         %8.2f Mrec/s %lu received, %lu bad, %lu decode errors, %lu heap allocations\n",
+           received / seconds / 1e6, received, bad, receiver.decodeErrors(), allocs);
+
+    close(rx);
+    close(tx);
+    return offlineBad == 0 && bad == 0 && allocs == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
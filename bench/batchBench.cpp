@@ -0,0 +1,160 @@
+/*
+ * Loopback benchmark: one sendto + recvfrom per ngps_output (the loop in main.cpp)
+ * against UdpBatchSender/UdpBatchReceiver (sendmmsg/recvmmsg) and against coalescing
+ * batchSize records into each datagram (UdpCoalescingSender/UdpCoalescingReceiver).
+ * Before timing, checks that a coalesced datagram cut off inside a record does not misframe the
+ * valid datagram after it; a failed check fails the run.
+ *
+ * usage: batchBench [messages] [batchSize]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <chrono>
+#include <vector>
+#include "udpBatch.h"
+#include "udpCoalesce.h"
+#include "loopbackSocket.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double runSingle(int tx, int rx, const sockaddr_in &dest, unsigned long messages)
+{
+    char buffer[MAXLINE];
+    ngps_output ngps;
+    ngps_output rt;
+
+    Clock::time_point start = Clock::now();
+    for (unsigned long i = 0; i < messages; ++i) {
+        ngps.offset = 500 + i;
+
+        msgpack::sbuffer sbuf;
+        msgpack::pack(sbuf, ngps);
+        sendto(tx, sbuf.data(), sbuf.size(), 0, (const struct sockaddr *)&dest, sizeof(dest));
+
+        ssize_t n = recvfrom(rx, buffer, MAXLINE, 0, NULL, NULL);
+        msgpack::object_handle oh = msgpack::unpack(buffer, (size_t)n);
+        oh.get().convert(rt);
+    }
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    return messages / elapsed.count();
+}
+
+static double runBatched(int tx, int rx, const sockaddr_in &dest, unsigned long messages, unsigned int batchSize)
+{
+    UdpBatchConfig config;
+    config.batchSize = batchSize;
+    UdpBatchSender sender(tx, dest, config);
+    UdpBatchReceiver receiver(rx, config);
+    std::vector<ngps_output> rt(batchSize);
+    ngps_output ngps;
+
+    Clock::time_point start = Clock::now();
+    unsigned long received = 0;
+    for (unsigned long i = 0; i < messages; ++i) {
+        ngps.offset = 500 + i;
+        if (sender.send(ngps) > 0 || i + 1 == messages) {
+            sender.flush();
+            while (received <= i) {
+                int n = receiver.receive(rt.data(), batchSize);
+                if (n <= 0) {
+                    fprintf(stderr, "batched receive stalled after %lu messages\n", received);
+                    return 0.0;
+                }
+                received += n;
+            }
+        }
+    }
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    return received / elapsed.count();
+}
+
+static double runCoalesced(int tx, int rx, const sockaddr_in &dest, unsigned long messages, unsigned int perDatagram)
+{
+    UdpCoalescingSender sender(tx, dest);
+    UdpCoalescingReceiver receiver(rx);
+    std::vector<ngps_output> rt(COALESCE_MAX_RECORDS);
+    ngps_output ngps;
+
+    Clock::time_point start = Clock::now();
+    unsigned long received = 0;
+    for (unsigned long i = 0; i < messages; ++i) {
+        ngps.offset = 500 + i;
+        int sent = sender.add(ngps);
+        if (sent > 0 || sender.pending() == perDatagram || i + 1 == messages) {
+            sender.flush();
+            while (received <= i) {
+                int n = receiver.receive(rt.data(), (unsigned int)rt.size());
+                if (n <= 0) {
+                    fprintf(stderr, "coalesced receive stalled after %lu messages\n", received);
+                    return 0.0;
+                }
+                received += n;
+            }
+        }
+    }
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    return received / elapsed.count();
+}
+
+/* A datagram that ends inside its second record, then a valid one: the valid records must decode */
+static SysBool checkTruncated(int tx, int rx, const sockaddr_in &dest)
+{
+    ngps_output first, second;
+    first.offset = 1000;
+    second.offset = 2000;
+
+    char datagram[MAXLINE];
+    datagram[0] = (char)COALESCE_MAGIC;
+    datagram[1] = 2;
+    datagram[2] = 0;
+    datagram[3] = 0;
+    size_t used = COALESCE_HEADER_SIZE;
+    NgpsPackBuffer pbuf;
+    msgpack::pack(pbuf, first);
+    msgpack::pack(pbuf, second);
+    memcpy(datagram + used, pbuf.data(), pbuf.size());
+    used += pbuf.size() - 3;
+    sendto(tx, datagram, used, 0, (const struct sockaddr *)&dest, sizeof(dest));
+
+    UdpCoalescingSender sender(tx, dest);
+    sender.add(first);
+    sender.add(second);
+    sender.flush();
+
+    UdpCoalescingReceiver receiver(rx);
+    ngps_output rt[COALESCE_MAX_RECORDS];
+    int n = receiver.receive(rt, LENGTHOF(rt));
+    SysBool ok = n == 1 && rt[0] == first ? TRUE : FALSE;
+    n = receiver.receive(rt, LENGTHOF(rt));
+    ok = ok && n == 2 && rt[0] == first && rt[1] == second ? TRUE : FALSE;
+    printf("truncated:  %s, %lu decode errors\n", ok ? "next datagram decoded" : "NEXT DATAGRAM MISFRAMED",
+           receiver.decodeErrors());
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long messages = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+    unsigned int batchSize = argc > 2 ? (unsigned int)strtoul(argv[2], NULL, 10) : 32;
+
+    sockaddr_in txAddr, rxAddr;
+    int tx = openLoopback(txAddr);
+    int rx = openLoopback(rxAddr);
+
+    SysBool ok = checkTruncated(tx, rx, rxAddr);
+    double single = runSingle(tx, rx, rxAddr, messages);
+    double batched = runBatched(tx, rx, rxAddr, messages, batchSize);
+    double coalesced = runCoalesced(tx, rx, rxAddr, messages, batchSize);
+
+    printf("messages:   %lu\n", messages);
+    printf("single:     %.0f msg/s\n", single);
+    printf("batch(%3u): %.0f msg/s (x%.2f)\n", batchSize, batched, single > 0 ? batched / single : 0.0);
+    printf("coal.(%3u): %.0f msg/s (x%.2f)\n", batchSize, coalesced, single > 0 ? coalesced / single : 0.0);
+
+    close(tx);
+    close(rx);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,70 @@
+#ifndef BENCHREPORT_H
+#define BENCHREPORT_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/*
+ * Named benchmark results, printed as an aligned table for people or as one JSON document for
+ * scripts comparing runs (e.g. a release against the previous one):
+ *
+ *     {"suite":"...","params":{"seed":20001,...},"results":[{"name":"pack.sbuffer","value":41.2,"unit":"ns/record"},...]}
+ *
+ * Names are stable keys; "lower is better" unless the unit is a rate (".../s").
+ */
+class BenchReport
+{
+public:
+    explicit BenchReport(const char *suite) : suite(suite) {}
+
+    void param(const char *name, unsigned long value) { params.push_back(Param{name, value}); }
+
+    void add(const char *name, double value, const char *unit) { results.push_back(Result{name, value, unit}); }
+
+    void printText(FILE *out) const
+    {
+        fprintf(out, "%s:", suite.c_str());
+        for (size_t i = 0; i < params.size(); ++i) {
+            fprintf(out, " %s=%lu", params[i].name.c_str(), params[i].value);
+        }
+        fprintf(out, "\n");
+        for (size_t i = 0; i < results.size(); ++i) {
+            fprintf(out, "  %-28s %14.3f %s\n", results[i].name.c_str(), results[i].value, results[i].unit.c_str());
+        }
+    }
+
+    void printJson(FILE *out) const
+    {
+        fprintf(out, "{\"suite\":\"%s\",\"params\":{", suite.c_str());
+        for (size_t i = 0; i < params.size(); ++i) {
+            fprintf(out, "%s\"%s\":%lu", i ? "," : "", params[i].name.c_str(), params[i].value);
+        }
+        fprintf(out, "},\"results\":[");
+        for (size_t i = 0; i < results.size(); ++i) {
+            fprintf(out, "%s{\"name\":\"%s\",\"value\":%.6g,\"unit\":\"%s\"}", i ? "," : "",
+                    results[i].name.c_str(), results[i].value, results[i].unit.c_str());
+        }
+        fprintf(out, "]}\n");
+    }
+
+private:
+    struct Param
+    {
+        std::string name;
+        unsigned long value;
+    };
+
+    struct Result
+    {
+        std::string name;
+        double value;
+        std::string unit;
+    };
+
+    std::string suite;
+    std::vector<Param> params;
+    std::vector<Result> results;
+};
+
+#endif //BENCHREPORT_H
@@ -0,0 +1,308 @@
+/*
+ * Regression suite for the codec and the loopback transport, on a fixed-seed trace so two runs
+ * (two builds, two releases) measure the same work:
+ *   - codec: pack<ngps_output> into a fresh msgpack::sbuffer and into an NgpsPackBuffer,
+ *     unpack + convert<ngps_output> with a zone per record and through an UnpackArena,
+ *     NgpsCodec encode/decode; ns per record (best of rounds) and heap allocations per record
+ *   - round trip: one request at a time to an echo thread that decodes and re-encodes every
+ *     datagram; p50/p99/p99.9/max
+ *   - throughput: UdpBatchSender -> UdpBatchReceiver (receiver thread); delivered records/s
+ *
+ * Every encoded record is checked against the trace first; any mismatch fails the run.
+ *
+ * usage: benchSuite [--json] [--seed N] [--records N] [--rounds N] [--pings N]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "ngpsOutput.h"
+#include "unpackArena.h"
+#include "udpBatch.h"
+#include "allocCount.h"
+#include "ngpsTrace.h"
+#include "latencyHistogram.h"
+#include "benchReport.h"
+#include "loopbackSocket.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct Encoded
+{
+    char bytes[NGPS_OUTPUT_MAX_PACKED_SIZE];
+    size_t size;
+};
+
+struct Options
+{
+    SysBool json = FALSE;
+    unsigned long seed = 20001;
+    unsigned long records = 100000;
+    unsigned long rounds = 5;
+    unsigned long pings = 20000;
+};
+
+static volatile size_t sink;
+
+static SysBool parseOptions(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--json") == 0) {
+            options.json = TRUE;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return FALSE;
+        }
+        unsigned long value = strtoul(argv[i + 1], NULL, 10);
+        if (strcmp(argv[i], "--seed") == 0) {
+            options.seed = value;
+        }
+        else if (strcmp(argv[i], "--records") == 0) {
+            options.records = MAX(value, 1UL);
+        }
+        else if (strcmp(argv[i], "--rounds") == 0) {
+            options.rounds = MAX(value, 1UL);
+        }
+        else if (strcmp(argv[i], "--pings") == 0) {
+            options.pings = MAX(value, 1UL);
+        }
+        else {
+            return FALSE;
+        }
+        ++i;
+    }
+    return TRUE;
+}
+
+static unsigned long verify(const std::vector<ngps_output> &trace, std::vector<Encoded> &wire)
+{
+    unsigned long bad = 0;
+    for (size_t i = 0; i < trace.size(); ++i) {
+        NgpsPackBuffer pbuf;
+        msgpack::pack(pbuf, trace[i]);
+        size_t n = NgpsCodec::encode(trace[i], wire[i].bytes, sizeof(wire[i].bytes));
+        wire[i].size = n;
+
+        ngps_output viaObject;
+        ngps_output viaDirect;
+        try {
+            msgpack::object_handle oh = msgpack::unpack(pbuf.data(), pbuf.size());
+            oh.get().convert(viaObject);
+        }
+        catch (const std::exception &) {
+            ++bad;
+            continue;
+        }
+        if (n != pbuf.size() || memcmp(wire[i].bytes, pbuf.data(), n) != 0 || viaObject != trace[i] ||
+            NgpsCodec::decode(wire[i].bytes, n, viaDirect) != DIRECT_CODEC_OK || viaDirect != trace[i]) {
+            ++bad;
+        }
+    }
+    return bad;
+}
+
+/* Best ns per record over options.rounds passes of body(), and heap allocations per record */
+template <typename Body>
+static void measure(BenchReport &report, const char *name, const Options &options, Body body)
+{
+    double best = 0;
+    unsigned long allocs = allocCount();
+    for (unsigned long r = 0; r < options.rounds; ++r) {
+        Clock::time_point start = Clock::now();
+        body();
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / options.records;
+        best = r == 0 ? ns : MIN(best, ns);
+    }
+    allocs = allocCount() - allocs;
+
+    std::string key(name);
+    report.add((key + ".time").c_str(), best, "ns/record");
+    report.add((key + ".allocs").c_str(), (double)allocs / ((double)options.records * options.rounds), "allocs/record");
+}
+
+/* Decode every datagram and send it back re-encoded, as the server does */
+static void echo(int fd, const std::atomic<bool> &done)
+{
+    struct timeval tv = {0, 100000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    char buffer[MAXLINE];
+    UnpackArena arena;
+    while (!done.load()) {
+        sockaddr_in from;
+        socklen_t len = sizeof(from);
+        ssize_t n = recvfrom(fd, buffer, sizeof(buffer), 0, (struct sockaddr *)&from, &len);
+        if (n <= 0) {
+            continue;
+        }
+        try {
+            ngps_output msg;
+            arena.unpack(buffer, (size_t)n).convert(msg);
+            NgpsPackBuffer reply;
+            msgpack::pack(reply, msg);
+            sendto(fd, reply.data(), reply.size(), 0, (const struct sockaddr *)&from, len);
+        }
+        catch (const std::exception &) {
+        }
+    }
+}
+
+static unsigned long roundTrip(BenchReport &report, const std::vector<Encoded> &wire, const Options &options)
+{
+    sockaddr_in serverAddr, clientAddr;
+    int server = openLoopback(serverAddr);
+    int client = openLoopback(clientAddr);
+    struct timeval tv = {1, 0};
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    std::atomic<bool> done(false);
+    std::thread echoer(echo, server, std::cref(done));
+
+    LatencyHistogram rtt;
+    unsigned long lost = 0;
+    char buffer[MAXLINE];
+    for (unsigned long i = 0; i < options.pings; ++i) {
+        const Encoded &e = wire[i % wire.size()];
+        Clock::time_point start = Clock::now();
+        sendto(client, e.bytes, e.size, 0, (const struct sockaddr *)&serverAddr, sizeof(serverAddr));
+        ssize_t n = recv(client, buffer, sizeof(buffer), 0);
+        if (n != (ssize_t)e.size || memcmp(buffer, e.bytes, e.size) != 0) {
+            ++lost;
+            continue;
+        }
+        rtt.record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+    }
+    done.store(true);
+    echoer.join();
+    close(server);
+    close(client);
+
+    report.add("rtt.p50", rtt.percentile(0.50) / 1e3, "us");
+    report.add("rtt.p99", rtt.percentile(0.99) / 1e3, "us");
+    report.add("rtt.p999", rtt.percentile(0.999) / 1e3, "us");
+    report.add("rtt.max", rtt.max() / 1e3, "us");
+    report.add("rtt.lost", (double)lost, "requests");
+    return lost;
+}
+
+static void throughput(BenchReport &report, const std::vector<ngps_output> &trace, const Options &options)
+{
+    sockaddr_in rxAddr, txAddr;
+    int rx = openLoopback(rxAddr);
+    int tx = openLoopback(txAddr);
+
+    std::atomic<bool> done(false);
+    unsigned long received = 0;
+    std::thread receiver([&]() {
+        UdpBatchReceiver batch(rx);
+        ngps_output out[64];
+        for (;;) {
+            int n = batch.receive(out, LENGTHOF(out));
+            if (n > 0) {
+                received += (unsigned long)n;
+            }
+            else if (done.load()) {
+                break;
+            }
+        }
+    });
+
+    UdpBatchSender sender(tx, rxAddr);
+    unsigned long total = options.records * options.rounds;
+    Clock::time_point start = Clock::now();
+    for (unsigned long i = 0; i < total; ++i) {
+        sender.send(trace[i % trace.size()]);
+    }
+    sender.flush();
+    done.store(true);
+    receiver.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    close(rx);
+    close(tx);
+
+    report.add("throughput.delivered", received / seconds / 1e6, "Mrec/s");
+    report.add("throughput.loss", 100.0 * (double)(total - received) / total, "%");
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        fprintf(stderr, "usage: %s [--json] [--seed N] [--records N] [--rounds N] [--pings N]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    BenchReport report("UdpMsgPack");
+    report.param("seed", options.seed);
+    report.param("records", options.records);
+    report.param("rounds", options.rounds);
+    report.param("pings", options.pings);
+
+    std::vector<ngps_output> trace = makeNgpsTrace(options.records, (unsigned int)options.seed);
+    std::vector<Encoded> wire(options.records);
+    std::vector<ngps_output> out(options.records);
+    unsigned long bad = verify(trace, wire);
+    report.add("check.mismatches", (double)bad, "records");
+
+    double bytes = 0;
+    for (size_t i = 0; i < wire.size(); ++i) {
+        bytes += (double)wire[i].size;
+    }
+    report.add("size", bytes / wire.size(), "bytes/record");
+
+    measure(report, "pack.sbuffer", options, [&]() {
+        for (size_t i = 0; i < trace.size(); ++i) {
+            msgpack::sbuffer sbuf;
+            msgpack::pack(sbuf, trace[i]);
+            escape(sbuf.data());
+            sink = sbuf.size();
+        }
+    });
+    measure(report, "pack.fixed", options, [&]() {
+        for (size_t i = 0; i < trace.size(); ++i) {
+            NgpsPackBuffer pbuf;
+            msgpack::pack(pbuf, trace[i]);
+            escape(pbuf.data());
+            sink = pbuf.size();
+        }
+    });
+    measure(report, "convert.zone", options, [&]() {
+        for (size_t i = 0; i < wire.size(); ++i) {
+            msgpack::object_handle oh = msgpack::unpack(wire[i].bytes, wire[i].size);
+            oh.get().convert(out[i]);
+        }
+    });
+    UnpackArena arena;
+    measure(report, "convert.arena", options, [&]() {
+        for (size_t i = 0; i < wire.size(); ++i) {
+            arena.unpack(wire[i].bytes, wire[i].size).convert(out[i]);
+        }
+    });
+    measure(report, "codec.encode", options, [&]() {
+        Encoded e;
+        for (size_t i = 0; i < trace.size(); ++i) {
+            sink = NgpsCodec::encode(trace[i], e.bytes, sizeof(e.bytes));
+        }
+    });
+    measure(report, "codec.decode", options, [&]() {
+        for (size_t i = 0; i < wire.size(); ++i) {
+            sink = NgpsCodec::decode(wire[i].bytes, wire[i].size, out[i]);
+        }
+    });
+
+    bad += roundTrip(report, wire, options);
+    throughput(report, trace, options);
+
+    if (options.json) {
+        report.printJson(stdout);
+    }
+    else {
+        report.printText(stdout);
+    }
+    return bad == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,114 @@
+/*
+ * Benchmark: msgpack::unpack + convert<ngps_output> / pack<ngps_output> against the
+ * compile-time NgpsCodec. Verifies that both paths agree byte-for-byte and field-for-field
+ * on the trace before timing them.
+ *
+ * usage: codecBench [records] [rounds]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "ngpsOutput.h"
+#include "ngpsTrace.h"
+#include "allocCount.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct Encoded
+{
+    char bytes[NGPS_OUTPUT_MAX_PACKED_SIZE];
+    size_t size;
+};
+
+static bool verify(const std::vector<ngps_output> &trace, std::vector<Encoded> &wire)
+{
+    for (size_t i = 0; i < trace.size(); ++i) {
+        NgpsPackBuffer pbuf;
+        msgpack::pack(pbuf, trace[i]);
+
+        char direct[NGPS_OUTPUT_MAX_PACKED_SIZE];
+        size_t n = NgpsCodec::encode(trace[i], direct, sizeof(direct));
+        if (n != pbuf.size() || memcmp(direct, pbuf.data(), n) != 0) {
+            fprintf(stderr, "encode mismatch at record %zu\n", i);
+            return false;
+        }
+        memcpy(wire[i].bytes, direct, n);
+        wire[i].size = n;
+
+        ngps_output viaObject;
+        msgpack::object_handle oh = msgpack::unpack(direct, n);
+        oh.get().convert(viaObject);
+
+        ngps_output viaDirect;
+        size_t consumed = 0;
+        if (NgpsCodec::decode(direct, n, viaDirect, &consumed) != DIRECT_CODEC_OK || consumed != n ||
+            viaDirect != viaObject || viaDirect != trace[i]) {
+            fprintf(stderr, "decode mismatch at record %zu\n", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Body>
+static double nsPerRecord(size_t records, unsigned int rounds, Body body)
+{
+    Clock::time_point start = Clock::now();
+    for (unsigned int r = 0; r < rounds; ++r) {
+        body();
+    }
+    std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+    return elapsed.count() / ((double)records * rounds);
+}
+
+int main(int argc, char **argv)
+{
+    size_t records = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+    unsigned int rounds = argc > 2 ? (unsigned int)strtoul(argv[2], NULL, 10) : 20;
+
+    std::vector<ngps_output> trace = makeNgpsTrace(records);
+    std::vector<Encoded> wire(records);
+    std::vector<ngps_output> out(records);
+
+    if (!verify(trace, wire)) {
+        return EXIT_FAILURE;
+    }
+
+    volatile size_t sink = 0;
+
+    double packNs = nsPerRecord(records, rounds, [&]() {
+        for (size_t i = 0; i < records; ++i) {
+            NgpsPackBuffer pbuf;
+            msgpack::pack(pbuf, trace[i]);
+            escape(pbuf.data());
+            sink = sink + pbuf.size();
+        }
+    });
+    double encodeNs = nsPerRecord(records, rounds, [&]() {
+        for (size_t i = 0; i < records; ++i) {
+            char buf[NGPS_OUTPUT_MAX_PACKED_SIZE];
+            sink = sink + NgpsCodec::encode(trace[i], buf, sizeof(buf));
+            escape(buf);
+        }
+    });
+    double unpackNs = nsPerRecord(records, rounds, [&]() {
+        for (size_t i = 0; i < records; ++i) {
+            msgpack::object_handle oh = msgpack::unpack(wire[i].bytes, wire[i].size);
+            oh.get().convert(out[i]);
+        }
+    });
+    double decodeNs = nsPerRecord(records, rounds, [&]() {
+        for (size_t i = 0; i < records; ++i) {
+            sink = sink + NgpsCodec::decode(wire[i].bytes, wire[i].size, out[i]);
+        }
+    });
+
+    printf("records: %zu x %u rounds\n", records, rounds);
+    printf("encode  pack<ngps_output>      %8.2f ns/record\n", packNs);
+    printf("encode  NgpsCodec::encode      %8.2f ns/record (x%.2f)\n", encodeNs, packNs / encodeNs);
+    printf("decode  unpack + convert       %8.2f ns/record\n", unpackNs);
+    printf("decode  NgpsCodec::decode      %8.2f ns/record (x%.2f)\n", decodeNs, unpackNs / decodeNs);
+    return 0;
+}
@@ -0,0 +1,165 @@
+/*
+ * Bulk decode of back-to-back ngps_output records: msgpack::unpack + convert<ngps_output> per
+ * record, NgpsCodec::decode per record (both into an array of structs) against
+ * decodeNgpsColumns() into structure-of-arrays columns, scalar and SIMD. Runs on the standard
+ * trace (mostly multi-byte integers), on a motion trace (trains reporting position and speed, as
+ * real traffic does) and on a compact trace whose fields all fit in single-byte fixints, the only
+ * case the SIMD whole-record path takes; on the other two "columns SIMD" is the scalar path
+ * behind a skipped probe. Every path is checked against the trace before it is timed.
+ *
+ * usage: columnBench [records] [rounds]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+#include "columnDecoder.h"
+#include "ngpsTrace.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static std::vector<char> concatenate(const std::vector<ngps_output> &trace)
+{
+    msgpack::sbuffer sbuf;
+    for (size_t i = 0; i < trace.size(); ++i) {
+        msgpack::pack(sbuf, trace[i]);
+    }
+    return std::vector<char>(sbuf.data(), sbuf.data() + sbuf.size());
+}
+
+static size_t unpackAll(const std::vector<char> &wire, std::vector<ngps_output> &out)
+{
+    size_t offset = 0;
+    size_t n = 0;
+    while (offset < wire.size()) {
+        msgpack::object_handle oh = msgpack::unpack(wire.data(), wire.size(), offset);
+        oh.get().convert(out[n++]);
+    }
+    return n;
+}
+
+static size_t directAll(const std::vector<char> &wire, std::vector<ngps_output> &out)
+{
+    const char *p = wire.data();
+    const char *end = p + wire.size();
+    size_t n = 0;
+    while (p < end) {
+        size_t used;
+        if (NgpsCodec::decode(p, (size_t)(end - p), out[n], &used) != DIRECT_CODEC_OK) {
+            break;
+        }
+        p += used;
+        ++n;
+    }
+    return n;
+}
+
+static bool verifyColumns(const std::vector<ngps_output> &trace, const std::vector<char> &wire, ColumnDecodeMode mode)
+{
+    NgpsColumns columns;
+    size_t consumed = 0;
+    if (decodeNgpsColumns(wire.data(), wire.size(), columns, &consumed, mode) != DIRECT_CODEC_OK ||
+        consumed != wire.size() || columns.size() != trace.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < trace.size(); ++i) {
+        if (columns.row(i) != trace[i]) {
+            return false;
+        }
+    }
+    // A truncated tail keeps every complete record before it
+    columns.clear();
+    if (decodeNgpsColumns(wire.data(), wire.size() - 1, columns, &consumed, mode) != DIRECT_CODEC_TRUNCATED ||
+        columns.size() != trace.size() - 1) {
+        return false;
+    }
+    return true;
+}
+
+static void report(const char *name, size_t records, size_t bytes, unsigned int rounds, double seconds)
+{
+    double total = (double)records * rounds;
+    printf("  %-20s %8.2f Mrec/s %7.3f GB/s %6.1f ns/rec\n", name, total / seconds / 1e6,
+           (double)bytes * rounds / seconds / 1e9, seconds * 1e9 / total);
+}
+
+static int runTrace(const char *label, const std::vector<ngps_output> &trace, unsigned int rounds)
+{
+    std::vector<char> wire = concatenate(trace);
+    std::vector<ngps_output> aos(trace.size());
+
+    if (unpackAll(wire, aos) != trace.size() || aos != trace) {
+        fprintf(stderr, "%s: unpack/convert mismatch\n", label);
+        return EXIT_FAILURE;
+    }
+    if (directAll(wire, aos) != trace.size() || aos != trace) {
+        fprintf(stderr, "%s: NgpsCodec mismatch\n", label);
+        return EXIT_FAILURE;
+    }
+    if (!verifyColumns(trace, wire, COLUMN_DECODE_SCALAR) || !verifyColumns(trace, wire, COLUMN_DECODE_AUTO)) {
+        fprintf(stderr, "%s: column decode mismatch\n", label);
+        return EXIT_FAILURE;
+    }
+
+    printf("%s: %zu records, %zu bytes (%.1f B/rec)\n", label, trace.size(), wire.size(),
+           (double)wire.size() / trace.size());
+
+    volatile size_t sink = 0;
+    Clock::time_point start = Clock::now();
+    for (unsigned int r = 0; r < rounds; ++r) {
+        sink = sink + unpackAll(wire, aos);
+    }
+    report("unpack+convert", trace.size(), wire.size(), rounds,
+           std::chrono::duration<double>(Clock::now() - start).count());
+
+    start = Clock::now();
+    for (unsigned int r = 0; r < rounds; ++r) {
+        sink = sink + directAll(wire, aos);
+    }
+    report("NgpsCodec", trace.size(), wire.size(), rounds,
+           std::chrono::duration<double>(Clock::now() - start).count());
+
+    NgpsColumns columns;
+    columns.reserve(trace.size() + 1);
+    const ColumnDecodeMode modes[] = {COLUMN_DECODE_SCALAR, COLUMN_DECODE_AUTO};
+    const char *names[] = {"columns scalar", columnDecodeSimd() ? "columns SIMD" : "columns (no SIMD)"};
+    for (size_t m = 0; m < LENGTHOF(modes); ++m) {
+        start = Clock::now();
+        for (unsigned int r = 0; r < rounds; ++r) {
+            columns.clear();
+            decodeNgpsColumns(wire.data(), wire.size(), columns, NULL, modes[m]);
+            sink = sink + columns.size();
+        }
+        report(names[m], trace.size(), wire.size(), rounds,
+               std::chrono::duration<double>(Clock::now() - start).count());
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+    size_t records = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+    unsigned int rounds = argc > 2 ? (unsigned int)strtoul(argv[2], NULL, 10) : 20;
+
+    std::vector<ngps_output> trace = makeNgpsTrace(records);
+    std::vector<ngps_output> compact = trace;
+    for (size_t i = 0; i < compact.size(); ++i) {
+        ngps_output &r = compact[i];
+        r.edge_id = (UShort)(r.edge_id & 0x7f);
+        r.offset &= 0x7f;
+        r.uncertainty &= 0x7f;
+        r.speed &= 0x7f;
+        r.accel = (SShort)(r.accel % 32);
+        r.sensorCnt &= 0x7f;
+    }
+
+    std::vector<ngps_output> motion = makeNgpsMotionTrace(64, records / 64 + 1);
+    motion.resize(records);
+
+    if (runTrace("standard trace", trace, rounds) != EXIT_SUCCESS ||
+        runTrace("motion trace", motion, rounds) != EXIT_SUCCESS ||
+        runTrace("compact trace", compact, rounds) != EXIT_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,137 @@
+/*
+ * Delta encoding benchmark on a motion trace. Reports bytes per message for pack<ngps_output>
+ * and for DeltaEncoder at several keyframe intervals, checks that the decoder rebuilds every
+ * record exactly (also with injected frame loss), and measures loopback packets/s for the full
+ * and the delta encoding.
+ *
+ * usage: deltaBench [trains] [cycles]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <chrono>
+#include <vector>
+#include "deltaCodec.h"
+#include "ngpsTrace.h"
+#include "loopbackSocket.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double fullBytes(const std::vector<ngps_output> &trace)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < trace.size(); ++i) {
+        NgpsPackBuffer pbuf;
+        msgpack::pack(pbuf, trace[i]);
+        total += pbuf.size();
+    }
+    return (double)total / trace.size();
+}
+
+/* Encode/decode every train as its own stream, dropping every dropEvery-th frame if non-zero */
+static bool deltaBytes(const std::vector<ngps_output> &trace, size_t trains, unsigned int interval,
+                       unsigned int dropEvery, double *bytesPerMessage, unsigned long *rejected)
+{
+    std::vector<DeltaEncoder> encoders(trains, DeltaEncoder(interval));
+    std::vector<DeltaDecoder> decoders(trains);
+    size_t total = 0;
+    *rejected = 0;
+
+    for (size_t i = 0; i < trace.size(); ++i) {
+        size_t t = i % trains;
+        char frame[DELTA_MAX_FRAME_SIZE];
+        size_t n = encoders[t].encode(trace[i], frame, sizeof(frame));
+        total += n;
+
+        if (dropEvery != 0 && i % dropEvery == 0) {
+            continue;
+        }
+        ngps_output rt;
+        DeltaStatus status = decoders[t].decode(frame, n, rt);
+        if (status == DELTA_NEED_KEYFRAME) {
+            ++*rejected;
+        }
+        else if (status != DELTA_OK || rt != trace[i]) {
+            fprintf(stderr, "delta mismatch at record %zu\n", i);
+            return false;
+        }
+    }
+    *bytesPerMessage = (double)total / trace.size();
+    return true;
+}
+
+template <typename Encode, typename Decode>
+static double packetsPerSecond(const std::vector<ngps_output> &trace, Encode encode, Decode decode)
+{
+    sockaddr_in txAddr, rxAddr;
+    int tx = openLoopback(txAddr);
+    int rx = openLoopback(rxAddr);
+    char frame[MAXLINE];
+    char buffer[MAXLINE];
+
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < trace.size(); ++i) {
+        size_t n = encode(i, frame);
+        sendto(tx, frame, n, 0, (const struct sockaddr *)&rxAddr, sizeof(rxAddr));
+        ssize_t got = recvfrom(rx, buffer, MAXLINE, 0, NULL, NULL);
+        decode(i, buffer, (size_t)got);
+    }
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+
+    close(tx);
+    close(rx);
+    return trace.size() / elapsed.count();
+}
+
+int main(int argc, char **argv)
+{
+    size_t trains = argc > 1 ? strtoul(argv[1], NULL, 10) : 32;
+    size_t cycles = argc > 2 ? strtoul(argv[2], NULL, 10) : 3000;
+
+    std::vector<ngps_output> trace = makeNgpsMotionTrace(trains, cycles);
+    printf("trace: %zu trains x %zu cycles at 100 ms\n", trains, cycles);
+    printf("%-22s %8.2f bytes/msg\n", "pack<ngps_output>", fullBytes(trace));
+
+    const unsigned int intervals[] = {1, 10, 50, 200};
+    for (size_t k = 0; k < LENGTHOF(intervals); ++k) {
+        double bytes;
+        unsigned long rejected;
+        if (!deltaBytes(trace, trains, intervals[k], 0, &bytes, &rejected)) {
+            return EXIT_FAILURE;
+        }
+        printf("delta keyframe/%-7u %8.2f bytes/msg\n", intervals[k], bytes);
+    }
+
+    double bytes;
+    unsigned long rejected;
+    if (!deltaBytes(trace, trains, 50, 97, &bytes, &rejected)) {
+        return EXIT_FAILURE;
+    }
+    printf("delta with 1/97 loss:  %lu deltas rejected until next keyframe, no stale records\n", rejected);
+
+    double fullPps = packetsPerSecond(trace,
+            [&](size_t i, char *out) {
+                return NgpsCodec::encode(trace[i], out, MAXLINE);
+            },
+            [&](size_t, const char *in, size_t n) {
+                ngps_output rt;
+                NgpsCodec::decode(in, n, rt);
+            });
+
+    std::vector<DeltaEncoder> encoders(trains, DeltaEncoder(50));
+    std::vector<DeltaDecoder> decoders(trains);
+    double deltaPps = packetsPerSecond(trace,
+            [&](size_t i, char *out) {
+                return encoders[i % trains].encode(trace[i], out, MAXLINE);
+            },
+            [&](size_t i, const char *in, size_t n) {
+                ngps_output rt;
+                decoders[i % trains].decode(in, n, rt);
+            });
+
+    printf("loopback full:  %10.0f packets/s\n", fullPps);
+    printf("loopback delta: %10.0f packets/s\n", deltaPps);
+    return 0;
+}
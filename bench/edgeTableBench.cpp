@@ -0,0 +1,135 @@
+/*
+ * Contention benchmark for EdgeStateTable: W writer threads publish into a small set of hot
+ * edges while R reader threads take snapshots of the same edges. Every record a writer stores
+ * carries one value in several fields, so readers detect torn snapshots. A striped-mutex table
+ * (the previous design) is run on the same workload for comparison.
+ *
+ * usage: edgeTableBench [readers] [writers] [hotEdges] [seconds]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "edgeStateTable.h"
+
+class MutexEdgeTable
+{
+public:
+    enum { EDGE_LOCK_STRIPES = 64 };
+
+    MutexEdgeTable() : entries(EdgeStateTable::EDGE_COUNT), counts(EdgeStateTable::EDGE_COUNT) {}
+
+    void update(const ngps_output &msg)
+    {
+        std::lock_guard<std::mutex> lock(stripes[msg.edge_id % EDGE_LOCK_STRIPES]);
+        entries[msg.edge_id] = msg;
+        ++counts[msg.edge_id];
+    }
+
+    SysBool latest(UShort edgeId, ngps_output &out) const
+    {
+        std::lock_guard<std::mutex> lock(stripes[edgeId % EDGE_LOCK_STRIPES]);
+        if (counts[edgeId] == 0) {
+            return FALSE;
+        }
+        out = entries[edgeId];
+        return TRUE;
+    }
+
+private:
+    std::vector<ngps_output> entries;
+    std::vector<unsigned long> counts;
+    mutable std::mutex stripes[EDGE_LOCK_STRIPES];
+};
+
+struct Result
+{
+    double writes;
+    double reads;
+    unsigned long torn;
+};
+
+template <typename Table>
+static Result run(unsigned int readers, unsigned int writers, unsigned int hotEdges, double seconds)
+{
+    Table table;
+    std::atomic<bool> running(true);
+    std::atomic<unsigned long> writes(0);
+    std::atomic<unsigned long> reads(0);
+    std::atomic<unsigned long> torn(0);
+    std::vector<std::thread> threads;
+
+    for (unsigned int w = 0; w < writers; ++w) {
+        threads.push_back(std::thread([&, w]() {
+            ngps_output msg;
+            unsigned long n = 0;
+            while (running.load(std::memory_order_relaxed)) {
+                ULong value = (ULong)(w * 1000003UL + n);
+                msg.edge_id = (UShort)(1 + (n * 7 + w) % hotEdges);
+                msg.offset = value;
+                msg.speed = value;
+                msg.uncertainty = value;
+                msg.accel = (SShort)value;
+                msg.sensorCnt = (UShort)value;
+                table.update(msg);
+                ++n;
+            }
+            writes.fetch_add(n);
+        }));
+    }
+
+    for (unsigned int r = 0; r < readers; ++r) {
+        threads.push_back(std::thread([&, r]() {
+            ngps_output msg;
+            unsigned long n = 0;
+            unsigned long bad = 0;
+            while (running.load(std::memory_order_relaxed)) {
+                UShort edge = (UShort)(1 + (n * 13 + r) % hotEdges);
+                if (table.latest(edge, msg) &&
+                    (msg.edge_id != edge || msg.speed != msg.offset || msg.uncertainty != msg.offset ||
+                     msg.accel != (SShort)msg.offset || msg.sensorCnt != (UShort)msg.offset)) {
+                    ++bad;
+                }
+                ++n;
+            }
+            reads.fetch_add(n);
+            torn.fetch_add(bad);
+        }));
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    running = false;
+    for (size_t t = 0; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+
+    Result result;
+    result.writes = writes / seconds;
+    result.reads = reads / seconds;
+    result.torn = torn;
+    return result;
+}
+
+static void print(const char *name, const Result &r)
+{
+    printf("%-8s %14.0f writes/s %14.0f reads/s %8lu torn\n", name, r.writes, r.reads, r.torn);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int readers = argc > 1 ? (unsigned int)strtoul(argv[1], NULL, 10) : 4;
+    unsigned int writers = argc > 2 ? (unsigned int)strtoul(argv[2], NULL, 10) : 4;
+    unsigned int hotEdges = argc > 3 ? (unsigned int)strtoul(argv[3], NULL, 10) : 16;
+    double seconds = argc > 4 ? atof(argv[4]) : 2.0;
+
+    printf("readers: %u writers: %u hot edges: %u\n", readers, writers, hotEdges);
+    Result seqlock = run<EdgeStateTable>(readers, writers, hotEdges, seconds);
+    Result mutex = run<MutexEdgeTable>(readers, writers, hotEdges, seconds);
+    print("seqlock", seqlock);
+    print("mutex", mutex);
+
+    return seqlock.torn == 0 && mutex.torn == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,122 @@
+/*
+ * Loopback round-trip latency through NgpsEventLoop against an in-process echoing UdpServer.
+ * Several client sockets each keep a window of requests outstanding; every reply's round trip
+ * is recorded in a histogram. Runs once per backend (io_uring, epoll).
+ *
+ * usage: eventLoopBench [sockets] [window] [requests]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <chrono>
+#include <vector>
+#include "eventLoop.h"
+#include "udpServer.h"
+#include "latencyHistogram.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct Client
+{
+    int fd;
+    unsigned long sent;
+};
+
+static void run(EventLoopBackend backend, uint16_t port, unsigned int sockets, unsigned int window,
+                unsigned long requests)
+{
+    NgpsEventLoop loop(backend);
+    LatencyHistogram histogram;
+    unsigned long completed = 0;
+    unsigned long timeouts = 0;
+    unsigned long issued = 0;
+
+    sockaddr_in server;
+    memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    server.sin_port = htons(port);
+
+    std::vector<Client> clients(sockets);
+    std::function<void(unsigned int)> issue = [&](unsigned int c) {
+        if (issued == requests) {
+            return;
+        }
+        ++issued;
+        ngps_output msg;
+        msg.offset = clients[c].sent++;
+        Clock::time_point start = Clock::now();
+        NgpsEventLoop::ReplyHandler onReply = [&, c, start](NgpsRequestStatus status, const ngps_output &) {
+            if (status == NGPS_REQUEST_OK) {
+                histogram.record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        Clock::now() - start).count());
+            }
+            else {
+                ++timeouts;
+            }
+            ++completed;
+            issue(c);
+        };
+        if (loop.request(clients[c].fd, server, msg, std::chrono::milliseconds(200), onReply) != RETURN_SUCCESS) {
+            // No reply will come for it: count it as timed out and retry once the socket has drained
+            loop.addTimer(std::chrono::milliseconds(1), [&, c]() {
+                ++timeouts;
+                ++completed;
+                issue(c);
+            });
+        }
+    };
+
+    for (unsigned int c = 0; c < sockets; ++c) {
+        clients[c].fd = socket(AF_INET, SOCK_DGRAM, 0);
+        clients[c].sent = 0;
+        loop.addSocket(clients[c].fd, NgpsEventLoop::ReceiveHandler());
+    }
+
+    Clock::time_point start = Clock::now();
+    for (unsigned int c = 0; c < sockets; ++c) {
+        for (unsigned int w = 0; w < window; ++w) {
+            issue(c);
+        }
+    }
+    while (completed < issued) {
+        loop.runOnce(std::chrono::milliseconds(100));
+    }
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+
+    char name[32];
+    snprintf(name, sizeof(name), "%s", loop.backend() == EVENT_LOOP_IO_URING ? "io_uring" : "epoll");
+    histogram.print(name);
+    printf("%-16s %.0f req/s, %lu timeouts\n", "", completed / elapsed.count(), timeouts);
+
+    for (unsigned int c = 0; c < sockets; ++c) {
+        loop.removeSocket(clients[c].fd);
+        close(clients[c].fd);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int sockets = argc > 1 ? (unsigned int)strtoul(argv[1], NULL, 10) : 8;
+    unsigned int window = argc > 2 ? (unsigned int)strtoul(argv[2], NULL, 10) : 4;
+    unsigned long requests = argc > 3 ? strtoul(argv[3], NULL, 10) : 200000;
+
+    EdgeStateTable table;
+    UdpServerConfig config;
+    config.port = 0;
+    config.workers = 1;
+    config.pinCores = FALSE;
+    UdpServer server(config, table);
+    if (server.start() != RETURN_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+
+    printf("sockets: %u window: %u requests: %lu\n", sockets, window, requests);
+    run(EVENT_LOOP_IO_URING, server.port(), sockets, window, requests);
+    run(EVENT_LOOP_EPOLL, server.port(), sockets, window, requests);
+
+    server.stop();
+    return 0;
+}
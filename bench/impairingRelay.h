@@ -0,0 +1,128 @@
+#ifndef IMPAIRINGRELAY_H
+#define IMPAIRINGRELAY_H
+
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <deque>
+#include <random>
+#include <vector>
+#include "ngpsOutput.h"
+
+/*
+ * In-process netem stand-in: datagrams sent to the relay socket are forwarded to dest after
+ * seeded random loss, duplication and reordering. A reordered datagram is held back and
+ * forwarded after the next `depth` datagrams. Driven by pump() from the benchmark's own loop,
+ * so a run is reproducible for a given seed.
+ */
+struct ImpairmentConfig
+{
+    double loss = 0.0;          /* probability a datagram is dropped */
+    double duplicate = 0.0;     /* probability a datagram is forwarded twice */
+    double reorder = 0.0;       /* probability a datagram is held back */
+    unsigned int depth = 3;     /* datagrams that overtake a held one */
+    unsigned int seed = 20001;
+};
+
+struct ImpairmentStats
+{
+    unsigned long forwarded = 0;
+    unsigned long dropped = 0;
+    unsigned long duplicated = 0;
+    unsigned long reordered = 0;
+};
+
+class ImpairingRelay
+{
+public:
+    ImpairingRelay(int sockfd, const sockaddr_in &dest, const ImpairmentConfig &config) :
+            sockfd(sockfd),
+            dest(dest),
+            config(config),
+            rng(config.seed)
+    {
+    }
+
+    /* Forward everything queued on the relay socket. Returns datagrams read */
+    unsigned int pump()
+    {
+        unsigned int count = 0;
+        char buffer[MAXLINE];
+        for (;;) {
+            ssize_t n = recvfrom(sockfd, buffer, sizeof(buffer), MSG_DONTWAIT, NULL, NULL);
+            if (n <= 0) {
+                break;
+            }
+            ++count;
+            impair(buffer, (size_t)n);
+        }
+        return count;
+    }
+
+    /* Forward any held datagrams now */
+    void flush()
+    {
+        while (!held.empty()) {
+            forward(held.front().data.data(), held.front().data.size());
+            held.pop_front();
+        }
+    }
+
+    const ImpairmentStats &stats() const { return counters; }
+
+private:
+    struct Held
+    {
+        std::vector<char> data;
+        unsigned int due;
+    };
+
+    void impair(const char *data, size_t size)
+    {
+        if (chance(rng) < config.loss) {
+            ++counters.dropped;
+        }
+        else if (chance(rng) < config.reorder) {
+            Held h;
+            h.data.assign(data, data + size);
+            h.due = config.depth;
+            held.push_back(h);
+            ++counters.reordered;
+            return;             /* the held datagram does not count towards others' depth */
+        }
+        else {
+            forward(data, size);
+            if (chance(rng) < config.duplicate) {
+                forward(data, size);
+                ++counters.duplicated;
+            }
+        }
+
+        for (size_t i = 0; i < held.size(); ++i) {
+            --held[i].due;
+        }
+        while (!held.empty() && held.front().due == 0) {
+            forward(held.front().data.data(), held.front().data.size());
+            held.pop_front();
+        }
+    }
+
+    void forward(const char *data, size_t size)
+    {
+        if (sendto(sockfd, data, size, 0, (const struct sockaddr *)&dest, sizeof(dest)) == (ssize_t)size) {
+            ++counters.forwarded;
+        }
+    }
+
+    int sockfd;
+    sockaddr_in dest;
+    ImpairmentConfig config;
+    std::mt19937 rng;
+    std::uniform_real_distribution<double> chance;
+    std::deque<Held> held;
+    ImpairmentStats counters;
+};
+
+#endif //IMPAIRINGRELAY_H
@@ -0,0 +1,177 @@
+/*
+ * KinematicCache: checks the extrapolation (constant speed, braking to a stop, direction,
+ * uncertainty growth, invalidation, staleness, out-of-order reports), then runs R reader threads
+ * estimating positions on a set of hot edges while W writer threads feed reports. Every report a
+ * writer stores carries one value in several fields, so readers detect torn snapshots.
+ *
+ * usage: kinematicBench [readers] [writers] [hotEdges] [seconds]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "kinematicCache.h"
+
+#define SECOND  (1000000000ULL)
+
+static unsigned long failures = 0;
+
+static void expect(bool ok, const char *what)
+{
+    if (!ok) {
+        ++failures;
+        fprintf(stderr, "check failed: %s\n", what);
+    }
+}
+
+static void checkExtrapolation()
+{
+    KinematicConfig config;
+    config.speedErrorMmS = 100;
+    config.accelErrorMmS2 = 400;
+    config.maxAgeNs = 10 * SECOND;
+    KinematicCache cache(config);
+    KinematicEstimate e;
+
+    expect(cache.estimate(7, SECOND, e) == KINEMATIC_UNKNOWN, "unknown edge");
+
+    // 10 m/s, no accel, offset increasing: 2.5 s later it is 25 m on, uncertainty 2 + 250 + 1250
+    ngps_output r(7, 100000, 2, TRUE, 10000, TRUE, FALSE, FALSE, FALSE, 0, 1);
+    expect(cache.update(r, 10 * SECOND) == TRUE, "first update");
+    expect(cache.estimate(7, 12 * SECOND + SECOND / 2, e) == KINEMATIC_OK && e.offset == 125000 &&
+           e.speed == 10000 && e.uncertainty == 2 + 250 + 1250 && !e.decreasing, "constant speed");
+    expect(cache.estimate(7, 9 * SECOND, e) == KINEMATIC_OK && e.offset == 100000 && e.ageNs == 0,
+           "query before the report");
+
+    // gd0 != reversing: offset decreasing. Braking at 2 m/s/s from 10 m/s stops after 5 s and 25 m
+    r.gd0 = TRUE;
+    r.accel = -2000;
+    expect(cache.update(r, 20 * SECOND) == TRUE, "second update");
+    expect(cache.estimate(7, 21 * SECOND, e) == KINEMATIC_OK && e.offset == 100000 - 9000 && e.speed == 8000 &&
+           e.decreasing, "braking");
+    expect(cache.estimate(7, 28 * SECOND, e) == KINEMATIC_OK && e.offset == 100000 - 25000 && e.speed == 0,
+           "stopped, not reversed");
+    expect(cache.estimate(7, 31 * SECOND, e) == KINEMATIC_STALE, "stale");
+
+    // Stationary trains do not move whatever the speed says
+    r.stationary = TRUE;
+    expect(cache.update(r, 40 * SECOND) == TRUE, "stationary update");
+    expect(cache.estimate(7, 42 * SECOND, e) == KINEMATIC_OK && e.offset == 100000 && e.speed == 0, "stationary");
+
+    // Older reports are ignored; an invalid one blocks estimates until a valid one arrives
+    expect(cache.update(r, 39 * SECOND) == FALSE && cache.updates(7) == 3, "out-of-order report ignored");
+    r.speed_valid = FALSE;
+    cache.update(r, 41 * SECOND);
+    expect(cache.estimate(7, 41 * SECOND, e) == KINEMATIC_INVALID, "speed_valid dropped");
+    r.speed_valid = TRUE;
+    r.pos_valid = FALSE;
+    cache.update(r, 42 * SECOND);
+    expect(cache.estimate(7, 42 * SECOND, e) == KINEMATIC_INVALID, "pos_valid dropped");
+    r.pos_valid = TRUE;
+    cache.update(r, 43 * SECOND);
+    expect(cache.estimate(7, 43 * SECOND, e) == KINEMATIC_OK, "valid again");
+
+    // Reports from one receive batch share a timestamp; the later one wins
+    r.offset = 200000;
+    expect(cache.update(r, 43 * SECOND) == TRUE && cache.estimate(7, 43 * SECOND, e) == KINEMATIC_OK &&
+           e.offset == 200000, "same-timestamp report replaces");
+}
+
+struct Result
+{
+    double writes;
+    double queries;
+    unsigned long torn;
+};
+
+static Result run(unsigned int readers, unsigned int writers, unsigned int hotEdges, double seconds)
+{
+    KinematicConfig config;
+    config.speedErrorMmS = 0;
+    config.accelErrorMmS2 = 0;
+    config.maxAgeNs = ~0ULL;
+    KinematicCache cache(config);
+    std::atomic<bool> running(true);
+    std::atomic<unsigned long> writes(0);
+    std::atomic<unsigned long> queries(0);
+    std::atomic<unsigned long> torn(0);
+    std::atomic<uint64_t> clock(1);     /* shared report time, so every writer's report is newer */
+    std::vector<std::thread> threads;
+
+    ngps_output initial;
+    initial.stationary = TRUE;
+    initial.offset = initial.uncertainty = 0;
+    for (unsigned int e = 1; e <= hotEdges; ++e) {
+        initial.edge_id = (UShort)e;
+        cache.update(initial, clock.fetch_add(1));
+    }
+
+    for (unsigned int w = 0; w < writers; ++w) {
+        threads.push_back(std::thread([&, w]() {
+            ngps_output msg;
+            msg.stationary = TRUE;      /* estimates then return the stored fields unchanged */
+            unsigned long n = 0;
+            while (running.load(std::memory_order_relaxed)) {
+                ULong value = (ULong)(w * 1000003UL + n) % 1000000;
+                msg.edge_id = (UShort)(1 + (n * 7 + w) % hotEdges);
+                msg.offset = value;
+                msg.uncertainty = value;
+                msg.accel = (SShort)(value % 1000);
+                cache.update(msg, clock.fetch_add(1, std::memory_order_relaxed));
+                ++n;
+            }
+            writes.fetch_add(n);
+        }));
+    }
+
+    for (unsigned int r = 0; r < readers; ++r) {
+        threads.push_back(std::thread([&, r]() {
+            KinematicEstimate e;
+            unsigned long n = 0;
+            unsigned long bad = 0;
+            while (running.load(std::memory_order_relaxed)) {
+                UShort edge = (UShort)(1 + (n * 13 + r) % hotEdges);
+                if (cache.estimate(edge, clock.load(std::memory_order_relaxed), e) != KINEMATIC_OK ||
+                    e.uncertainty != (ULong)e.offset || e.speed != 0) {
+                    ++bad;
+                }
+                ++n;
+            }
+            queries.fetch_add(n);
+            torn.fetch_add(bad);
+        }));
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    running = false;
+    for (size_t t = 0; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+
+    Result result;
+    result.writes = writes / seconds;
+    result.queries = queries / seconds;
+    result.torn = torn;
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int readers = argc > 1 ? (unsigned int)strtoul(argv[1], NULL, 10) : 4;
+    unsigned int writers = argc > 2 ? (unsigned int)strtoul(argv[2], NULL, 10) : 2;
+    unsigned int hotEdges = argc > 3 ? (unsigned int)strtoul(argv[3], NULL, 10) : 64;
+    double seconds = argc > 4 ? atof(argv[4]) : 2.0;
+
+    checkExtrapolation();
+    printf("extrapolation checks: %lu failures\n", failures);
+
+    printf("readers: %u writers: %u hot edges: %u\n", readers, writers, hotEdges);
+    Result idle = run(readers, 0, hotEdges, seconds);
+    Result loaded = run(readers, writers, hotEdges, seconds);
+    printf("%-14s %14.0f updates/s %14.0f queries/s %8lu torn\n", "no writers", idle.writes, idle.queries, idle.torn);
+    printf("%-14s %14.0f updates/s %14.0f queries/s %8lu torn\n", "with writers", loaded.writes, loaded.queries,
+           loaded.torn);
+    return failures == 0 && loaded.torn == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
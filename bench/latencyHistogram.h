@@ -0,0 +1,103 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Log-linear latency histogram for benchmarks: 16 sub-buckets per power of two, so any recorded
+ * value is reported within ~6%. Fixed size, no allocation, not thread-safe.
+ */
+class LatencyHistogram
+{
+public:
+    enum { SUB_BITS = 4, SUB_BUCKETS = 1 << SUB_BITS, BUCKETS = 64 * SUB_BUCKETS };
+
+    LatencyHistogram() { reset(); }
+
+    void reset()
+    {
+        memset(counts, 0, sizeof(counts));
+        total = 0;
+        maxValue = 0;
+    }
+
+    void record(uint64_t ns)
+    {
+        ++counts[index(ns)];
+        ++total;
+        if (ns > maxValue) {
+            maxValue = ns;
+        }
+    }
+
+    void merge(const LatencyHistogram &other)
+    {
+        for (unsigned int i = 0; i < BUCKETS; ++i) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+        if (other.maxValue > maxValue) {
+            maxValue = other.maxValue;
+        }
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return maxValue; }
+
+    /* Upper bound of the bucket holding quantile q (0..1) */
+    uint64_t percentile(double q) const
+    {
+        uint64_t rank = (uint64_t)(q * (double)total);
+        if (rank >= total) {
+            rank = total - 1;
+        }
+        uint64_t seen = 0;
+        for (unsigned int i = 0; i < BUCKETS; ++i) {
+            seen += counts[i];
+            if (seen > rank) {
+                return upper(i) < maxValue ? upper(i) : maxValue;
+            }
+        }
+        return maxValue;
+    }
+
+    void print(const char *name) const
+    {
+        if (total == 0) {
+            printf("%-16s no samples\n", name);
+            return;
+        }
+        printf("%-16s n=%-9llu p50=%7.1fus p90=%7.1fus p99=%7.1fus p99.9=%7.1fus max=%7.1fus\n", name,
+               (unsigned long long)total, percentile(0.50) / 1e3, percentile(0.90) / 1e3,
+               percentile(0.99) / 1e3, percentile(0.999) / 1e3, maxValue / 1e3);
+    }
+
+private:
+    static unsigned int index(uint64_t v)
+    {
+        if (v < SUB_BUCKETS) {
+            return (unsigned int)v;
+        }
+        unsigned int msb = 63 - (unsigned int)__builtin_clzll(v);
+        unsigned int sub = (unsigned int)(v >> (msb - SUB_BITS)) & (SUB_BUCKETS - 1);
+        return (msb - SUB_BITS + 1) * SUB_BUCKETS + sub;
+    }
+
+    static uint64_t upper(unsigned int i)
+    {
+        if (i < SUB_BUCKETS) {
+            return i;
+        }
+        unsigned int shift = i / SUB_BUCKETS - 1;
+        uint64_t sub = i % SUB_BUCKETS;
+        return ((SUB_BUCKETS + sub + 1) << shift) - 1;
+    }
+
+    uint64_t counts[BUCKETS];
+    uint64_t total;
+    uint64_t maxValue;
+};
+
+#endif //LATENCYHISTOGRAM_H
@@ -0,0 +1,94 @@
+/*
+ * Load generator for the SO_REUSEPORT receive server. For 1..maxWorkers workers it starts an
+ * in-process UdpServer on a loopback ephemeral port, floods it from several sender threads (each
+ * with its own source port, so the kernel spreads them over the workers) and reports the decoded
+ * throughput and the scaling relative to one worker.
+ *
+ * usage: loadGen [maxWorkers] [senders] [seconds]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "udpServer.h"
+#include "udpBatch.h"
+#include "ngpsTrace.h"
+
+static void flood(uint16_t port, unsigned int id, const std::atomic<bool> &running)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        perror("socket creation failed");
+        return;
+    }
+
+    sockaddr_in dest;
+    memset(&dest, 0, sizeof(dest));
+    dest.sin_family = AF_INET;
+    dest.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    dest.sin_port = htons(port);
+
+    std::vector<ngps_output> trace = makeNgpsTrace(4096, 20001 + id);
+    UdpBatchSender sender(fd, dest);
+    for (size_t i = 0; running.load(std::memory_order_relaxed); ++i) {
+        sender.send(trace[i % trace.size()]);
+    }
+    sender.flush();
+    close(fd);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int online = (unsigned int)sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int maxWorkers = argc > 1 ? (unsigned int)strtoul(argv[1], NULL, 10) : online;
+    unsigned int senders = argc > 2 ? (unsigned int)strtoul(argv[2], NULL, 10) : 2 * maxWorkers;
+    double seconds = argc > 3 ? atof(argv[3]) : 2.0;
+
+    printf("%-8s %14s %10s %10s\n", "workers", "decoded/s", "scaling", "errors");
+
+    double base = 0.0;
+    for (unsigned int workers = 1; workers <= maxWorkers; ++workers) {
+        EdgeStateTable table;
+        UdpServerConfig config;
+        config.port = 0;
+        config.workers = workers;
+        config.echo = FALSE;
+
+        UdpServer server(config, table);
+        if (server.start() != RETURN_SUCCESS) {
+            return EXIT_FAILURE;
+        }
+
+        std::atomic<bool> running(true);
+        std::vector<std::thread> threads;
+        for (unsigned int s = 0; s < senders; ++s) {
+            threads.push_back(std::thread(flood, server.port(), s, std::cref(running)));
+        }
+
+        // Let the senders ramp up before measuring
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        unsigned long before = server.decoded();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        unsigned long after = server.decoded();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        running = false;
+        for (size_t t = 0; t < threads.size(); ++t) {
+            threads[t].join();
+        }
+        server.stop();
+
+        double rate = (after - before) / elapsed.count();
+        if (workers == 1) {
+            base = rate;
+        }
+        printf("%-8u %14.0f %9.2fx %10lu\n", workers, rate, base > 0 ? rate / base : 0.0, server.decodeErrors());
+    }
+    return 0;
+}
@@ -0,0 +1,39 @@
+#ifndef LOOPBACKSOCKET_H
+#define LOOPBACKSOCKET_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/*
+ * UDP socket for benchmarks, bound to an ephemeral port on 127.0.0.1, with its address in addr.
+ * The receive buffer is raised to 8 MB (capped by net.core.rmem_max) so bursts are not dropped
+ * before the receiver is scheduled. Exits the process if the socket cannot be set up.
+ */
+inline int openLoopback(sockaddr_in &addr)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        perror("socket creation failed");
+        exit(EXIT_FAILURE);
+    }
+    int size = 8 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t len = sizeof(addr);
+    if (bind(fd, (const struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        getsockname(fd, (struct sockaddr *)&addr, &len) < 0) {
+        perror("bind failed");
+        exit(EXIT_FAILURE);
+    }
+    return fd;
+}
+
+#endif //LOOPBACKSOCKET_H
@@ -0,0 +1,97 @@
+#ifndef NGPSMUTATOR_H
+#define NGPSMUTATOR_H
+
+#include <random>
+#include <vector>
+#include "ngpsOutput.h"
+
+/*
+ * msgpack::unpack limits for decoding untrusted ngps_output datagrams without a validator in front.
+ * Without them unpack allocates an object for every element an array header declares, before
+ * reading any of them: 0xdd ff ff ff ff asks for 4G objects.
+ */
+inline msgpack::unpack_limit ngpsUnpackLimit()
+{
+    return msgpack::unpack_limit(64, 64, 256, 256, 256, 4);
+}
+
+/*
+ * Deterministic malformed ngps_output datagrams for the validator fuzz harness and the reject
+ * benchmark. Each call takes a valid encoding and applies one mutation, as hostile or broken
+ * senders produce them: bit flips, truncation, inserted, overwritten and trailing bytes, a huge
+ * declared element count, an element replaced by another msgpack type, or plain random bytes.
+ * The result is not guaranteed to be invalid (a flipped bit can land on another valid value).
+ */
+typedef enum NgpsMutation
+{
+    MUTATE_BIT_FLIP = 0,
+    MUTATE_TRUNCATE,
+    MUTATE_INSERT,
+    MUTATE_OVERWRITE,
+    MUTATE_TRAILING,
+    MUTATE_HUGE_COUNT,
+    MUTATE_TYPE_SWAP,
+    MUTATE_RANDOM,
+    MUTATIONS
+} NgpsMutation;
+
+class NgpsMutator
+{
+public:
+    explicit NgpsMutator(unsigned int seed = 20001) : rng(seed) {}
+
+    std::vector<char> mutate(const std::vector<char> &valid, NgpsMutation *applied = NULL)
+    {
+        std::vector<char> out(valid);
+        NgpsMutation m = (NgpsMutation)pick(MUTATIONS);
+        size_t at = pick(out.size());
+        switch (m) {
+            case MUTATE_BIT_FLIP:
+                out[at] ^= (char)(1 << pick(8));
+                break;
+            case MUTATE_TRUNCATE:
+                out.resize(at);
+                break;
+            case MUTATE_INSERT:
+                out.insert(out.begin() + (long)at, (char)pick(256));
+                break;
+            case MUTATE_OVERWRITE:
+                out[at] = (char)pick(256);
+                break;
+            case MUTATE_TRAILING:
+                for (size_t n = 1 + pick(4); n > 0; --n) {
+                    out.push_back((char)pick(256));
+                }
+                break;
+            case MUTATE_HUGE_COUNT: {
+                static const char huge[] = {(char)0xdd, (char)0xff, (char)0xff, (char)0xff, (char)0xff};
+                out.erase(out.begin());
+                out.insert(out.begin(), huge, huge + sizeof(huge));
+                break;
+            }
+            case MUTATE_TYPE_SWAP: {
+                // nil, float32, float64, str8, bin8, fixstr, fixmap, nested fixarray
+                static const uint8_t tags[] = {0xc0, 0xca, 0xcb, 0xd9, 0xc4, 0xa3, 0x81, 0x92};
+                out[1 + pick(out.size() - 1)] = (char)tags[pick(LENGTHOF(tags))];
+                break;
+            }
+            default:
+                out.resize(pick(NGPS_OUTPUT_MAX_PACKED_SIZE * 2));
+                for (size_t i = 0; i < out.size(); ++i) {
+                    out[i] = (char)pick(256);
+                }
+                break;
+        }
+        if (applied != NULL) {
+            *applied = m;
+        }
+        return out;
+    }
+
+private:
+    size_t pick(size_t n) { return n > 0 ? std::uniform_int_distribution<size_t>(0, n - 1)(rng) : 0; }
+
+    std::mt19937 rng;
+};
+
+#endif //NGPSMUTATOR_H
@@ -0,0 +1,103 @@
+#ifndef NGPSTRACE_H
+#define NGPSTRACE_H
+
+#include <random>
+#include <vector>
+#include "ngpsOutput.h"
+
+/*
+ * Deterministic synthetic ngps_output trace for benchmarks. Trains move along their edge with
+ * plausible speed/accel; a small fraction of records use extreme values so every integer width
+ * of the msgpack encoding is exercised.
+ */
+inline std::vector<ngps_output> makeNgpsTrace(size_t count, unsigned int seed = 20001)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> edge(1, 2000);
+    std::uniform_int_distribution<int> offset(0, 2000000);
+    std::uniform_int_distribution<int> speed(0, 30000);
+    std::uniform_int_distribution<int> accel(-1500, 1500);
+    std::uniform_int_distribution<int> percent(0, 99);
+
+    std::vector<ngps_output> trace(count);
+    for (size_t i = 0; i < count; ++i) {
+        ngps_output &r = trace[i];
+        r.edge_id = (UShort)edge(rng);
+        r.offset = (ULong)offset(rng);
+        r.uncertainty = (ULong)(2 + percent(rng));
+        r.speed = (ULong)speed(rng);
+        r.accel = (SShort)accel(rng);
+        r.stationary = r.speed == 0 ? TRUE : FALSE;
+        r.reversing = percent(rng) < 10 ? TRUE : FALSE;
+        r.gd0 = percent(rng) < 50 ? TRUE : FALSE;
+        r.pos_valid = percent(rng) < 98 ? TRUE : FALSE;
+        r.speed_valid = r.pos_valid;
+        r.sensorCnt = (UShort)(1 + percent(rng) % 4);
+
+        if (percent(rng) == 0) {
+            r.edge_id = 0xffff;
+            r.offset = (ULong)0xffffffffUL + (ULong)offset(rng);
+            r.accel = -32768;
+        }
+    }
+    return trace;
+}
+
+/*
+ * Deterministic motion trace: `trains` trains reporting every `periodMs`, interleaved train by
+ * train. Speed follows accel with occasional accel changes and stops; offset integrates speed and
+ * wraps onto the next edge at the edge length, as a real position stream does.
+ */
+inline std::vector<ngps_output> makeNgpsMotionTrace(size_t trains, size_t cycles, unsigned int periodMs = 100,
+                                                    unsigned int seed = 20001)
+{
+    const ULong edgeLength = 400000;    /* mm */
+    const long maxSpeed = 25000;        /* mm/s */
+
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::uniform_int_distribution<int> accelStep(-800, 800);
+
+    std::vector<ngps_output> state(trains);
+    for (size_t t = 0; t < trains; ++t) {
+        state[t].edge_id = (UShort)(1 + t * 37 % 2000);
+        state[t].offset = (ULong)(rng() % edgeLength);
+        state[t].speed = (ULong)(rng() % maxSpeed);
+        state[t].uncertainty = 20;
+        state[t].reversing = FALSE;
+        state[t].gd0 = (t & 1) ? TRUE : FALSE;
+    }
+
+    std::vector<ngps_output> trace;
+    trace.reserve(trains * cycles);
+    for (size_t c = 0; c < cycles; ++c) {
+        for (size_t t = 0; t < trains; ++t) {
+            ngps_output &r = state[t];
+
+            if (percent(rng) < 5) {
+                r.accel = (SShort)accelStep(rng);
+            }
+            long speed = (long)r.speed + r.accel * (long)periodMs / 1000;
+            if (speed <= 0 || speed >= maxSpeed) {
+                speed = speed <= 0 ? 0 : maxSpeed;
+                r.accel = 0;
+            }
+            if (r.speed == 0 && percent(rng) < 2) {
+                r.accel = 500;      /* depart */
+            }
+            r.speed = (ULong)speed;
+            r.stationary = r.speed == 0 ? TRUE : FALSE;
+            r.offset += r.speed * periodMs / 1000;
+            if (r.offset >= edgeLength) {
+                r.offset -= edgeLength;
+                r.edge_id = (UShort)(r.edge_id % 2000 + 1);
+            }
+            r.uncertainty = 20 + (ULong)(percent(rng) < 10 ? percent(rng) : 0);
+
+            trace.push_back(r);
+        }
+    }
+    return trace;
+}
+
+#endif //NGPSTRACE_H
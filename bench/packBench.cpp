@@ -0,0 +1,56 @@
+/*
+ * Microbenchmark: pack<ngps_output> into a fresh msgpack::sbuffer per message (the
+ * send path in main.cpp) against packing into a stack-resident NgpsPackBuffer.
+ * Reports heap allocations per message and ns per pack.
+ *
+ * usage: packBench [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include "ngpsOutput.h"
+#include "allocCount.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static volatile size_t sink;
+
+template <typename PackOne>
+static void run(const char *name, unsigned long iterations, PackOne packOne)
+{
+    ngps_output ngps;
+
+    unsigned long allocsBefore = allocCount();
+    Clock::time_point start = Clock::now();
+    for (unsigned long i = 0; i < iterations; ++i) {
+        ngps.offset = 500 + (i & 0xffff);
+        ngps.speed = 2000 + (i & 0xfff);
+        sink = packOne(ngps);
+    }
+    std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+    unsigned long allocs = allocCount() - allocsBefore;
+
+    printf("%-12s %8.2f ns/pack %8.3f allocs/msg\n", name, elapsed.count() / iterations,
+           (double)allocs / iterations);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long iterations = argc > 1 ? strtoul(argv[1], NULL, 10) : 5000000;
+
+    run("sbuffer", iterations, [](const ngps_output &ngps) {
+        msgpack::sbuffer sbuf;
+        msgpack::pack(sbuf, ngps);
+        escape(sbuf.data());
+        return sbuf.size();
+    });
+
+    run("fixed", iterations, [](const ngps_output &ngps) {
+        NgpsPackBuffer pbuf;
+        msgpack::pack(pbuf, ngps);
+        escape(pbuf.data());
+        return pbuf.size();
+    });
+
+    return 0;
+}
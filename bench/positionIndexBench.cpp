@@ -0,0 +1,265 @@
+/*
+ * PositionIndex: checks range and nearest-ahead queries (uncertainty, direction, edge changes,
+ * invalid reports, full edges), compares random updates and queries against a brute-force scan,
+ * then runs W writer threads moving T trains along a line of edges while R reader threads query.
+ * Readers check every result: hits in offset order, each within the queried range given its own
+ * uncertainty.
+ *
+ * usage: positionIndexBench [trains] [writers] [readers] [updates/s per writer, 0 = flat out] [seconds]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include "positionIndex.h"
+#include "latencyHistogram.h"
+
+typedef std::chrono::steady_clock Clock;
+
+#define EDGES           (200)
+#define EDGE_LENGTH     (400000)        /* mm */
+
+static unsigned long failures = 0;
+
+static void expect(bool ok, const char *what)
+{
+    if (!ok) {
+        ++failures;
+        fprintf(stderr, "check failed: %s\n", what);
+    }
+}
+
+static ngps_output report(UShort edge, ULong offset, ULong uncertainty, SysBool decreasing = FALSE)
+{
+    ngps_output msg;
+    msg.edge_id = edge;
+    msg.offset = offset;
+    msg.uncertainty = uncertainty;
+    msg.gd0 = decreasing;
+    msg.reversing = FALSE;
+    return msg;
+}
+
+static void checkQueries()
+{
+    PositionIndexConfig config;
+    config.perEdgeCapacity = 4;
+    PositionIndex index(config);
+    PositionHit hits[8];
+    PositionHit h;
+
+    index.update(1, report(5, 1000, 50));
+    index.update(2, report(5, 3000, 500, TRUE));
+    index.update(3, report(5, 10000, 10));
+    expect(index.count(5) == 3, "three trains on edge 5");
+
+    expect(index.within(5, 2000, 600, hits, 8) == 1 && hits[0].train == 2, "only the uncertain train reaches 2000 +- 600");
+    expect(index.within(5, 2000, 1000, hits, 8) == 2 && hits[0].train == 1 && hits[1].train == 2,
+           "two trains within 1000, in offset order");
+    expect(hits[1].decreasing == TRUE && hits[1].uncertainty == 500, "hit carries direction and uncertainty");
+    expect(index.within(5, 2000, 1000, hits, 1) == 2, "matches counted beyond max");
+    expect(index.within(6, 2000, 1000, hits, 8) == 0, "empty edge");
+
+    expect(index.nearestAhead(5, 1000, FALSE, h, 1) && h.train == 2 && h.clearance == 1500, "ahead of train 1");
+    expect(index.nearestAhead(5, 3000, TRUE, h, 2) && h.train == 1 && h.clearance == 1950, "ahead of train 2, decreasing");
+    expect(!index.nearestAhead(5, 10000, FALSE, h, 3), "nothing ahead of the last train");
+    expect(index.nearestAhead(5, 9995, FALSE, h) && h.train == 3 && h.clearance == -5, "overlapping interval");
+
+    index.update(2, report(6, 0, 500));
+    expect(index.count(5) == 2 && index.count(6) == 1, "train 2 moved to edge 6");
+    expect(index.within(5, 2000, 1000, hits, 8) == 1, "wide interval gone from edge 5");
+    index.update(1, report(5, 20000, 50));
+    expect(index.within(5, 0, 30000, hits, 8) == 2 && hits[0].train == 3 && hits[1].train == 1, "reordered on move");
+
+    ngps_output lost = report(5, 10000, 10);
+    lost.pos_valid = FALSE;
+    expect(!index.update(3, lost) && index.count(5) == 1, "invalid report removes the train");
+
+    for (TrainId t = 10; t < 14; ++t) {
+        index.update(t, report(7, t * 100, 5));
+    }
+    expect(!index.update(14, report(7, 0, 5)) && index.overflows() == 1, "full edge rejects a fifth train");
+    expect(index.update(13, report(7, 50, 5)) && index.within(7, 50, 0, hits, 8) == 1 && hits[0].train == 13,
+           "a train already on a full edge can still move");
+    index.remove(13);
+    expect(index.update(14, report(7, 0, 5)), "room after remove");
+}
+
+struct Model
+{
+    UShort edge;
+    ULong offset;
+    ULong uncertainty;
+    bool indexed;
+};
+
+static void checkAgainstScan(unsigned int seed)
+{
+    const TrainId trains = 500;
+    PositionIndexConfig config;
+    config.perEdgeCapacity = trains;
+    PositionIndex index(config);
+    std::vector<Model> model(trains, Model{0, 0, 0, false});
+    std::mt19937 rng(seed);
+
+    unsigned long mismatches = 0;
+    PositionHit hits[trains];
+    for (unsigned int op = 0; op < 200000; ++op) {
+        TrainId t = (TrainId)(rng() % trains);
+        ngps_output msg = report((UShort)(1 + rng() % 8), rng() % 100000, rng() % 2000);
+        msg.pos_valid = rng() % 50 != 0 ? TRUE : FALSE;
+        index.update(t, msg);
+        model[t] = Model{msg.edge_id, msg.offset, msg.uncertainty, msg.pos_valid == TRUE};
+
+        UShort edge = (UShort)(1 + rng() % 8);
+        ULong at = rng() % 100000;
+        ULong distance = rng() % 5000;
+        size_t n = index.within(edge, at, distance, hits, trains);
+        size_t expected = 0;
+        for (TrainId k = 0; k < trains; ++k) {
+            const Model &m = model[k];
+            ULong gap = m.offset > at ? m.offset - at : at - m.offset;
+            if (m.indexed && m.edge == edge && gap <= distance + m.uncertainty) {
+                ++expected;
+            }
+        }
+        bool sorted = true;
+        for (size_t i = 1; i < n; ++i) {
+            sorted = sorted && hits[i - 1].offset <= hits[i].offset;
+        }
+        if (n != expected || !sorted) {
+            ++mismatches;
+        }
+    }
+    printf("scan check:   200000 updates/queries, %lu mismatches\n", mismatches);
+    expect(mismatches == 0, "index agrees with a brute-force scan");
+}
+
+struct Result
+{
+    unsigned long updates = 0;
+    unsigned long queries = 0;
+    unsigned long hits = 0;
+    unsigned long bad = 0;
+    LatencyHistogram latency;
+};
+
+static void writer(PositionIndex &index, unsigned int id, unsigned int writers, TrainId trains, unsigned long rate,
+                   const std::atomic<bool> &running, Result &result)
+{
+    std::mt19937 rng(1000 + id);
+    std::vector<ngps_output> mine;
+    std::vector<TrainId> ids;
+    for (TrainId t = (TrainId)id; t < trains; t = (TrainId)(t + writers)) {
+        ngps_output msg = report((UShort)(1 + rng() % EDGES), rng() % EDGE_LENGTH, 10 + rng() % 500);
+        msg.speed = 1000 + rng() % 25000;
+        mine.push_back(msg);
+        ids.push_back(t);
+    }
+    Clock::duration period = rate ? std::chrono::nanoseconds(1000000000ULL / rate) : Clock::duration(0);
+    Clock::time_point next = Clock::now();
+    for (size_t i = 0; running.load(std::memory_order_relaxed); i = (i + 1) % mine.size()) {
+        ngps_output &msg = mine[i];
+        msg.offset += msg.speed / 10;                  /* 100 ms of travel per report */
+        if (msg.offset >= EDGE_LENGTH) {
+            msg.offset -= EDGE_LENGTH;
+            msg.edge_id = (UShort)(msg.edge_id % EDGES + 1);
+        }
+        index.update(ids[i], msg);
+        ++result.updates;
+        if (rate) {
+            next += period;
+            std::this_thread::sleep_until(next);
+        }
+    }
+}
+
+static void reader(const PositionIndex &index, unsigned int id, const std::atomic<bool> &running, Result &result)
+{
+    std::mt19937 rng(2000 + id);
+    PositionHit hits[64];
+    while (running.load(std::memory_order_relaxed)) {
+        UShort edge = (UShort)(1 + rng() % EDGES);
+        ULong at = rng() % EDGE_LENGTH;
+        ULong distance = rng() % 20000;
+        bool timed = result.queries % 63 == 0;
+        Clock::time_point start;
+        if (timed) {
+            start = Clock::now();
+        }
+        size_t n;
+        if (result.queries & 1) {
+            n = index.within(edge, at, distance, hits, LENGTHOF(hits));
+        }
+        else {
+            n = index.nearestAhead(edge, at, (rng() & 1) ? TRUE : FALSE, hits[0]) ? 1 : 0;
+            distance = EDGE_LENGTH;
+        }
+        if (timed) {
+            result.latency.record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+        }
+        for (size_t i = 0; i < MIN(n, LENGTHOF(hits)); ++i) {
+            uint64_t gap = (uint64_t)(hits[i].offset > (int64_t)at ? hits[i].offset - (int64_t)at : (int64_t)at - hits[i].offset);
+            if (gap > distance + hits[i].uncertainty || (i > 0 && hits[i - 1].offset > hits[i].offset)) {
+                ++result.bad;
+            }
+        }
+        result.hits += n;
+        ++result.queries;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long trains = argc > 1 ? strtoul(argv[1], NULL, 10) : 2000;
+    unsigned int writers = argc > 2 ? (unsigned int)strtoul(argv[2], NULL, 10) : 2;
+    unsigned int readers = argc > 3 ? (unsigned int)strtoul(argv[3], NULL, 10) : 2;
+    unsigned long rate = argc > 4 ? strtoul(argv[4], NULL, 10) : 0;
+    double seconds = argc > 5 ? atof(argv[5]) : 2.0;
+    trains = MIN(MAX(trains, 1UL), (unsigned long)MAX_UNSIGNED_SHORT);
+    writers = MAX(writers, 1u);
+
+    checkQueries();
+    checkAgainstScan(20001);
+    printf("checks:       %lu failed\n", failures);
+
+    PositionIndexConfig config;
+    config.perEdgeCapacity = 64;
+    PositionIndex index(config);
+    std::atomic<bool> running(true);
+    std::vector<Result> writeResults(writers), readResults(readers);
+    std::vector<std::thread> threads;
+    for (unsigned int w = 0; w < writers; ++w) {
+        threads.emplace_back(writer, std::ref(index), w, writers, (TrainId)trains, rate, std::cref(running),
+                             std::ref(writeResults[w]));
+    }
+    for (unsigned int r = 0; r < readers; ++r) {
+        threads.emplace_back(reader, std::cref(index), r, std::cref(running), std::ref(readResults[r]));
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    running.store(false);
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+
+    Result total;
+    for (size_t i = 0; i < writeResults.size(); ++i) {
+        total.updates += writeResults[i].updates;
+    }
+    for (size_t i = 0; i < readResults.size(); ++i) {
+        total.queries += readResults[i].queries;
+        total.hits += readResults[i].hits;
+        total.bad += readResults[i].bad;
+        total.latency.merge(readResults[i].latency);
+    }
+    printf("load:         %lu trains on %d edges, %u writers, %u readers, %.1f s\n", trains, EDGES, writers, readers,
+           seconds);
+    printf("updates:      %.0f/s   queries: %.0f/s   hits/query: %.2f   bad results: %lu   overflows: %lu\n",
+           total.updates / seconds, total.queries / seconds, total.queries ? (double)total.hits / total.queries : 0.0,
+           total.bad, index.overflows());
+    total.latency.print("query");
+    return failures == 0 && total.bad == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,201 @@
+/*
+ * Periodic retransmission: re-encoding the whole ngps_output every cycle against patching offset
+ * and speed in an NgpsPreparedMessage.
+ *
+ * Checks on a motion trace that each patched message decodes (NgpsCodec and unpack + convert) to
+ * the template with that cycle's offset and speed. Then times message preparation alone, and a
+ * sender paced at the target rate into an undrained loopback socket, reporting the busy time per
+ * message (preparation + sendto, pacing excluded) and the rate achieved.
+ *
+ * usage: preparedBench [messages] [rate msg/s]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "ngpsOutput.h"
+#include "ngpsTrace.h"
+#include "latencyHistogram.h"
+#include "allocCount.h"
+
+typedef std::chrono::steady_clock Clock;
+
+typedef DIRECT_FIELD(ngps_output, offset) OffsetField;
+typedef DIRECT_FIELD(ngps_output, speed) SpeedField;
+
+static_assert(NgpsPreparedMessage::offsetOf<OffsetField>() == 1 + 3, "offset position");
+static_assert(NgpsPreparedMessage::offsetOf<SpeedField>() == 1 + 3 + 5 + 5 + 1, "speed position");
+
+static unsigned long verify(const ngps_output &base, const std::vector<ngps_output> &trace)
+{
+    unsigned long bad = 0;
+    NgpsPreparedMessage msg;
+    if (msg.prepare(base) != RETURN_SUCCESS) {
+        return 1;
+    }
+    for (size_t i = 0; i < trace.size(); ++i) {
+        ngps_output expected = base;
+        expected.offset = trace[i].offset;
+        expected.speed = trace[i].speed;
+        if (!msg.set<OffsetField>(expected.offset) || !msg.set<SpeedField>(expected.speed)) {
+            ++bad;
+            continue;
+        }
+        ngps_output direct;
+        msgpack::object_handle oh = msgpack::unpack(msg.data(), msg.size());
+        if (msg.size() != NGPS_OUTPUT_WIRE32_SIZE || NgpsCodec::decode(msg.data(), msg.size(), direct) != DIRECT_CODEC_OK ||
+            direct != expected || oh.get().as<ngps_output>() != expected) {
+            fprintf(stderr, "patched message %zu does not decode to the expected record\n", i);
+            ++bad;
+        }
+    }
+
+    // A value beyond 32 bits is refused and leaves the message as it was
+    std::string before(msg.data(), msg.size());
+    if (msg.set<OffsetField>((ULong)MAX_UNSIGNED_LONG + 1) || before != std::string(msg.data(), msg.size())) {
+        fprintf(stderr, "out-of-range patch accepted\n");
+        ++bad;
+    }
+    return bad;
+}
+
+static uint64_t nowNs()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+struct SendResult
+{
+    LatencyHistogram busy;      /* ns per message spent preparing and sending */
+    double rate = 0;            /* messages/s achieved */
+    unsigned long errors = 0;
+};
+
+/* Send trace.size() messages at rate msg/s; build(i, buf) returns the bytes to send for message i */
+template <typename Build>
+static void pacedSend(int fd, const sockaddr_in &to, size_t count, double rate, Build build, SendResult &result)
+{
+    result.busy.reset();
+    uint64_t interval = (uint64_t)(1e9 / rate);
+    uint64_t start = nowNs();
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t due = start + i * interval;
+        uint64_t t0 = nowNs();
+        while (t0 < due) {
+            t0 = nowNs();
+        }
+        const char *data;
+        size_t size = build(i, data);
+        if (sendto(fd, data, size, MSG_DONTWAIT, (const struct sockaddr *)&to, sizeof(to)) != (ssize_t)size) {
+            ++result.errors;
+        }
+        result.busy.record(nowNs() - t0);
+    }
+    result.rate = count / ((nowNs() - start) / 1e9);
+}
+
+template <typename Body>
+static double nsPerMessage(size_t count, unsigned int rounds, Body body)
+{
+    Clock::time_point start = Clock::now();
+    for (unsigned int r = 0; r < rounds; ++r) {
+        body();
+    }
+    std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+    return elapsed.count() / ((double)count * rounds);
+}
+
+int main(int argc, char **argv)
+{
+    size_t messages = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+    double rate = argc > 2 ? strtod(argv[2], NULL) : 200000;
+
+    std::vector<ngps_output> trace = makeNgpsMotionTrace(1, messages);
+    ngps_output base = trace[0];
+    unsigned long bad = verify(base, trace);
+    printf("patch check:  %zu messages, %lu failures\n", messages, bad);
+
+    // Preparation cost alone
+    volatile size_t sink = 0;
+    ngps_output current = base;
+    NgpsPreparedMessage prepared;
+    prepared.prepare(base);
+    double packNs = nsPerMessage(messages, 10, [&]() {
+        for (size_t i = 0; i < messages; ++i) {
+            current.offset = trace[i].offset;
+            current.speed = trace[i].speed;
+            NgpsPackBuffer pbuf;
+            msgpack::pack(pbuf, current);
+            escape(pbuf.data());
+            sink = sink + pbuf.size();
+        }
+    });
+    double encodeNs = nsPerMessage(messages, 10, [&]() {
+        for (size_t i = 0; i < messages; ++i) {
+            current.offset = trace[i].offset;
+            current.speed = trace[i].speed;
+            char buf[NGPS_OUTPUT_MAX_PACKED_SIZE];
+            sink = sink + NgpsCodec::encode(current, buf, sizeof(buf));
+            escape(buf);
+        }
+    });
+    double patchNs = nsPerMessage(messages, 10, [&]() {
+        for (size_t i = 0; i < messages; ++i) {
+            prepared.set<OffsetField>(trace[i].offset);
+            prepared.set<SpeedField>(trace[i].speed);
+            escape(prepared.data());
+            sink = sink + (size_t)prepared.data()[prepared.offsetOf<SpeedField>() + 4];
+        }
+    });
+
+    // Paced sends into a socket nobody reads
+    int sinkFd = socket(AF_INET, SOCK_DGRAM, 0);
+    int tx = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(to);
+    if (sinkFd < 0 || tx < 0 || bind(sinkFd, (const struct sockaddr *)&to, sizeof(to)) < 0 ||
+        getsockname(sinkFd, (struct sockaddr *)&to, &len) < 0) {
+        perror("socket setup failed");
+        return EXIT_FAILURE;
+    }
+
+    SendResult packed, patched;
+    NgpsPackBuffer pbuf;
+    pacedSend(tx, to, messages, rate, [&](size_t i, const char *&data) {
+        current.offset = trace[i].offset;
+        current.speed = trace[i].speed;
+        pbuf.clear();
+        msgpack::pack(pbuf, current);
+        data = pbuf.data();
+        return pbuf.size();
+    }, packed);
+    pacedSend(tx, to, messages, rate, [&](size_t i, const char *&data) {
+        prepared.set<OffsetField>(trace[i].offset);
+        prepared.set<SpeedField>(trace[i].speed);
+        data = prepared.data();
+        return prepared.size();
+    }, patched);
+    close(sinkFd);
+    close(tx);
+
+    printf("prepare  pack<ngps_output>        %7.2f ns/msg (%zu bytes)\n", packNs, pbuf.size());
+    printf("prepare  NgpsCodec::encode        %7.2f ns/msg\n", encodeNs);
+    printf("prepare  NgpsPreparedMessage::set %7.2f ns/msg (%d bytes, x%.1f vs pack)\n", patchNs,
+           NGPS_OUTPUT_WIRE32_SIZE, packNs / patchNs);
+    const char *names[] = {"pack + sendto", "patch + sendto"};
+    const SendResult *results[] = {&packed, &patched};
+    for (size_t k = 0; k < LENGTHOF(results); ++k) {
+        const SendResult &r = *results[k];
+        printf("send     %-24s %7.0f msg/s  busy p50 %5llu ns  p99 %6llu ns  max %7llu ns  errors %lu\n", names[k],
+               r.rate, (unsigned long long)r.busy.percentile(0.5), (unsigned long long)r.busy.percentile(0.99),
+               (unsigned long long)r.busy.max(), r.errors);
+    }
+    return bad == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,126 @@
+/*
+ * Reject throughput under a malformed-datagram flood. A pool of datagrams, `malformed` percent of
+ * them broken by NgpsMutator (only mutations that are actually invalid are kept; validatorFuzz
+ * checks that the validator and msgpack agree on which those are), the rest valid, goes through
+ * two receive paths:
+ *   - msgpack + catch:   unpack into an UnpackArena (with ngpsUnpackLimit(), or a huge declared
+ *                        count allocates gigabytes) and convert<ngps_output>, a throw per reject
+ *   - validator decode:  NgpsValidator::check decoding into the record (UdpBatchReceiver,
+ *                        UdpServer workers)
+ * Both paths must accept and decode the same records. Reports ns and Mdatagram/s overall, for the
+ * flood and for a clean stream (malformed 0), and the validator's rejects per reason.
+ *
+ * usage: rejectBench [datagrams] [rounds] [malformed percent]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+#include "ngpsValidator.h"
+#include "unpackArena.h"
+#include "ngpsTrace.h"
+#include "ngpsMutator.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct Pool
+{
+    std::vector<std::vector<char> > datagrams;
+    std::vector<ngps_output> records;       /* decoded record of each valid datagram */
+    std::vector<SysBool> valid;
+};
+
+static Pool makePool(size_t count, unsigned int malformed)
+{
+    std::vector<ngps_output> trace = makeNgpsTrace(count);
+    NgpsMutator mutator;
+    std::mt19937 rng(20001);
+    std::uniform_int_distribution<unsigned int> percent(0, 99);
+
+    Pool pool;
+    for (size_t i = 0; i < count; ++i) {
+        NgpsPackBuffer buf;
+        msgpack::pack(buf, trace[i]);
+        std::vector<char> d(buf.data(), buf.data() + buf.size());
+        SysBool valid = trace[i].pos_valid && trace[i].edge_id == 0 ? FALSE : TRUE;
+        if (percent(rng) < malformed) {
+            NgpsValidator reference;
+            std::vector<char> m;
+            do {
+                m = mutator.mutate(d);
+            } while (reference.check(m.data(), m.size()) == NGPS_ACCEPT);
+            d.swap(m);
+            valid = FALSE;
+        }
+        pool.datagrams.push_back(d);
+        pool.records.push_back(trace[i]);
+        pool.valid.push_back(valid);
+    }
+    return pool;
+}
+
+template <typename Receive>
+static unsigned long run(const char *name, const Pool &pool, unsigned long rounds, Receive receive)
+{
+    unsigned long bad = 0;
+    unsigned long accepted = 0;
+    ngps_output r;
+    Clock::time_point start = Clock::now();
+    for (unsigned long round = 0; round < rounds; ++round) {
+        for (size_t i = 0; i < pool.datagrams.size(); ++i) {
+            const std::vector<char> &d = pool.datagrams[i];
+            SysBool ok = receive(d.data(), d.size(), r);
+            if (ok != pool.valid[i] || (ok && !(r == pool.records[i]))) {
+                ++bad;
+            }
+            accepted += ok ? 1 : 0;
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    unsigned long datagrams = rounds * pool.datagrams.size();
+    printf("  %-18s %7.1f ns/datagram %7.2f Mdatagram/s %lu accepted %lu bad\n", name, ns / datagrams,
+           datagrams / ns * 1e3, accepted, bad);
+    return bad;
+}
+
+static unsigned long runMix(size_t count, unsigned long rounds, unsigned int malformed)
+{
+    Pool pool = makePool(count, malformed);
+    printf("%u%% malformed, %zu datagrams x %lu rounds\n", malformed, count, rounds);
+    unsigned long bad = 0;
+
+    UnpackArena arena;
+    bad += run("msgpack + catch", pool, rounds, [&](const char *data, size_t size, ngps_output &r) {
+        try {
+            size_t off = 0;
+            arena.unpack(data, size, off, ngpsUnpackLimit()).convert(r);
+            return off == size && !(r.pos_valid && r.edge_id == 0) ? TRUE : FALSE;
+        }
+        catch (...) {
+            return FALSE;
+        }
+    });
+
+    NgpsValidator validator;
+    bad += run("validator decode", pool, rounds, [&](const char *data, size_t size, ngps_output &r) {
+        return validator.check(data, size, &r) == NGPS_ACCEPT ? TRUE : FALSE;
+    });
+
+    printf("  rejects:");
+    for (int reason = NGPS_REJECT_TRUNCATED; reason < NGPS_REJECT_REASONS; ++reason) {
+        printf(" %s %lu", ngpsRejectNames[reason], validator.count((NgpsReject)reason) / rounds);
+    }
+    printf(" (per round)\n");
+    return bad;
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+    unsigned long rounds = argc > 2 ? strtoul(argv[2], NULL, 10) : 10;
+    unsigned int malformed = argc > 3 ? (unsigned int)strtoul(argv[3], NULL, 10) : 90;
+
+    unsigned long bad = runMix(count, rounds, MIN(malformed, 100u));
+    bad += runMix(count, rounds, 0);
+    return bad == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
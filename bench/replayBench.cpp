@@ -0,0 +1,164 @@
+/*
+ * Capture and replay: writes a trace to a CaptureWriter log, checks every logged datagram with
+ * msgpack::unpack + convert<ngps_output>, then replays it over loopback
+ *   - at max speed into a socket nobody reads, counting heap allocations (expected: none)
+ *   - at max speed to a receiver thread that decodes and compares every datagram with the trace
+ *   - paced at 1x and 10x, reporting schedule accuracy
+ *
+ * usage: replayBench [records] [intervalUs] [path]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "captureLog.h"
+#include "allocCount.h"
+#include "ngpsTrace.h"
+#include "loopbackSocket.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static SysBool decodesTo(const char *data, size_t length, const ngps_output &expected)
+{
+    try {
+        msgpack::object_handle oh = msgpack::unpack(data, length);
+        return oh.get().as<ngps_output>() == expected ? TRUE : FALSE;
+    }
+    catch (const std::exception &) {
+        return FALSE;
+    }
+}
+
+struct ReceiveResult
+{
+    unsigned long received = 0;
+    unsigned long matched = 0;
+    unsigned long skipped = 0;      /* trace records never seen (dropped by the socket) */
+};
+
+/* Decode datagrams in arrival order and match them against the trace, allowing for drops */
+static void receiveAndCheck(int fd, const std::vector<ngps_output> &trace, std::atomic<bool> &done,
+                            ReceiveResult &result)
+{
+    struct timeval tv = {0, 100000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    char buffer[MAXLINE];
+    size_t next = 0;
+    while (next < trace.size()) {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n < 0) {
+            if (done.load()) {
+                break;
+            }
+            continue;
+        }
+        ++result.received;
+        for (size_t k = next; k < trace.size(); ++k) {
+            if (decodesTo(buffer, (size_t)n, trace[k])) {
+                result.skipped += k - next;
+                ++result.matched;
+                next = k + 1;
+                break;
+            }
+        }
+    }
+    result.skipped += trace.size() - next;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long records = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+    unsigned long intervalUs = argc > 2 ? strtoul(argv[2], NULL, 10) : 100;
+    const char *path = argc > 3 ? argv[3] : "/tmp/replayBench.cap";
+
+    std::vector<ngps_output> trace = makeNgpsTrace(records);
+    sockaddr_in source;
+    memset(&source, 0, sizeof(source));
+    source.sin_family = AF_INET;
+    source.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    source.sin_port = htons(PORT);
+
+    // Capture
+    CaptureWriter writer;
+    if (writer.open(path) != RETURN_SUCCESS) {
+        perror("capture open failed");
+        return EXIT_FAILURE;
+    }
+    Clock::time_point start = Clock::now();
+    for (unsigned long i = 0; i < records; ++i) {
+        NgpsPackBuffer buf;
+        msgpack::pack(buf, trace[i]);
+        if (writer.append(1000000000ULL + i * intervalUs * 1000ULL, source, buf.data(), buf.size()) != RETURN_SUCCESS) {
+            perror("capture append failed");
+            return EXIT_FAILURE;
+        }
+    }
+    double captureSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    writer.close();
+    printf("capture:      %lu records, %.1f Mrec/s append\n", records, records / captureSeconds / 1e6);
+
+    // Offline check of the log contents
+    CaptureReader reader;
+    if (reader.open(path) != RETURN_SUCCESS || reader.size() != records) {
+        fprintf(stderr, "capture reopen failed\n");
+        return EXIT_FAILURE;
+    }
+    unsigned long bad = 0;
+    for (unsigned long i = 0; i < records; ++i) {
+        CaptureRecord r;
+        if (!reader.record(i, r) || !decodesTo(r.data, r.length, trace[i]) ||
+            r.from.sin_port != source.sin_port || r.timestampNs != 1000000000ULL + i * intervalUs * 1000ULL) {
+            ++bad;
+        }
+    }
+    printf("log check:    %lu records, %lu bad\n", records, bad);
+
+    sockaddr_in sinkAddr, rxAddr, txAddr;
+    int sink = openLoopback(sinkAddr);
+    int rx = openLoopback(rxAddr);
+    int tx = openLoopback(txAddr);
+
+    // Max speed into an unread socket: only the replay path itself is measured
+    ReplayConfig config;
+    config.speed = 0;
+    ReplayStats stats;
+    unsigned long allocs = allocCount();
+    replayCapture(reader, tx, sinkAddr, config, stats);
+    allocs = allocCount() - allocs;
+    printf("replay max:   %lu sent, %.2f Mrec/s, %lu heap allocations\n", stats.sent,
+           stats.sent / (stats.elapsedNs / 1e9) / 1e6, allocs);
+
+    // Max speed with a decoding receiver
+    std::atomic<bool> done(false);
+    ReceiveResult result;
+    std::thread receiver(receiveAndCheck, rx, std::cref(trace), std::ref(done), std::ref(result));
+    replayCapture(reader, tx, rxAddr, config, stats);
+    done.store(true);
+    receiver.join();
+    printf("replay check: %lu received, %lu matched convert<ngps_output>, %lu dropped by the socket\n",
+           result.received, result.matched, result.skipped);
+
+    // Paced replay of the first second of capture time at 1x and 10x
+    const double speeds[] = {1.0, 10.0};
+    for (size_t s = 0; s < LENGTHOF(speeds); ++s) {
+        config.speed = speeds[s];
+        config.count = MIN(records, 1000000UL / MAX(intervalUs, 1UL));
+        replayCapture(reader, tx, sinkAddr, config, stats);
+        double expected = (double)(config.count - 1) * intervalUs / 1e6 / speeds[s];
+        printf("replay %4.0fx: %lu sent in %.4f s (schedule %.4f s), max late %.1f us\n", speeds[s], stats.sent,
+               stats.elapsedNs / 1e9, expected, stats.maxLateNs / 1e3);
+    }
+
+    close(sink);
+    close(rx);
+    close(tx);
+    unlink(path);
+    std::string idx = std::string(path) + CAPTURE_INDEX_SUFFIX;
+    unlink(idx.c_str());
+    return bad == 0 && allocs == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
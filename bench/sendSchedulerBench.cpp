@@ -0,0 +1,225 @@
+/*
+ * SendScheduler: checks the interval policy and rescheduling (add, update bringing a report
+ * forward, remove, catching up after a stall), then drives N sources from a synthetic trace for
+ * a few seconds on one thread, sleeping until each tick and sending every due source through one
+ * UdpBatchSender flush per wakeup to a socket nobody reads.
+ *
+ * Reports the lateness of every report against its due time, the achieved rate of each source
+ * against the rate its interval asks for (worst and mean error over sources with enough reports),
+ * and the cost of a wakeup.
+ *
+ * usage: sendSchedulerBench [sources] [seconds] [send 0|1]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <math.h>
+#include <vector>
+#include "sendScheduler.h"
+#include "udpBatch.h"
+#include "ngpsTrace.h"
+#include "latencyHistogram.h"
+
+#define SECOND  (1000000000ULL)
+#define MS      (1000000ULL)
+
+static unsigned long failures = 0;
+
+static void expect(bool ok, const char *what)
+{
+    if (!ok) {
+        ++failures;
+        fprintf(stderr, "check failed: %s\n", what);
+    }
+}
+
+static uint64_t nowNs(clockid_t clock = CLOCK_MONOTONIC)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * SECOND + (uint64_t)ts.tv_nsec;
+}
+
+static void sleepUntil(uint64_t due)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t)(due / SECOND);
+    ts.tv_nsec = (long)(due % SECOND);
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+static void checkScheduler()
+{
+    SendSchedulerConfig config;
+    ngps_output s;
+    s.speed = 20000;
+    s.accel = 0;
+    expect(sendIntervalNs(config, s) == 100 * MS, "20 m/s: one report per 2 m");
+    s.accel = -20000;
+    expect(sendIntervalNs(config, s) == config.minIntervalNs, "hard braking: clamped to minIntervalNs");
+    s.speed = 100;
+    s.accel = 0;
+    expect(sendIntervalNs(config, s) == config.maxIntervalNs, "creeping: clamped to maxIntervalNs");
+    s.stationary = TRUE;
+    expect(sendIntervalNs(config, s) == config.stationaryIntervalNs, "stationary");
+
+    std::vector<SendDue> seen;
+    SendScheduler scheduler(config, [&](const SendDue *due, size_t count, uint64_t) {
+        seen.insert(seen.end(), due, due + count);
+    }, 0);
+
+    ngps_output fast, slow;
+    fast.speed = 20000;             /* 100 ms */
+    slow.speed = 2000;              /* 1 s */
+    SendSourceId a = scheduler.add(fast, 10 * MS);
+    SendSourceId b = scheduler.add(slow, 10 * MS);
+    SendSourceId c = scheduler.add(slow, 500 * MS);
+    expect(scheduler.size() == 3, "three sources");
+
+    expect(scheduler.run(9 * MS) == 0, "nothing due before 10 ms");
+    expect(scheduler.run(10 * MS) == 2 && seen.size() == 2, "two sources due at 10 ms, one batch");
+    expect(scheduler.run(109 * MS) == 0, "fast source not due before 110 ms");
+    seen.clear();
+    expect(scheduler.run(110 * MS) == 1 && seen[0].id == a && seen[0].dueNs == 110 * MS, "fast source at 110 ms");
+
+    // b is next due at 1010 ms; speeding up brings it to 10 + 100 ms, i.e. the next tick
+    scheduler.update(b, fast);
+    seen.clear();
+    expect(scheduler.run(111 * MS) == 1 && seen[0].id == b && seen[0].dueNs == 110 * MS, "update brings b forward");
+
+    scheduler.remove(c);
+    expect(scheduler.size() == 2, "c removed");
+    SendSourceId d = scheduler.add(slow, 10 * SECOND);
+    expect(d == c, "ids are reused");
+
+    // A 30 s stall (longer than the 8.192 s wheel): every source runs once and skips what it missed
+    seen.clear();
+    size_t ran = scheduler.run(30 * SECOND + 5 * MS);
+    expect(ran == 3 && seen.size() == 3, "one report per source after a stall");
+    seen.clear();
+    expect(scheduler.run(30 * SECOND + 6 * MS) == 0, "no burst after a stall");
+    expect(scheduler.run(30 * SECOND + 10 * MS) == 2, "fast sources back on their 100 ms grid");
+}
+
+struct SourceStats
+{
+    uint64_t firstNs = 0;
+    uint64_t lastNs = 0;
+    unsigned long reports = 0;
+};
+
+int main(int argc, char **argv)
+{
+    unsigned long sources = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000;
+    unsigned long seconds = argc > 2 ? strtoul(argv[2], NULL, 10) : 5;
+    int send = argc > 3 ? atoi(argv[3]) : 1;
+
+    checkScheduler();
+    printf("checks:       %lu failed\n", failures);
+
+    int sink = socket(AF_INET, SOCK_DGRAM, 0);
+    int tx = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sink < 0 || tx < 0) {
+        perror("socket creation failed");
+        return EXIT_FAILURE;
+    }
+    sockaddr_in sinkAddr;
+    memset(&sinkAddr, 0, sizeof(sinkAddr));
+    sinkAddr.sin_family = AF_INET;
+    sinkAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(sink, (const struct sockaddr *)&sinkAddr, sizeof(sinkAddr)) < 0) {
+        perror("bind failed");
+        return EXIT_FAILURE;
+    }
+    socklen_t len = sizeof(sinkAddr);
+    getsockname(sink, (struct sockaddr *)&sinkAddr, &len);
+    UdpBatchSender sender(tx, sinkAddr);
+
+    std::vector<ngps_output> states = makeNgpsTrace(sources);
+    std::vector<SourceStats> stats(sources);
+    LatencyHistogram late;
+    LatencyHistogram wakeup;
+    unsigned long wakeups = 0;
+    unsigned long reports = 0;
+    unsigned long sent = 0;
+
+    uint64_t start = nowNs();
+    uint64_t end = start + seconds * SECOND;
+    SendSchedulerConfig config;
+    SendScheduler scheduler(config, [&](const SendDue *due, size_t count, uint64_t now) {
+        for (size_t i = 0; i < count; ++i) {
+            late.record(now - due[i].dueNs);
+            SourceStats &s = stats[due[i].id];
+            if (s.reports++ == 0) {
+                s.firstNs = now;
+            }
+            s.lastNs = now;
+            if (send) {
+                int n = sender.send(states[due[i].id]);
+                sent += n > 0 ? (unsigned long)n : 0;
+            }
+        }
+        if (send) {
+            int n = sender.flush();
+            sent += n > 0 ? (unsigned long)n : 0;
+        }
+        reports += count;
+    }, start);
+
+    // First reports spread over each source's own interval, as sources joining at random times would
+    double expectedRate = 0;
+    for (unsigned long i = 0; i < sources; ++i) {
+        uint64_t interval = sendIntervalNs(config, states[i]);
+        scheduler.add(states[i], start + (i * 7919 * MS) % interval);
+        expectedRate += (double)SECOND / interval;
+    }
+
+    uint64_t cpuStart = nowNs(CLOCK_PROCESS_CPUTIME_ID);
+    for (;;) {
+        uint64_t next = scheduler.nextTickNs();
+        if (next >= end) {
+            break;
+        }
+        sleepUntil(next);
+        uint64_t t0 = nowNs();
+        if (scheduler.run(t0) != 0) {
+            wakeup.record(nowNs() - t0);
+            ++wakeups;
+        }
+    }
+    double cpu = (nowNs(CLOCK_PROCESS_CPUTIME_ID) - cpuStart) / 1e9;
+    double elapsed = (nowNs() - start) / 1e9;
+
+    // Achieved rate per source: (reports - 1) over the time from first to last report
+    double worst = 0;
+    double sum = 0;
+    unsigned long measured = 0;
+    for (unsigned long i = 0; i < sources; ++i) {
+        const SourceStats &s = stats[i];
+        if (s.reports < 10) {
+            continue;
+        }
+        double achieved = (s.reports - 1) * 1e9 / (double)(s.lastNs - s.firstNs);
+        double wanted = (double)SECOND / scheduler.intervalNs(i);
+        double error = fabs(achieved - wanted) / wanted;
+        worst = MAX(worst, error);
+        sum += error;
+        ++measured;
+    }
+
+    printf("sources:      %lu over %.2f s, %lu reports (%.0f/s, policy asks %.0f/s), %lu sent\n", sources, elapsed,
+           reports, reports / elapsed, expectedRate, sent);
+    printf("wakeups:      %lu, %.1f reports per wakeup, CPU %.1f%% of one core\n", wakeups,
+           wakeups ? (double)reports / wakeups : 0.0, 100.0 * cpu / elapsed);
+    printf("rate error:   %lu sources with >= 10 reports, mean %.3f%% worst %.3f%%\n", measured,
+           measured ? 100.0 * sum / measured : 0.0, 100.0 * worst);
+    late.print("lateness");
+    wakeup.print("wakeup run()");
+
+    close(sink);
+    close(tx);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,177 @@
+/*
+ * Sequenced stream under injected loss, duplication and reordering: `senders` streams of
+ * `messages` records each go through an ImpairingRelay to one UdpSequencedReceiver. Checks that
+ * every sender's records are released in strictly increasing sequence order with no duplicates,
+ * that each payload is the one stamped with its sequence, and that released + lost accounts for
+ * every sequence number up to the last one released. Prints receiver counters next to the
+ * injected ones. Before that, a sender restarts 1000 datagrams in, well inside
+ * REORDER_RESYNC_DISTANCE; its new stream must be released from sequence 0 straight away.
+ *
+ * usage: sequenceBench [messages] [senders] [loss] [duplicate] [reorder] [depth]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <chrono>
+#include <vector>
+#include "udpSequence.h"
+#include "impairingRelay.h"
+#include "ngpsTrace.h"
+#include "loopbackSocket.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct StreamCheck
+{
+    SysBool any = FALSE;
+    uint32_t last = 0;
+    unsigned long released = 0;
+    unsigned long orderErrors = 0;
+    unsigned long payloadErrors = 0;
+};
+
+/* Release everything the receiver has for senderId into seqs */
+static void drainStream(UdpSequencedReceiver &receiver, UShort senderId, std::vector<uint32_t> &seqs)
+{
+    NgpsEnvelope out[REORDER_WINDOW];
+    int n;
+    while ((n = receiver.receive(out, LENGTHOF(out))) > 0) {
+        for (int k = 0; k < n; ++k) {
+            if (out[k].senderId == senderId) {
+                seqs.push_back(out[k].seq);
+            }
+        }
+    }
+}
+
+static SysBool checkRestart(int tx, int rx, const sockaddr_in &rxAddr)
+{
+    const UShort id = 77;
+    const uint32_t before = 1000, after = 100;
+    ngps_output msg;
+    UdpSequencedReceiver receiver(rx);
+    std::vector<uint32_t> seqs;
+
+    UdpSequencedSender first(tx, rxAddr, id);
+    for (uint32_t i = 0; i < before; ++i) {
+        first.send(msg);
+    }
+    drainStream(receiver, id, seqs);
+    SysBool ok = seqs.size() == before ? TRUE : FALSE;
+
+    seqs.clear();
+    UdpSequencedSender restarted(tx, rxAddr, id);
+    for (uint32_t i = 0; i < after; ++i) {
+        restarted.send(msg);
+    }
+    drainStream(receiver, id, seqs);
+    for (uint32_t i = 0; i < after; ++i) {
+        ok = ok && seqs.size() == after && seqs[i] == i ? TRUE : FALSE;
+    }
+    SequenceStats stats = receiver.stats();
+    ok = ok && stats.resyncs == 1 && stats.stale == 0 ? TRUE : FALSE;
+    printf("restart:     %zu of %u records after an early restart, resyncs %lu stale %lu: %s\n", seqs.size(),
+           after, stats.resyncs, stats.stale, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long messages = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+    unsigned int senderCount = argc > 2 ? (unsigned int)strtoul(argv[2], NULL, 10) : 4;
+    ImpairmentConfig impairment;
+    impairment.loss = argc > 3 ? atof(argv[3]) : 0.01;
+    impairment.duplicate = argc > 4 ? atof(argv[4]) : 0.01;
+    impairment.reorder = argc > 5 ? atof(argv[5]) : 0.02;
+    impairment.depth = argc > 6 ? (unsigned int)strtoul(argv[6], NULL, 10) : 3;
+
+    sockaddr_in txAddr, relayAddr, rxAddr;
+    int tx = openLoopback(txAddr);
+    int relayFd = openLoopback(relayAddr);
+    int rx = openLoopback(rxAddr);
+
+    SysBool restartOk = checkRestart(tx, rx, rxAddr);
+
+    std::vector<ngps_output> trace = makeNgpsTrace(messages);
+    std::vector<UdpSequencedSender> senders;
+    for (unsigned int s = 0; s < senderCount; ++s) {
+        senders.push_back(UdpSequencedSender(tx, relayAddr, (UShort)(s + 1)));
+    }
+    ImpairingRelay relay(relayFd, rxAddr, impairment);
+    UdpSequencedReceiver receiver(rx, std::chrono::microseconds(1000), std::chrono::microseconds(2000));
+
+    std::vector<StreamCheck> checks(senderCount + 1);
+    std::vector<NgpsEnvelope> out(256);
+    unsigned long received = 0;
+
+    Clock::time_point start = Clock::now();
+    for (unsigned long i = 0; i < messages; ++i) {
+        for (unsigned int s = 0; s < senderCount; ++s) {
+            senders[s].send(trace[i]);
+        }
+        if (i % 32 != 31 && i + 1 != messages) {
+            continue;
+        }
+        if (i + 1 == messages) {
+            relay.pump();
+            relay.flush();
+        }
+
+        for (;;) {
+            relay.pump();
+            int n = receiver.receive(out.data(), (unsigned int)out.size());
+            if (n <= 0) {
+                break;
+            }
+            for (int k = 0; k < n; ++k) {
+                const NgpsEnvelope &env = out[k];
+                if (env.senderId == 0 || env.senderId > senderCount) {
+                    continue;
+                }
+                StreamCheck &c = checks[env.senderId];
+                if (c.any && (int32_t)(env.seq - c.last) <= 0) {
+                    ++c.orderErrors;
+                }
+                if (env.seq >= messages || env.payload != trace[env.seq]) {
+                    ++c.payloadErrors;
+                }
+                c.any = TRUE;
+                c.last = env.seq;
+                ++c.released;
+            }
+            received += n;
+        }
+    }
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+
+    SequenceStats stats = receiver.stats();
+    const ImpairmentStats &injected = relay.stats();
+    unsigned long orderErrors = 0, payloadErrors = 0, accounted = 0, expected = 0;
+    for (unsigned int s = 1; s <= senderCount; ++s) {
+        orderErrors += checks[s].orderErrors;
+        payloadErrors += checks[s].payloadErrors;
+        accounted += checks[s].released;
+        expected += checks[s].any ? checks[s].last + 1 : 0;
+    }
+
+    printf("sent:        %lu (%u senders x %lu)\n", messages * senderCount, senderCount, messages);
+    printf("injected:    dropped %lu  duplicated %lu  reordered %lu (depth %u)\n",
+           injected.dropped, injected.duplicated, injected.reordered, impairment.depth);
+    printf("receiver:    delivered %lu  lost %lu  reordered %lu  duplicates %lu  stale %lu  resyncs %lu\n",
+           stats.delivered, stats.lost, stats.reordered, stats.duplicates, stats.stale, stats.resyncs);
+    printf("throughput:  %.0f msg/s\n", received / elapsed.count());
+    printf("order errors %lu  payload errors %lu  decode errors %lu\n",
+           orderErrors, payloadErrors, receiver.decodeErrors());
+    printf("accounting:  delivered + lost = %lu, last seq + 1 = %lu\n", stats.delivered + stats.lost, expected);
+
+    close(tx);
+    close(relayFd);
+    close(rx);
+
+    SysBool ok = (restartOk && orderErrors == 0 && payloadErrors == 0 && accounted == stats.delivered &&
+                  stats.delivered + stats.lost == expected) ? TRUE : FALSE;
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
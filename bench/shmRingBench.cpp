@@ -0,0 +1,216 @@
+/*
+ * Shared-memory ring against the UDP loopback path (UdpBatchSender / UdpBatchReceiver), both
+ * driven through the same send()/receive() calls.
+ *
+ * Checks first that two receivers on one ring each get every record of a trace intact (encoded
+ * and raw formats), and that a receiver overrun by the producer reports the records it lost.
+ * Then, with the receiver on its own thread:
+ *   - latency: records sent at a fixed rate carry their send time in offset; the receiver
+ *     records the one-way delay
+ *   - throughput: records sent back to back; delivered records/s and losses
+ *
+ * usage: shmRingBench [records] [rate msg/s]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "shmRing.h"
+#include "udpBatch.h"
+#include "ngpsTrace.h"
+#include "latencyHistogram.h"
+#include "loopbackSocket.h"
+
+#define RING_NAME   "/shmRingBench"
+
+static uint64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void sleepUntil(uint64_t due)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t)(due / 1000000000ULL);
+    ts.tv_nsec = (long)(due % 1000000000ULL);
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+static unsigned long checkRing(const std::vector<ngps_output> &trace, ShmRingFormat format)
+{
+    ShmRingConfig config;
+    config.capacity = (unsigned int)trace.size();
+    config.format = format;
+    ShmRingSender tx;
+    ShmRingReceiver a, b;
+    if (tx.open(RING_NAME, config) != RETURN_SUCCESS || a.open(RING_NAME) != RETURN_SUCCESS ||
+        b.open(RING_NAME, SHM_WAKE_BUSY_POLL) != RETURN_SUCCESS) {
+        fprintf(stderr, "ring open failed\n");
+        return 1;
+    }
+    for (size_t i = 0; i < trace.size(); ++i) {
+        tx.send(trace[i]);
+    }
+
+    unsigned long bad = 0;
+    ShmRingReceiver *receivers[] = {&a, &b};
+    std::vector<ngps_output> out(trace.size());
+    for (size_t k = 0; k < LENGTHOF(receivers); ++k) {
+        size_t got = 0;
+        while (got < trace.size()) {
+            int n = receivers[k]->receive(&out[got], (unsigned int)(trace.size() - got));
+            if (n <= 0) {
+                break;
+            }
+            got += (size_t)n;
+        }
+        for (size_t i = 0; i < trace.size(); ++i) {
+            if (i >= got || out[i] != trace[i]) {
+                ++bad;
+            }
+        }
+        bad += receivers[k]->lost() + receivers[k]->decodeErrors();
+    }
+
+    // A receiver more than capacity behind keeps the newest records and counts the rest as lost
+    config.capacity = 64;
+    ShmRingSender small;
+    ShmRingReceiver slow;
+    small.open(RING_NAME, config);
+    slow.open(RING_NAME);
+    for (size_t i = 0; i < 1000; ++i) {
+        small.send(trace[i % trace.size()]);
+    }
+    ngps_output latest[1000];
+    int n = slow.receive(latest, LENGTHOF(latest));
+    if (n != 64 || slow.lost() != 1000 - 64 || latest[63] != trace[999 % trace.size()]) {
+        fprintf(stderr, "overrun: received %d, lost %lu\n", n, slow.lost());
+        ++bad;
+    }
+    return bad;
+}
+
+struct RunResult
+{
+    LatencyHistogram delay;
+    unsigned long received = 0;
+    double seconds = 0;
+};
+
+template <typename Rx>
+static void receiveAll(Rx &rx, unsigned long expected, std::atomic<bool> &done, bool timed, RunResult &result)
+{
+    ngps_output batch[64];
+    while (result.received < expected) {
+        int n = rx.receive(batch, LENGTHOF(batch));
+        if (n < 0 || (n == 0 && done.load())) {
+            break;
+        }
+        uint64_t now = nowNs();
+        for (int i = 0; i < n; ++i) {
+            if (timed) {
+                result.delay.record(now - batch[i].offset);
+            }
+        }
+        result.received += (unsigned long)n;
+    }
+}
+
+/* rate 0 sends back to back; otherwise each record carries its send time in offset */
+template <typename Tx, typename Rx>
+static void run(Tx &tx, Rx &rx, const std::vector<ngps_output> &trace, double rate, RunResult &result)
+{
+    std::atomic<bool> done(false);
+    std::thread receiver([&]() { receiveAll(rx, trace.size(), done, rate > 0, result); });
+    usleep(10000);
+
+    uint64_t start = nowNs();
+    uint64_t interval = rate > 0 ? (uint64_t)(1e9 / rate) : 0;
+    for (size_t i = 0; i < trace.size(); ++i) {
+        if (rate > 0) {
+            sleepUntil(start + i * interval);
+            ngps_output r = trace[i];
+            r.offset = (ULong)nowNs();
+            tx.send(r);
+        }
+        else {
+            tx.send(trace[i]);
+        }
+    }
+    tx.flush();
+    done.store(true);
+    receiver.join();
+    result.seconds = (nowNs() - start) / 1e9;
+}
+
+/* mode < 0: UDP; otherwise a ring receiver in that ShmWakeMode */
+static void measure(const char *name, int mode, const std::vector<ngps_output> &trace, double rate)
+{
+    RunResult result;
+    if (mode < 0) {
+        sockaddr_in rxAddr, txAddr;
+        int rxFd = openLoopback(rxAddr);
+        int txFd = openLoopback(txAddr);
+        UdpBatchConfig config;
+        config.batchSize = rate > 0 ? 1 : 32;       /* no batching delay when measuring latency */
+        UdpBatchSender tx(txFd, rxAddr, config);
+        UdpBatchReceiver rx(rxFd, config);
+        run(tx, rx, trace, rate, result);
+        close(rxFd);
+        close(txFd);
+    }
+    else {
+        ShmRingConfig config;
+        config.capacity = 1 << 16;
+        ShmRingSender tx;
+        ShmRingReceiver rx;
+        if (tx.open(RING_NAME, config) != RETURN_SUCCESS || rx.open(RING_NAME, (ShmWakeMode)mode) != RETURN_SUCCESS) {
+            fprintf(stderr, "ring open failed\n");
+            exit(EXIT_FAILURE);
+        }
+        run(tx, rx, trace, rate, result);
+        if (rx.lost() > 0) {
+            printf("  (%s lost %lu records to overrun)\n", name, rx.lost());
+        }
+    }
+
+    if (rate > 0) {
+        result.delay.print(name);
+    }
+    else {
+        printf("%-16s %lu of %zu delivered, %.2f Mrec/s\n", name, result.received, trace.size(),
+               result.received / result.seconds / 1e6);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t records = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+    double rate = argc > 2 ? strtod(argv[2], NULL) : 20000;
+
+    std::vector<ngps_output> trace = makeNgpsTrace(records);
+    unsigned long bad = checkRing(std::vector<ngps_output>(trace.begin(), trace.begin() + MIN(records, (size_t)10000)),
+                                  SHM_RING_ENCODED);
+    bad += checkRing(std::vector<ngps_output>(trace.begin(), trace.begin() + MIN(records, (size_t)10000)),
+                     SHM_RING_RAW);
+    printf("ring check: %lu failures\n", bad);
+
+    std::vector<ngps_output> timed(trace.begin(), trace.begin() + MIN(records, (size_t)(rate * 2)));
+    printf("one-way latency at %.0f msg/s:\n", rate);
+    measure("udp", -1, timed, rate);
+    measure("shm futex", SHM_WAKE_FUTEX, timed, rate);
+    measure("shm busy-poll", SHM_WAKE_BUSY_POLL, timed, rate);
+
+    printf("throughput, %zu records back to back:\n", records);
+    measure("udp", -1, trace, 0);
+    measure("shm futex", SHM_WAKE_FUTEX, trace, 0);
+    measure("shm busy-poll", SHM_WAKE_BUSY_POLL, trace, 0);
+    return bad == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
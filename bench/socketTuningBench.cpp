@@ -0,0 +1,143 @@
+/*
+ * Socket tuning under load: a sender thread sends bursts of datagrams over loopback to a
+ * UdpTimedReceiver that spends a fixed amount of work on every record, once with a small receive
+ * buffer and once with the tuned one. For each run it reports what tuneSocket() was granted, the
+ * datagrams sent, received and counted as dropped by the socket (SO_MEMINFO), whether those add
+ * up, and the kernel-to-decode latency distribution (SO_TIMESTAMPNS to decoded).
+ *
+ * usage: socketTuningBench [records] [burst] [work ns per record] [busy poll us]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "socketTuning.h"
+#include "udpBatch.h"
+#include "ngpsTrace.h"
+#include "latencyHistogram.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct RunResult
+{
+    unsigned long sent = 0;
+    unsigned long received = 0;
+    unsigned long drops = 0;
+    unsigned long errors = 0;
+    unsigned long untimed = 0;
+    LatencyHistogram latency;
+};
+
+static void spin(unsigned long ns)
+{
+    Clock::time_point end = Clock::now() + std::chrono::nanoseconds(ns);
+    while (Clock::now() < end) {
+    }
+}
+
+static SysBool run(const char *name, const SocketTuning &tuning, const std::vector<ngps_output> &trace,
+                   unsigned int burst, unsigned long workNs)
+{
+    int rx = socket(AF_INET, SOCK_DGRAM, 0);
+    int tx = socket(AF_INET, SOCK_DGRAM, 0);
+    if (rx < 0 || tx < 0) {
+        perror("socket creation failed");
+        exit(EXIT_FAILURE);
+    }
+    SocketTuningReport granted;
+    int status = tuneSocket(rx, tuning, &granted);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(rx, (const struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind failed");
+        exit(EXIT_FAILURE);
+    }
+    socklen_t len = sizeof(addr);
+    getsockname(rx, (struct sockaddr *)&addr, &len);
+
+    RunResult result;
+    std::atomic<bool> done(false);
+    std::thread receiver([&]() {
+        UdpTimedReceiver timed(rx);
+        NgpsTimedRecord out[32];
+        for (;;) {
+            int n = timed.receive(out, LENGTHOF(out));
+            if (n <= 0) {
+                if (done.load()) {
+                    break;
+                }
+                continue;
+            }
+            for (int i = 0; i < n; ++i) {
+                if (out[i].kernelNs == 0) {
+                    ++result.untimed;
+                }
+                else {
+                    result.latency.record(out[i].latencyNs());
+                }
+                spin(workNs);
+            }
+            result.received += (unsigned long)n;
+        }
+        result.drops = timed.kernelDrops();
+        result.errors = timed.decodeErrors();
+    });
+
+    UdpBatchConfig config;
+    config.batchSize = MIN(burst, 1024u);
+    UdpBatchSender sender(tx, addr, config);
+    for (size_t i = 0; i < trace.size(); ++i) {
+        int n = sender.send(trace[i]);
+        result.sent += n > 0 ? (unsigned long)n : 0;
+        if ((i + 1) % burst == 0) {
+            n = sender.flush();
+            result.sent += n > 0 ? (unsigned long)n : 0;
+            std::this_thread::sleep_for(std::chrono::microseconds(burst * workNs / 2000));
+        }
+    }
+    int n = sender.flush();
+    result.sent += n > 0 ? (unsigned long)n : 0;
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    done.store(true);
+    receiver.join();
+    close(rx);
+    close(tx);
+
+    SysBool balanced = result.sent == result.received + result.drops && result.errors == 0 ? TRUE : FALSE;
+    printf("%-8s SO_RCVBUF %d (%s), timestamps %s, drop counter %s, busy poll %s\n", name, granted.receiveBuffer,
+           status == RETURN_SUCCESS ? "as requested" : "capped", granted.timestamps ? "on" : "off",
+           granted.dropCounter ? "on" : "off", granted.busyPoll ? "on" : "off");
+    printf("         sent %lu received %lu dropped %lu (%.2f%%), %s, %lu without timestamp\n", result.sent,
+           result.received, result.drops, result.sent ? 100.0 * result.drops / result.sent : 0.0,
+           balanced ? "sent = received + dropped" : "ACCOUNTING MISMATCH", result.untimed);
+    result.latency.print("         kernel->decode");
+    return balanced && result.untimed == 0 ? TRUE : FALSE;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long records = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+    unsigned int burst = argc > 2 ? (unsigned int)strtoul(argv[2], NULL, 10) : 2000;
+    unsigned long workNs = argc > 3 ? strtoul(argv[3], NULL, 10) : 2000;
+    unsigned int busyPollUs = argc > 4 ? (unsigned int)strtoul(argv[4], NULL, 10) : 0;
+    burst = MAX(burst, 1u);
+
+    std::vector<ngps_output> trace = makeNgpsTrace(records);
+
+    SocketTuning small;
+    small.receiveBuffer = 32 << 10;
+    small.busyPollUs = busyPollUs;
+    SocketTuning tuned;
+    tuned.busyPollUs = busyPollUs;
+
+    SysBool ok = run("small", small, trace, burst, workNs);
+    ok = run("tuned", tuned, trace, burst, workNs) && ok ? TRUE : FALSE;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
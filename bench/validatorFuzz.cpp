@@ -0,0 +1,119 @@
+/*
+ * Fuzz harness for NgpsValidator: seeded mutations of valid ngps_output encodings (NgpsMutator)
+ * checked against msgpack::unpack + convert<ngps_output> as the reference. For every input:
+ *   - check() must not throw
+ *   - it accepts exactly when the reference decodes the whole datagram (no trailing bytes) into a
+ *     record with a localized edge, and both give the same record
+ * The unmutated encodings must all be accepted, and with NgpsLimits::wire32() exactly those whose
+ * ULong fields fit 32 bits. Reports inputs per mutation, rejects per reason,
+ * and every disagreement (the first few in hex).
+ *
+ * usage: validatorFuzz [inputs] [seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "ngpsValidator.h"
+#include "ngpsTrace.h"
+#include "ngpsMutator.h"
+
+static const char *const mutationNames[MUTATIONS] = {"bit flip", "truncate", "insert", "overwrite", "trailing",
+                                                     "huge count", "type swap", "random"};
+
+static SysBool reference(const std::vector<char> &d, ngps_output &r)
+{
+    try {
+        size_t off = 0;
+        msgpack::object_handle oh = msgpack::unpack(d.data(), d.size(), off, NULL, NULL, ngpsUnpackLimit());
+        oh.get().convert(r);
+        return off == d.size() && !(r.pos_valid && r.edge_id == 0) ? TRUE : FALSE;
+    }
+    catch (...) {
+        return FALSE;
+    }
+}
+
+static void dump(const char *what, const std::vector<char> &d)
+{
+    fprintf(stderr, "%s:", what);
+    for (size_t i = 0; i < d.size(); ++i) {
+        fprintf(stderr, " %02x", (uint8_t)d[i]);
+    }
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long inputs = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    unsigned int seed = argc > 2 ? (unsigned int)strtoul(argv[2], NULL, 10) : 20001;
+
+    std::vector<ngps_output> trace = makeNgpsTrace(4096, seed);
+    std::vector<std::vector<char> > valid(trace.size());
+    for (size_t i = 0; i < trace.size(); ++i) {
+        NgpsPackBuffer buf;
+        msgpack::pack(buf, trace[i]);
+        valid[i].assign(buf.data(), buf.data() + buf.size());
+    }
+
+    NgpsValidator validator;
+    NgpsMutator mutator(seed);
+    unsigned long perMutation[MUTATIONS] = {};
+    unsigned long threw = 0;
+    unsigned long disagreements = 0;
+    unsigned long validRejected = 0;
+
+    for (size_t i = 0; i < valid.size(); ++i) {
+        ngps_output r;
+        if (validator.check(valid[i].data(), valid[i].size(), &r) != NGPS_ACCEPT || !(r == trace[i])) {
+            ++validRejected;
+        }
+    }
+
+    NgpsValidator wire32(NgpsLimits::wire32());
+    unsigned long wire32Wrong = 0;
+    for (size_t i = 0; i < valid.size(); ++i) {
+        SysBool fits = trace[i].offset <= MAX_UNSIGNED_LONG && trace[i].uncertainty <= MAX_UNSIGNED_LONG &&
+                       trace[i].speed <= MAX_UNSIGNED_LONG ? TRUE : FALSE;
+        if (wire32.check(valid[i].data(), valid[i].size()) != (fits ? NGPS_ACCEPT : NGPS_REJECT_LIMIT)) {
+            ++wire32Wrong;
+        }
+    }
+
+    for (unsigned long n = 0; n < inputs; ++n) {
+        NgpsMutation m;
+        std::vector<char> d = mutator.mutate(valid[n % valid.size()], &m);
+        ++perMutation[m];
+
+        ngps_output byValidator, byReference;
+        NgpsReject reason;
+        try {
+            reason = validator.check(d.data(), d.size(), &byValidator);
+        }
+        catch (...) {
+            ++threw;
+            dump("threw", d);
+            continue;
+        }
+        SysBool expected = reference(d, byReference);
+        if ((reason == NGPS_ACCEPT) != (expected == TRUE) || (expected && !(byValidator == byReference))) {
+            if (++disagreements <= 10) {
+                fprintf(stderr, "%s, validator %s, msgpack %s\n", mutationNames[m], ngpsRejectNames[reason],
+                        expected ? "accepted" : "rejected");
+                dump("  input", d);
+            }
+        }
+    }
+
+    printf("validator fuzz: %lu inputs, seed %u\n", inputs, seed);
+    for (int m = 0; m < MUTATIONS; ++m) {
+        printf("  %-12s %10lu inputs\n", mutationNames[m], perMutation[m]);
+    }
+    for (int r = 0; r < NGPS_REJECT_REASONS; ++r) {
+        printf("  %-12s %10lu\n", ngpsRejectNames[r], validator.count((NgpsReject)r));
+    }
+    printf("%lu disagreements with msgpack, %lu threw, %lu of %zu valid encodings rejected\n", disagreements, threw,
+           validRejected, valid.size());
+    printf("wire32 limits: %lu of %zu valid encodings rejected, %lu wrongly\n", wire32.rejected(), valid.size(),
+           wire32Wrong);
+    return disagreements == 0 && threw == 0 && validRejected == 0 && wire32Wrong == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
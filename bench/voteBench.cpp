@@ -0,0 +1,127 @@
+/*
+ * ReplicaVoter throughput and alignment latency. Each cycle every replica submits the same
+ * ngps_output (one replica corrupts a field in a small fraction of cycles); the last replica can
+ * lag a number of cycles behind the others or stall completely. Cycles are paced at periodUs
+ * (0 = as fast as possible) so lag is also lag in time.
+ *
+ * Latency is first record of a cycle to its VOTE_AGREED/DISAGREED/INCOMPLETE result: with 2oo3
+ * the two prompt replicas decide alone, with 2oo2 every cycle waits for the lagging replica and a
+ * stalled replica costs exactly voteTimeout.
+ *
+ * usage: voteBench [cycles] [lagCycles] [periodUs] [timeoutUs]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include "replicaVoter.h"
+#include "latencyHistogram.h"
+#include "ngpsTrace.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct Run
+{
+    unsigned int replicas;
+    int lag;                    /* cycles the last replica is behind; -1 = stalled */
+    unsigned int periodUs;
+};
+
+static void runVote(const Run &run, const std::vector<ngps_output> &trace, std::chrono::microseconds timeout)
+{
+    LatencyHistogram latency;
+    unsigned long decisions = 0;
+    ReplicaVoter voter(run.replicas, [&](const VoteResult &r) {
+        if (r.outcome != VOTE_DISSENT) {
+            latency.record((uint64_t)r.latency.count());
+            ++decisions;
+        }
+    }, timeout);
+
+    ReplicaId lagging = (ReplicaId)(REPLICA_1 + run.replicas - 1);
+    ReplicaId corrupting = (ReplicaId)(REPLICA_1 + 1);
+    std::deque<uint32_t> behind;
+    uint32_t cycles = (uint32_t)trace.size();
+
+    Clock::time_point start = Clock::now();
+    Clock::time_point due = start;
+    for (uint32_t cycle = 0; cycle < cycles; ++cycle) {
+        if (run.periodUs > 0) {
+            due += std::chrono::microseconds(run.periodUs);
+            while (Clock::now() < due) {
+                voter.expire(Clock::now());
+            }
+        }
+        Clock::time_point now = Clock::now();
+        for (unsigned int r = 0; r + 1 < run.replicas; ++r) {
+            ReplicaId replica = (ReplicaId)(REPLICA_1 + r);
+            if (replica == corrupting && cycle % 997 == 0) {
+                ngps_output bad = trace[cycle];
+                bad.offset += 1;
+                voter.submit(replica, cycle, bad, now);
+            }
+            else {
+                voter.submit(replica, cycle, trace[cycle], now);
+            }
+        }
+        if (run.lag >= 0) {
+            behind.push_back(cycle);
+            if (behind.size() > (size_t)run.lag) {
+                voter.submit(lagging, behind.front(), trace[behind.front()], now);
+                behind.pop_front();
+            }
+        }
+    }
+    for (; !behind.empty(); behind.pop_front()) {
+        voter.submit(lagging, behind.front(), trace[behind.front()], Clock::now());
+    }
+    while (decisions < cycles) {
+        voter.expire(Clock::now());
+    }
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+
+    char name[64];
+    if (run.lag < 0) {
+        snprintf(name, sizeof(name), "2oo%u stalled", run.replicas);
+    }
+    else {
+        snprintf(name, sizeof(name), "2oo%u lag %d", run.replicas, run.lag);
+    }
+    const VoteStats &s = voter.stats();
+    printf("%-16s %10.0f votes/s  agreed %lu disagreed %lu incomplete %lu dissents %lu late %lu\n",
+           name, cycles / elapsed.count(), s.agreed, s.disagreed, s.incomplete, s.dissents, s.late);
+    latency.print(name);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long cycles = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+    int lag = argc > 2 ? atoi(argv[2]) : 5;
+    unsigned int periodUs = argc > 3 ? (unsigned int)strtoul(argv[3], NULL, 10) : 20;
+    std::chrono::microseconds timeout(argc > 4 ? strtoul(argv[4], NULL, 10) : 2000);
+
+    std::vector<ngps_output> trace = makeNgpsTrace(cycles);
+    std::vector<ngps_output> paced(trace.begin(), trace.begin() + MIN(cycles, 20000UL));
+
+    printf("throughput (unpaced, %lu cycles)\n", cycles);
+    Run fast2 = {REDUNDANCY_LEVEL_2, 0, 0};
+    Run fast3 = {REDUNDANCY_LEVEL_3, 0, 0};
+    runVote(fast2, trace, timeout);
+    runVote(fast3, trace, timeout);
+
+    printf("alignment latency (%zu cycles every %uus, timeout %lldus)\n", paced.size(), periodUs,
+           (long long)timeout.count());
+    Run runs[] = {
+        {REDUNDANCY_LEVEL_2, 0, periodUs},
+        {REDUNDANCY_LEVEL_2, lag, periodUs},
+        {REDUNDANCY_LEVEL_2, -1, periodUs},
+        {REDUNDANCY_LEVEL_3, 0, periodUs},
+        {REDUNDANCY_LEVEL_3, lag, periodUs},
+        {REDUNDANCY_LEVEL_3, -1, periodUs},
+    };
+    for (size_t i = 0; i < LENGTHOF(runs); ++i) {
+        runVote(runs[i], paced, timeout);
+    }
+    return 0;
+}
@@ -0,0 +1,145 @@
+/*
+ * 32-bit wire profile (NgpsWire32Codec) against the variable-width NgpsCodec.
+ *
+ * Checks on the trace that every record whose ULong fields fit in 32 bits encodes to exactly
+ * NGPS_OUTPUT_WIRE32_SIZE bytes and reads back through NgpsWire32Codec, NgpsCodec and
+ * unpack + convert<ngps_output>; that every other record is refused by encode(); and that
+ * NgpsWire32Codec::decode refuses the uint64 encodings NgpsCodec produces for them. Then times
+ * encode and decode of both profiles and reports their message sizes.
+ *
+ * usage: wire32Bench [records] [rounds]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "ngpsOutput.h"
+#include "ngpsTrace.h"
+#include "allocCount.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static bool fits32(const ngps_output &r)
+{
+    return r.offset <= MAX_UNSIGNED_LONG && r.uncertainty <= MAX_UNSIGNED_LONG && r.speed <= MAX_UNSIGNED_LONG;
+}
+
+static unsigned long verify(const std::vector<ngps_output> &trace)
+{
+    unsigned long bad = 0;
+    for (size_t i = 0; i < trace.size(); ++i) {
+        char wire[NGPS_OUTPUT_WIRE32_SIZE];
+        size_t n = NgpsWire32Codec::encode(trace[i], wire, sizeof(wire));
+        if (!fits32(trace[i])) {
+            char compact[NGPS_OUTPUT_MAX_PACKED_SIZE];
+            size_t m = NgpsCodec::encode(trace[i], compact, sizeof(compact));
+            ngps_output r;
+            if (n != 0 || NgpsWire32Codec::decode(compact, m, r) != DIRECT_CODEC_OUT_OF_RANGE) {
+                fprintf(stderr, "out-of-range record %zu accepted\n", i);
+                ++bad;
+            }
+            continue;
+        }
+
+        ngps_output viaWire32, viaCodec;
+        msgpack::object_handle oh = msgpack::unpack(wire, n);
+        size_t used = 0;
+        if (n != NGPS_OUTPUT_WIRE32_SIZE ||
+            NgpsWire32Codec::decode(wire, n, viaWire32, &used) != DIRECT_CODEC_OK || used != n ||
+            NgpsCodec::decode(wire, n, viaCodec) != DIRECT_CODEC_OK ||
+            viaWire32 != trace[i] || viaCodec != trace[i] || oh.get().as<ngps_output>() != trace[i]) {
+            fprintf(stderr, "wire32 round trip failed at record %zu\n", i);
+            ++bad;
+        }
+    }
+    return bad;
+}
+
+template <typename Body>
+static double nsPerRecord(size_t records, unsigned int rounds, Body body)
+{
+    Clock::time_point start = Clock::now();
+    for (unsigned int r = 0; r < rounds; ++r) {
+        body();
+    }
+    std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+    return elapsed.count() / ((double)records * rounds);
+}
+
+int main(int argc, char **argv)
+{
+    size_t records = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+    unsigned int rounds = argc > 2 ? (unsigned int)strtoul(argv[2], NULL, 10) : 20;
+
+    std::vector<ngps_output> trace = makeNgpsTrace(records);
+    unsigned long bad = verify(trace);
+
+    // Time both profiles on the records the 32-bit profile can carry
+    std::vector<ngps_output> fitting;
+    for (size_t i = 0; i < trace.size(); ++i) {
+        if (fits32(trace[i])) {
+            fitting.push_back(trace[i]);
+        }
+    }
+    size_t n = fitting.size();
+    std::vector<char> compact(n * NGPS_OUTPUT_MAX_PACKED_SIZE);
+    std::vector<size_t> compactSize(n);
+    std::vector<char> wire32(n * NGPS_OUTPUT_WIRE32_SIZE);
+    size_t compactBytes = 0, compactMin = NGPS_OUTPUT_MAX_PACKED_SIZE, compactMax = 0;
+    for (size_t i = 0; i < n; ++i) {
+        compactSize[i] = NgpsCodec::encode(fitting[i], &compact[i * NGPS_OUTPUT_MAX_PACKED_SIZE],
+                                           NGPS_OUTPUT_MAX_PACKED_SIZE);
+        NgpsWire32Codec::encode(fitting[i], &wire32[i * NGPS_OUTPUT_WIRE32_SIZE], NGPS_OUTPUT_WIRE32_SIZE);
+        compactBytes += compactSize[i];
+        compactMin = MIN(compactMin, compactSize[i]);
+        compactMax = MAX(compactMax, compactSize[i]);
+    }
+    std::vector<ngps_output> out(n);
+    volatile size_t sink = 0;
+
+    double packNs = nsPerRecord(n, rounds, [&]() {
+        for (size_t i = 0; i < n; ++i) {
+            NgpsPackBuffer pbuf;
+            msgpack::pack(pbuf, fitting[i]);
+            escape(pbuf.data());
+            sink = sink + pbuf.size();
+        }
+    });
+    double compactEncodeNs = nsPerRecord(n, rounds, [&]() {
+        for (size_t i = 0; i < n; ++i) {
+            sink = sink + NgpsCodec::encode(fitting[i], &compact[i * NGPS_OUTPUT_MAX_PACKED_SIZE],
+                                            NGPS_OUTPUT_MAX_PACKED_SIZE);
+        }
+    });
+    double wire32EncodeNs = nsPerRecord(n, rounds, [&]() {
+        for (size_t i = 0; i < n; ++i) {
+            sink = sink + NgpsWire32Codec::encode(fitting[i], &wire32[i * NGPS_OUTPUT_WIRE32_SIZE],
+                                                  NGPS_OUTPUT_WIRE32_SIZE);
+        }
+    });
+    double compactDecodeNs = nsPerRecord(n, rounds, [&]() {
+        for (size_t i = 0; i < n; ++i) {
+            sink = sink + NgpsCodec::decode(&compact[i * NGPS_OUTPUT_MAX_PACKED_SIZE], compactSize[i], out[i]);
+        }
+    });
+    double wire32DecodeNs = nsPerRecord(n, rounds, [&]() {
+        for (size_t i = 0; i < n; ++i) {
+            sink = sink + NgpsWire32Codec::decode(&wire32[i * NGPS_OUTPUT_WIRE32_SIZE], NGPS_OUTPUT_WIRE32_SIZE,
+                                                  out[i]);
+        }
+    });
+
+    printf("records: %zu (%zu within 32 bits) x %u rounds, %lu check failures\n", records, n, rounds, bad);
+    printf("encode  pack<ngps_output>      %8.2f ns/record\n", packNs);
+    printf("encode  NgpsCodec              %8.2f ns/record\n", compactEncodeNs);
+    printf("encode  NgpsWire32Codec        %8.2f ns/record (x%.2f)\n", wire32EncodeNs,
+           compactEncodeNs / wire32EncodeNs);
+    printf("decode  NgpsCodec              %8.2f ns/record\n", compactDecodeNs);
+    printf("decode  NgpsWire32Codec        %8.2f ns/record (x%.2f)\n", wire32DecodeNs,
+           compactDecodeNs / wire32DecodeNs);
+    printf("size    NgpsCodec              %8.2f bytes/record (min %zu, max %zu)\n",
+           n > 0 ? (double)compactBytes / n : 0.0, compactMin, compactMax);
+    printf("size    NgpsWire32Codec        %8d bytes/record (constant)\n", NGPS_OUTPUT_WIRE32_SIZE);
+    return bad == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
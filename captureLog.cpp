@@ -0,0 +1,353 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include "captureLog.h"
+
+#define REPLAY_SPIN_NS  (50000)     /* final stretch before a due time is spun, not slept */
+
+static size_t alignUp(size_t n)
+{
+    return (n + CAPTURE_ALIGN - 1) & ~(size_t)(CAPTURE_ALIGN - 1);
+}
+
+static SysBool indexPath(const char *path, char *out, size_t size)
+{
+    int n = snprintf(out, size, "%s%s", path, CAPTURE_INDEX_SUFFIX);
+    return (n > 0 && (size_t)n < size) ? TRUE : FALSE;
+}
+
+int CaptureWriter::map(Mapping &m, const char *path)
+{
+    m.fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m.fd < 0) {
+        return RETURN_FAILURE;
+    }
+    if (ftruncate(m.fd, CAPTURE_INITIAL_SIZE) < 0) {
+        unmap(m);
+        return RETURN_FAILURE;
+    }
+    void *base = mmap(NULL, CAPTURE_INITIAL_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, m.fd, 0);
+    if (base == MAP_FAILED) {
+        unmap(m);
+        return RETURN_FAILURE;
+    }
+    m.base = (char *)base;
+    m.size = CAPTURE_INITIAL_SIZE;
+    m.used = 0;
+    return RETURN_SUCCESS;
+}
+
+int CaptureWriter::reserve(Mapping &m, size_t needed)
+{
+    if (m.used + needed <= m.size) {
+        return RETURN_SUCCESS;
+    }
+    size_t size = m.size;
+    while (m.used + needed > size) {
+        size *= 2;
+    }
+    if (ftruncate(m.fd, (off_t)size) < 0) {
+        return RETURN_FAILURE;
+    }
+    void *base = mremap(m.base, m.size, size, MREMAP_MAYMOVE);
+    if (base == MAP_FAILED) {
+        return RETURN_FAILURE;
+    }
+    m.base = (char *)base;
+    m.size = size;
+    return RETURN_SUCCESS;
+}
+
+int CaptureWriter::unmap(Mapping &m)
+{
+    int rc = RETURN_SUCCESS;
+    if (m.base != NULL) {
+        munmap(m.base, m.size);
+        m.base = NULL;
+    }
+    if (m.fd >= 0) {
+        if (ftruncate(m.fd, (off_t)m.used) < 0) {
+            rc = RETURN_FAILURE;
+        }
+        if (::close(m.fd) < 0) {
+            rc = RETURN_FAILURE;
+        }
+        m.fd = -1;
+    }
+    m.size = 0;
+    m.used = 0;
+    return rc;
+}
+
+int CaptureWriter::open(const char *path)
+{
+    char idx[PATH_MAX];
+    close();
+    if (!indexPath(path, idx, sizeof(idx)) || map(data, path) != RETURN_SUCCESS) {
+        return RETURN_FAILURE;
+    }
+    if (map(index, idx) != RETURN_SUCCESS) {
+        unmap(data);
+        return RETURN_FAILURE;
+    }
+
+    header = (CaptureFileHeader *)data.base;
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, CAPTURE_MAGIC, sizeof(header->magic));
+    header->version = CAPTURE_VERSION;
+    header->headerSize = sizeof(CaptureFileHeader);
+    header->dataEnd = sizeof(CaptureFileHeader);
+    data.used = sizeof(CaptureFileHeader);
+    return RETURN_SUCCESS;
+}
+
+int CaptureWriter::append(uint64_t timestampNs, const sockaddr_in &from, const char *bytes, size_t length)
+{
+    if (header == NULL || length > MAX_UNSIGNED_SHORT) {
+        return RETURN_FAILURE;
+    }
+    size_t recordSize = alignUp(sizeof(CaptureRecordHeader) + length);
+    if (reserve(data, recordSize) != RETURN_SUCCESS ||
+        reserve(index, sizeof(CaptureIndexEntry)) != RETURN_SUCCESS) {
+        return RETURN_FAILURE;
+    }
+    header = (CaptureFileHeader *)data.base;    /* the mapping may have moved */
+
+    CaptureRecordHeader *rh = (CaptureRecordHeader *)(data.base + data.used);
+    rh->timestampNs = timestampNs;
+    rh->srcAddr = from.sin_addr.s_addr;
+    rh->srcPort = from.sin_port;
+    rh->length = (uint16_t)length;
+    memcpy(rh + 1, bytes, length);
+
+    CaptureIndexEntry *entry = (CaptureIndexEntry *)(index.base + index.used);
+    entry->timestampNs = timestampNs;
+    entry->offset = data.used;
+
+    data.used += recordSize;
+    index.used += sizeof(CaptureIndexEntry);
+    header->dataEnd = data.used;
+    ++header->records;
+    return RETURN_SUCCESS;
+}
+
+int CaptureWriter::close()
+{
+    header = NULL;
+    int rc = unmap(index);
+    if (unmap(data) != RETURN_SUCCESS) {
+        rc = RETURN_FAILURE;
+    }
+    return rc;
+}
+
+static const char *mapReadOnly(const char *path, size_t &size)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    void *base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+    size = (size_t)st.st_size;
+    madvise(base, size, MADV_SEQUENTIAL);
+    return (const char *)base;
+}
+
+int CaptureReader::open(const char *path)
+{
+    char idx[PATH_MAX];
+    close();
+    if (!indexPath(path, idx, sizeof(idx))) {
+        return RETURN_FAILURE;
+    }
+    data = mapReadOnly(path, dataMapped);
+    if (data == NULL) {
+        return RETURN_FAILURE;
+    }
+    dataSize = dataMapped;
+
+    const CaptureFileHeader *header = (const CaptureFileHeader *)data;
+    if (dataSize < sizeof(CaptureFileHeader) || memcmp(header->magic, CAPTURE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != CAPTURE_VERSION) {
+        close();
+        return RETURN_FAILURE;
+    }
+    dataSize = (size_t)MIN((uint64_t)dataSize, header->dataEnd);
+    records = (unsigned long)header->records;
+
+    if (records > 0) {
+        index = (const CaptureIndexEntry *)mapReadOnly(idx, indexSize);
+        if (index == NULL) {
+            close();
+            return RETURN_FAILURE;
+        }
+        records = MIN(records, (unsigned long)(indexSize / sizeof(CaptureIndexEntry)));
+    }
+    return RETURN_SUCCESS;
+}
+
+void CaptureReader::close()
+{
+    if (data != NULL) {
+        munmap((void *)data, dataMapped);
+        data = NULL;
+    }
+    if (index != NULL) {
+        munmap((void *)index, indexSize);
+        index = NULL;
+    }
+    dataMapped = 0;
+    dataSize = 0;
+    indexSize = 0;
+    records = 0;
+}
+
+SysBool CaptureReader::record(unsigned long i, CaptureRecord &r) const
+{
+    if (i >= records) {
+        return FALSE;
+    }
+    uint64_t offset = index[i].offset;
+    if (offset < sizeof(CaptureFileHeader) || offset + sizeof(CaptureRecordHeader) > dataSize) {
+        return FALSE;
+    }
+    const CaptureRecordHeader *rh = (const CaptureRecordHeader *)(data + offset);
+    if (offset + sizeof(CaptureRecordHeader) + rh->length > dataSize) {
+        return FALSE;
+    }
+
+    r.timestampNs = rh->timestampNs;
+    memset(&r.from, 0, sizeof(r.from));
+    r.from.sin_family = AF_INET;
+    r.from.sin_addr.s_addr = rh->srcAddr;
+    r.from.sin_port = rh->srcPort;
+    r.data = (const char *)(rh + 1);
+    r.length = rh->length;
+    return TRUE;
+}
+
+static uint64_t monotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Sleep most of the way to due, then spin, since a timed sleep overshoots by tens of microseconds */
+static uint64_t waitUntil(uint64_t due)
+{
+    uint64_t now = monotonicNs();
+    if (now + REPLAY_SPIN_NS < due) {
+        uint64_t wake = due - REPLAY_SPIN_NS;
+        struct timespec ts;
+        ts.tv_sec = (time_t)(wake / 1000000000ULL);
+        ts.tv_nsec = (long)(wake % 1000000000ULL);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+        }
+        now = monotonicNs();
+    }
+    while (now < due) {
+        now = monotonicNs();
+    }
+    return now;
+}
+
+/* When a record captured at ts is due; a timestamp before the first record's (a stepped clock) is due at once */
+static uint64_t replayDue(uint64_t start, uint64_t ts, uint64_t firstTs, double speed)
+{
+    return ts > firstTs ? start + (uint64_t)((double)(ts - firstTs) / speed) : start;
+}
+
+int replayCapture(const CaptureReader &reader, int sockfd, const sockaddr_in &dest, const ReplayConfig &config,
+                  ReplayStats &stats)
+{
+    unsigned long end = reader.size();
+    if (config.count > 0 && config.first + config.count < end) {
+        end = config.first + config.count;
+    }
+    unsigned int batchSize = MAX(1u, MIN(config.batchSize, (unsigned int)REPLAY_MAX_BATCH));
+
+    struct mmsghdr headers[REPLAY_MAX_BATCH];
+    struct iovec iovecs[REPLAY_MAX_BATCH];
+    memset(headers, 0, sizeof(headers));
+    for (unsigned int k = 0; k < REPLAY_MAX_BATCH; ++k) {
+        headers[k].msg_hdr.msg_name = (void *)&dest;
+        headers[k].msg_hdr.msg_namelen = sizeof(dest);
+        headers[k].msg_hdr.msg_iov = &iovecs[k];
+        headers[k].msg_hdr.msg_iovlen = 1;
+    }
+
+    stats = ReplayStats();
+    uint64_t start = monotonicNs();
+    uint64_t firstTs = 0;
+    SysBool haveFirst = FALSE;
+    SysBool paced = config.speed > 0 ? TRUE : FALSE;
+    CaptureRecord r;
+
+    unsigned long i = config.first;
+    while (i < end) {
+        if (!reader.record(i, r)) {
+            ++stats.errors;
+            ++i;
+            continue;
+        }
+        if (!haveFirst) {
+            firstTs = r.timestampNs;
+            haveFirst = TRUE;
+        }
+
+        uint64_t now = 0;
+        if (paced) {
+            uint64_t due = replayDue(start, r.timestampNs, firstTs, config.speed);
+            now = waitUntil(due);
+            stats.maxLateNs = MAX(stats.maxLateNs, now - due);
+        }
+
+        // Batch this record with every following one that is already due
+        unsigned int n = 0;
+        for (;;) {
+            iovecs[n].iov_base = (void *)r.data;
+            iovecs[n].iov_len = r.length;
+            ++n;
+            ++i;
+            if (n == batchSize || i >= end || !reader.record(i, r)) {
+                break;
+            }
+            if (paced && replayDue(start, r.timestampNs, firstTs, config.speed) > now) {
+                break;
+            }
+        }
+
+        unsigned int sent = 0;
+        while (sent < n) {
+            int rc = sendmmsg(sockfd, &headers[sent], n - sent, 0);
+            if (rc < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                stats.errors += n - sent;
+                break;
+            }
+            sent += (unsigned int)rc;
+        }
+        stats.sent += sent;
+    }
+
+    stats.elapsedNs = monotonicNs() - start;
+    return stats.errors == 0 ? RETURN_SUCCESS : RETURN_FAILURE;
+}
@@ -0,0 +1,157 @@
+#ifndef CAPTURELOG_H
+#define CAPTURELOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+#include "udpMsgPackDefs.h"
+
+/**
+ * Append-only capture of raw datagrams, memory mapped for both writing and replay.
+ *
+ * <path>      CaptureFileHeader, then one record per datagram: CaptureRecordHeader followed by
+ *             the datagram bytes, padded to CAPTURE_ALIGN
+ * <path>.idx  one CaptureIndexEntry per record (timestamp and offset in <path>)
+ *
+ * Both files grow by doubling (ftruncate + mremap) and are trimmed to their used size on close.
+ * The header's record count and data end are updated only after a record and its index entry are
+ * complete, so a capture cut short by a crash still reads as a consistent prefix. Integers are in
+ * host byte order; source address and port are kept in network order as in sockaddr_in.
+ */
+
+#define CAPTURE_MAGIC           "NGPSCAP1"
+#define CAPTURE_VERSION         (1)
+#define CAPTURE_ALIGN           (8)
+#define CAPTURE_INITIAL_SIZE    (1 << 20)
+#define CAPTURE_INDEX_SUFFIX    ".idx"
+
+struct CaptureFileHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t records;           /* complete records */
+    uint64_t dataEnd;           /* offset just past the last complete record */
+    uint64_t reserved[4];
+};
+
+struct CaptureRecordHeader
+{
+    uint64_t timestampNs;       /* CLOCK_MONOTONIC when the datagram was received */
+    uint32_t srcAddr;
+    uint16_t srcPort;
+    uint16_t length;            /* datagram bytes following this header */
+};
+
+struct CaptureIndexEntry
+{
+    uint64_t timestampNs;
+    uint64_t offset;            /* of the CaptureRecordHeader in the data file */
+};
+
+static_assert(sizeof(CaptureFileHeader) == 64, "CaptureFileHeader layout");
+static_assert(sizeof(CaptureRecordHeader) == 16, "CaptureRecordHeader layout");
+static_assert(sizeof(CaptureIndexEntry) == 16, "CaptureIndexEntry layout");
+
+/* One captured datagram; data points into the reader's mapping */
+struct CaptureRecord
+{
+    uint64_t    timestampNs;
+    sockaddr_in from;
+    const char *data;
+    size_t      length;
+};
+
+class CaptureWriter
+{
+public:
+    CaptureWriter() {}
+    ~CaptureWriter() { close(); }
+
+    CaptureWriter(const CaptureWriter &) = delete;
+    CaptureWriter &operator=(const CaptureWriter &) = delete;
+
+    /* Create (or truncate) path and its index. Returns RETURN_SUCCESS or RETURN_FAILURE */
+    int open(const char *path);
+
+    /* Append one datagram. Returns RETURN_SUCCESS or RETURN_FAILURE (not open, too long, disk full) */
+    int append(uint64_t timestampNs, const sockaddr_in &from, const char *data, size_t length);
+
+    /* Trim both files to their used size and unmap them */
+    int close();
+
+    unsigned long records() const { return header != NULL ? (unsigned long)header->records : 0; }
+
+private:
+    struct Mapping
+    {
+        int fd = -1;
+        char *base = NULL;
+        size_t size = 0;
+        size_t used = 0;
+    };
+
+    static int map(Mapping &m, const char *path);
+    static int reserve(Mapping &m, size_t needed);
+    static int unmap(Mapping &m);
+
+    Mapping data;
+    Mapping index;
+    CaptureFileHeader *header = NULL;
+};
+
+class CaptureReader
+{
+public:
+    CaptureReader() {}
+    ~CaptureReader() { close(); }
+
+    CaptureReader(const CaptureReader &) = delete;
+    CaptureReader &operator=(const CaptureReader &) = delete;
+
+    /* Map path and its index read-only and validate the header. Returns RETURN_SUCCESS or RETURN_FAILURE */
+    int open(const char *path);
+    void close();
+
+    unsigned long size() const { return records; }
+
+    /* Record i, pointing into the mapping. FALSE if i is out of range or the entry is corrupt */
+    SysBool record(unsigned long i, CaptureRecord &r) const;
+
+private:
+    const char *data = NULL;
+    size_t dataMapped = 0;
+    size_t dataSize = 0;            /* up to the header's dataEnd */
+    const CaptureIndexEntry *index = NULL;
+    size_t indexSize = 0;
+    unsigned long records = 0;
+};
+
+/**
+ * Replay pacing. speed scales the captured inter-arrival times: 1.0 is real time, 10.0 is ten
+ * times faster, 0 sends back to back as fast as the socket takes them. Datagrams that are due
+ * together are sent with one sendmmsg() of up to batchSize (at most REPLAY_MAX_BATCH).
+ */
+#define REPLAY_MAX_BATCH    (64)
+
+struct ReplayConfig
+{
+    double speed = 1.0;
+    unsigned int batchSize = 32;
+    unsigned long first = 0;        /* first record to send */
+    unsigned long count = 0;        /* records to send, 0 = to the end */
+};
+
+struct ReplayStats
+{
+    unsigned long sent = 0;
+    unsigned long errors = 0;       /* datagrams sendmmsg did not accept */
+    uint64_t maxLateNs = 0;         /* worst send time behind schedule */
+    uint64_t elapsedNs = 0;
+};
+
+/* Send the records to dest over sockfd. No heap allocation. Returns RETURN_SUCCESS or RETURN_FAILURE */
+int replayCapture(const CaptureReader &reader, int sockfd, const sockaddr_in &dest, const ReplayConfig &config,
+                  ReplayStats &stats);
+
+#endif //CAPTURELOG_H
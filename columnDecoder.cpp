@@ -0,0 +1,242 @@
+#include "columnDecoder.h"
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
+#define NGPS_FIXARRAY_HEADER    (0x90 | NgpsOutputFields::count)
+#define NGPS_MIN_RECORD_SIZE    (1 + NgpsOutputFields::count)
+
+/* Byte positions (bit i = byte i of the record) of a record whose fields are all single bytes */
+#define COMPACT_UNSIGNED_BYTES  (BIT1 | BIT2 | BIT3 | BIT5 | BIT11)     /* edge_id offset uncertainty speed sensorCnt */
+#define COMPACT_BOOL_BYTES      (BIT4 | BIT6 | BIT7 | BIT8 | BIT9)      /* pos_valid speed_valid gd0 reversing stationary */
+#define COMPACT_SIGNED_BYTES    (BIT10)                                 /* accel */
+#define COMPACT_PROBE_INTERVAL  (8)     /**< Records decoded scalar after a failed compact test */
+#define COLUMN_CHUNK_ROWS       (4096)  /**< Rows added to the columns at a time */
+
+void NgpsColumns::reserve(size_t n)
+{
+    edgeId.reserve(n);
+    offset.reserve(n);
+    uncertainty.reserve(n);
+    posValid.reserve(n);
+    speed.reserve(n);
+    speedValid.reserve(n);
+    gd0.reserve(n);
+    reversing.reserve(n);
+    stationary.reserve(n);
+    accel.reserve(n);
+    sensorCnt.reserve(n);
+}
+
+void NgpsColumns::resize(size_t n)
+{
+    edgeId.resize(n);
+    offset.resize(n);
+    uncertainty.resize(n);
+    posValid.resize(n);
+    speed.resize(n);
+    speedValid.resize(n);
+    gd0.resize(n);
+    reversing.resize(n);
+    stationary.resize(n);
+    accel.resize(n);
+    sensorCnt.resize(n);
+}
+
+ngps_output NgpsColumns::row(size_t i) const
+{
+    return ngps_output(edgeId[i], offset[i], uncertainty[i], posValid[i] ? TRUE : FALSE, speed[i],
+                       speedValid[i] ? TRUE : FALSE, gd0[i] ? TRUE : FALSE, reversing[i] ? TRUE : FALSE,
+                       stationary[i] ? TRUE : FALSE, accel[i], sensorCnt[i]);
+}
+
+namespace {
+
+/* Raw column pointers, so the hot loop does not go through eleven vector bounds */
+struct ColumnPtrs
+{
+    UShort *edgeId;
+    ULong  *offset;
+    ULong  *uncertainty;
+    UTiny  *posValid;
+    ULong  *speed;
+    UTiny  *speedValid;
+    UTiny  *gd0;
+    UTiny  *reversing;
+    UTiny  *stationary;
+    SShort *accel;
+    UShort *sensorCnt;
+
+    ColumnPtrs(NgpsColumns &c, size_t base) :
+            edgeId(c.edgeId.data() + base),
+            offset(c.offset.data() + base),
+            uncertainty(c.uncertainty.data() + base),
+            posValid(c.posValid.data() + base),
+            speed(c.speed.data() + base),
+            speedValid(c.speedValid.data() + base),
+            gd0(c.gd0.data() + base),
+            reversing(c.reversing.data() + base),
+            stationary(c.stationary.data() + base),
+            accel(c.accel.data() + base),
+            sensorCnt(c.sensorCnt.data() + base)
+    {
+    }
+
+    void store(size_t i, const ngps_output &r) const
+    {
+        edgeId[i] = r.edge_id;
+        offset[i] = r.offset;
+        uncertainty[i] = r.uncertainty;
+        posValid[i] = r.pos_valid ? 1 : 0;
+        speed[i] = r.speed;
+        speedValid[i] = r.speed_valid ? 1 : 0;
+        gd0[i] = r.gd0 ? 1 : 0;
+        reversing[i] = r.reversing ? 1 : 0;
+        stationary[i] = r.stationary ? 1 : 0;
+        accel[i] = r.accel;
+        sensorCnt[i] = r.sensorCnt;
+    }
+};
+
+#if defined(__SSE2__)
+/*
+ * TRUE when the 16 bytes at p start a record whose eleven fields are all single bytes of the right
+ * kind: positive fixints for the unsigned fields, true/false for the SysBools, any fixint for accel
+ */
+inline SysBool isCompact(const char *p)
+{
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    unsigned int positive = (unsigned int)_mm_movemask_epi8(_mm_cmpgt_epi8(v, _mm_set1_epi8(-1)));
+    unsigned int fixint = (unsigned int)_mm_movemask_epi8(_mm_cmpgt_epi8(v, _mm_set1_epi8(-33)));
+    unsigned int boolean = (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8((char)0xc2)),
+                                                                        _mm_cmpeq_epi8(v, _mm_set1_epi8((char)0xc3))));
+    return ((uint8_t)p[0] == NGPS_FIXARRAY_HEADER &&
+            (positive & COMPACT_UNSIGNED_BYTES) == COMPACT_UNSIGNED_BYTES &&
+            (boolean & COMPACT_BOOL_BYTES) == COMPACT_BOOL_BYTES &&
+            (fixint & COMPACT_SIGNED_BYTES) == COMPACT_SIGNED_BYTES) ? TRUE : FALSE;
+}
+#endif
+
+inline DirectCodecStatus readBool(const char *&q, const char *end, UTiny &v)
+{
+    SysBool b = FALSE;
+    DirectCodecStatus status = direct_codec::WireTraits<SysBool>::decode(q, end, b);
+    v = b ? 1 : 0;
+    return status;
+}
+
+template <typename T>
+inline DirectCodecStatus readInteger(const char *&q, const char *end, T &v)
+{
+    return direct_codec::WireTraits<T>::decode(q, end, v);
+}
+
+#define READ_FIELD(call) do { DirectCodecStatus s_ = (call); if (s_ != DIRECT_CODEC_OK) return s_; } while (0)
+
+/* Decode the record at p into row i and advance p past it */
+DirectCodecStatus decodeRecord(const char *&p, const char *end, const ColumnPtrs &col, size_t i)
+{
+    if ((uint8_t)*p != NGPS_FIXARRAY_HEADER) {
+        ngps_output r;
+        size_t used = 0;
+        DirectCodecStatus status = NgpsCodec::decode(p, (size_t)(end - p), r, &used);
+        if (status == DIRECT_CODEC_OK) {
+            col.store(i, r);
+            p += used;
+        }
+        return status;
+    }
+
+    const char *q = p + 1;
+    READ_FIELD(readInteger(q, end, col.edgeId[i]));
+    READ_FIELD(readInteger(q, end, col.offset[i]));
+    READ_FIELD(readInteger(q, end, col.uncertainty[i]));
+    READ_FIELD(readBool(q, end, col.posValid[i]));
+    READ_FIELD(readInteger(q, end, col.speed[i]));
+    READ_FIELD(readBool(q, end, col.speedValid[i]));
+    READ_FIELD(readBool(q, end, col.gd0[i]));
+    READ_FIELD(readBool(q, end, col.reversing[i]));
+    READ_FIELD(readBool(q, end, col.stationary[i]));
+    READ_FIELD(readInteger(q, end, col.accel[i]));
+    READ_FIELD(readInteger(q, end, col.sensorCnt[i]));
+    p = q;
+    return DIRECT_CODEC_OK;
+}
+
+#undef READ_FIELD
+
+} // namespace
+
+SysBool columnDecodeSimd()
+{
+#if defined(__SSE2__)
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+DirectCodecStatus decodeNgpsColumns(const char *data, size_t size, NgpsColumns &out, size_t *consumed,
+                                    ColumnDecodeMode mode)
+{
+    // Rows are added a chunk at a time: sizing for the worst case (every record NGPS_MIN_RECORD_SIZE
+    // bytes) would zero-fill almost twice the rows typical traffic needs
+    size_t base = out.size();
+    size_t rows = MIN(size / NGPS_MIN_RECORD_SIZE + 1, (size_t)COLUMN_CHUNK_ROWS);
+    out.resize(base + rows);
+    ColumnPtrs col(out, base);
+
+    const char *p = data;
+    const char *end = data + size;
+    size_t n = 0;
+    DirectCodecStatus status = DIRECT_CODEC_OK;
+    SysBool simd = (mode == COLUMN_DECODE_AUTO) ? columnDecodeSimd() : FALSE;
+    unsigned int probeIn = 0;       /* records until the compact test is tried again */
+    UNUSED_VAR(simd);
+    UNUSED_VAR(probeIn);
+
+    while (p < end) {
+        if (n == rows) {
+            rows += MIN((size_t)(end - p) / NGPS_MIN_RECORD_SIZE + 1, (size_t)COLUMN_CHUNK_ROWS);
+            out.resize(base + rows);
+            col = ColumnPtrs(out, base);
+        }
+#if defined(__SSE2__)
+        if (simd && probeIn == 0 && end - p >= 16) {
+            if (isCompact(p)) {
+                const uint8_t *b = (const uint8_t *)p;
+                col.edgeId[n] = b[1];
+                col.offset[n] = b[2];
+                col.uncertainty[n] = b[3];
+                col.posValid[n] = b[4] & 1;
+                col.speed[n] = b[5];
+                col.speedValid[n] = b[6] & 1;
+                col.gd0[n] = b[7] & 1;
+                col.reversing[n] = b[8] & 1;
+                col.stationary[n] = b[9] & 1;
+                col.accel[n] = (int8_t)b[10];
+                col.sensorCnt[n] = b[11];
+                ++n;
+                p += NGPS_MIN_RECORD_SIZE;
+                continue;
+            }
+            // Streams are usually uniformly compact or not; do not pay for the test on every record
+            probeIn = COMPACT_PROBE_INTERVAL;
+        }
+        if (probeIn > 0) {
+            --probeIn;
+        }
+#endif
+        status = decodeRecord(p, end, col, n);
+        if (status != DIRECT_CODEC_OK) {
+            break;
+        }
+        ++n;
+    }
+
+    out.resize(base + n);
+    if (consumed != NULL) {
+        *consumed = (size_t)(p - data);
+    }
+    return status;
+}
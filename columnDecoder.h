@@ -0,0 +1,68 @@
+#ifndef COLUMNDECODER_H
+#define COLUMNDECODER_H
+
+#include <stddef.h>
+#include <vector>
+#include "ngpsOutput.h"
+
+/**
+ * Bulk decoder from a buffer of back-to-back pack<ngps_output> records (a capture, a replay, or
+ * the payload of a coalesced datagram) into structure-of-arrays columns.
+ *
+ * On x86 with SSE2 the first 16 bytes of a record are classified at once (positive fixint, any
+ * fixint, true/false). A record whose eleven fields are all single bytes is validated by three
+ * mask compares and extracted straight from those bytes. Any other record takes the scalar
+ * direct_codec field readers, and after a failed test the next few records skip the SIMD test, so
+ * wide-integer traffic does not pay for it. Records with an array16/array32 header go through
+ * NgpsCodec. Both paths accept and reject exactly the same input as NgpsCodec::decode.
+ *
+ * Only compact records gain from SIMD. Real position reports carry offsets in mm and speeds in
+ * mm/s, which are multi-byte integers, so they decode scalar, a little slower than NgpsCodec into
+ * an array of structs because of the eleven column stores: what this decoder gives them is the
+ * columnar layout, not decode speed. Vectorizing multi-byte records (per-byte width
+ * classification, or cached record layouts matched by masked compares) was measured slower than
+ * the branch-predicted scalar readers, whose element positions are known speculatively.
+ */
+
+typedef enum ColumnDecodeMode
+{
+    COLUMN_DECODE_AUTO = 0,     /**< SIMD for compact records when the build target has it */
+    COLUMN_DECODE_SCALAR        /**< Scalar path only (reference and benchmark baseline) */
+} ColumnDecodeMode;
+
+struct NgpsColumns
+{
+    std::vector<UShort> edgeId;
+    std::vector<ULong>  offset;
+    std::vector<ULong>  uncertainty;
+    std::vector<UTiny>  posValid;
+    std::vector<ULong>  speed;
+    std::vector<UTiny>  speedValid;
+    std::vector<UTiny>  gd0;
+    std::vector<UTiny>  reversing;
+    std::vector<UTiny>  stationary;
+    std::vector<SShort> accel;
+    std::vector<UShort> sensorCnt;
+
+    size_t size() const { return edgeId.size(); }
+    void clear() { resize(0); }
+    void reserve(size_t n);
+    void resize(size_t n);
+
+    /* Record i reassembled as a struct */
+    ngps_output row(size_t i) const;
+};
+
+/**
+ * Append every record in [data, data + size) to out.
+ * Returns DIRECT_CODEC_OK when the whole buffer was decoded, DIRECT_CODEC_TRUNCATED when it ends
+ * inside a record, or the status of the first record that failed. Records before the failing one
+ * are kept in out; *consumed (if not NULL) is the number of bytes they occupied.
+ */
+DirectCodecStatus decodeNgpsColumns(const char *data, size_t size, NgpsColumns &out, size_t *consumed = NULL,
+                                    ColumnDecodeMode mode = COLUMN_DECODE_AUTO);
+
+/* TRUE when COLUMN_DECODE_AUTO uses SIMD in this build */
+SysBool columnDecodeSimd();
+
+#endif //COLUMNDECODER_H
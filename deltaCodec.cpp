@@ -0,0 +1,137 @@
+#include "deltaCodec.h"
+
+using direct_codec::WireTraits;
+
+UTiny packDeltaFlags(const ngps_output &r)
+{
+    UTiny flags = 0;
+    if (r.pos_valid) flags |= DELTA_FLAG_POS_VALID;
+    if (r.speed_valid) flags |= DELTA_FLAG_SPEED_VALID;
+    if (r.gd0) flags |= DELTA_FLAG_GD0;
+    if (r.reversing) flags |= DELTA_FLAG_REVERSING;
+    if (r.stationary) flags |= DELTA_FLAG_STATIONARY;
+    return flags;
+}
+
+void unpackDeltaFlags(UTiny flags, ngps_output &r)
+{
+    r.pos_valid = (flags & DELTA_FLAG_POS_VALID) ? TRUE : FALSE;
+    r.speed_valid = (flags & DELTA_FLAG_SPEED_VALID) ? TRUE : FALSE;
+    r.gd0 = (flags & DELTA_FLAG_GD0) ? TRUE : FALSE;
+    r.reversing = (flags & DELTA_FLAG_REVERSING) ? TRUE : FALSE;
+    r.stationary = (flags & DELTA_FLAG_STATIONARY) ? TRUE : FALSE;
+}
+
+DeltaEncoder::DeltaEncoder(unsigned int keyframeInterval) :
+        keyframeInterval(keyframeInterval > 0 ? keyframeInterval : 1),
+        sinceKeyframe(this->keyframeInterval)
+{
+}
+
+size_t DeltaEncoder::encode(const ngps_output &r, char *out, size_t capacity)
+{
+    if (capacity < DELTA_MAX_FRAME_SIZE) {
+        return 0;
+    }
+
+    UTiny flags = packDeltaFlags(r);
+    unsigned int mask;
+    if (sinceKeyframe >= keyframeInterval) {
+        mask = DELTA_KEYFRAME | DELTA_ALL_FIELDS;
+        sinceKeyframe = 0;
+    }
+    else {
+        mask = 0;
+        if (r.edge_id != previous.edge_id) mask |= 1 << DELTA_EDGE_ID;
+        if (r.offset != previous.offset) mask |= 1 << DELTA_OFFSET;
+        if (r.uncertainty != previous.uncertainty) mask |= 1 << DELTA_UNCERTAINTY;
+        if (r.speed != previous.speed) mask |= 1 << DELTA_SPEED;
+        if (r.accel != previous.accel) mask |= 1 << DELTA_ACCEL;
+        if (r.sensorCnt != previous.sensorCnt) mask |= 1 << DELTA_SENSOR_CNT;
+        if (flags != packDeltaFlags(previous)) mask |= 1 << DELTA_FLAGS;
+    }
+    ++sinceKeyframe;
+
+    unsigned int present = 0;
+    for (unsigned int bits = mask & DELTA_ALL_FIELDS; bits != 0; bits &= bits - 1) {
+        ++present;
+    }
+
+    char *p = out;
+    *p++ = (char)(0x90 | (2 + present));
+    p += WireTraits<UTiny>::encode(p, (UTiny)mask);
+    p += WireTraits<UTiny>::encode(p, seq++);
+    if (mask & (1 << DELTA_EDGE_ID)) p += WireTraits<UShort>::encode(p, r.edge_id);
+    if (mask & (1 << DELTA_OFFSET)) p += WireTraits<ULong>::encode(p, r.offset);
+    if (mask & (1 << DELTA_UNCERTAINTY)) p += WireTraits<ULong>::encode(p, r.uncertainty);
+    if (mask & (1 << DELTA_SPEED)) p += WireTraits<ULong>::encode(p, r.speed);
+    if (mask & (1 << DELTA_ACCEL)) p += WireTraits<SShort>::encode(p, r.accel);
+    if (mask & (1 << DELTA_SENSOR_CNT)) p += WireTraits<UShort>::encode(p, r.sensorCnt);
+    if (mask & (1 << DELTA_FLAGS)) p += WireTraits<UTiny>::encode(p, flags);
+
+    previous = r;
+    return (size_t)(p - out);
+}
+
+DeltaStatus DeltaDecoder::decode(const char *data, size_t len, ngps_output &out)
+{
+    if (len == 0 || ((UTiny)data[0] & 0xf0) != 0x90) {
+        return DELTA_MALFORMED;
+    }
+    unsigned int elements = (UTiny)data[0] & 0x0f;
+    const char *p = data + 1;
+    const char *end = data + len;
+
+    UTiny mask;
+    UTiny seq;
+    if (elements < 2 ||
+        WireTraits<UTiny>::decode(p, end, mask) != DIRECT_CODEC_OK ||
+        WireTraits<UTiny>::decode(p, end, seq) != DIRECT_CODEC_OK) {
+        return DELTA_MALFORMED;
+    }
+
+    unsigned int present = 0;
+    for (unsigned int bits = mask & DELTA_ALL_FIELDS; bits != 0; bits &= bits - 1) {
+        ++present;
+    }
+    if (elements != 2 + present) {
+        return DELTA_MALFORMED;
+    }
+
+    SysBool keyframe = (mask & DELTA_KEYFRAME) ? TRUE : FALSE;
+    if (keyframe && (mask & DELTA_ALL_FIELDS) != DELTA_ALL_FIELDS) {
+        return DELTA_MALFORMED;
+    }
+    if (synced && seq != expectedSeq) {
+        lostFrames += (UTiny)(seq - expectedSeq);
+        synced = FALSE;
+    }
+    expectedSeq = (UTiny)(seq + 1);
+    if (!synced && !keyframe) {
+        return DELTA_NEED_KEYFRAME;
+    }
+
+    // Decode into a copy so a malformed frame leaves the current record untouched
+    ngps_output next = current;
+    UTiny flags = 0;
+    DirectCodecStatus status = DIRECT_CODEC_OK;
+    if ((mask & (1 << DELTA_EDGE_ID)) && status == DIRECT_CODEC_OK) status = WireTraits<UShort>::decode(p, end, next.edge_id);
+    if ((mask & (1 << DELTA_OFFSET)) && status == DIRECT_CODEC_OK) status = WireTraits<ULong>::decode(p, end, next.offset);
+    if ((mask & (1 << DELTA_UNCERTAINTY)) && status == DIRECT_CODEC_OK) status = WireTraits<ULong>::decode(p, end, next.uncertainty);
+    if ((mask & (1 << DELTA_SPEED)) && status == DIRECT_CODEC_OK) status = WireTraits<ULong>::decode(p, end, next.speed);
+    if ((mask & (1 << DELTA_ACCEL)) && status == DIRECT_CODEC_OK) status = WireTraits<SShort>::decode(p, end, next.accel);
+    if ((mask & (1 << DELTA_SENSOR_CNT)) && status == DIRECT_CODEC_OK) status = WireTraits<UShort>::decode(p, end, next.sensorCnt);
+    if ((mask & (1 << DELTA_FLAGS)) && status == DIRECT_CODEC_OK) {
+        status = WireTraits<UTiny>::decode(p, end, flags);
+        unpackDeltaFlags(flags, next);
+    }
+    if (status != DIRECT_CODEC_OK) {
+        synced = FALSE;
+        return DELTA_MALFORMED;
+    }
+
+    current = next;
+    synced = TRUE;
+    out = current;
+    return DELTA_OK;
+}
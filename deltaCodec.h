@@ -0,0 +1,93 @@
+#ifndef DELTACODEC_H
+#define DELTACODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ngpsOutput.h"
+
+/**
+ * Delta-encoded ngps_output stream (optional alternative to pack<ngps_output>).
+ *
+ * Each frame is a msgpack array:
+ *   [ mask, seq, values... ]
+ * mask  - bit i set when field i of DeltaField is present; DELTA_KEYFRAME marks a full frame
+ * seq   - frame counter modulo 256, lets the decoder notice a lost frame
+ * values - the present fields in DeltaField order. The five SysBool members travel as one
+ *          bitfield byte (DELTA_FLAG_*) instead of five msgpack bools.
+ *
+ * The encoder sends a keyframe every keyframeInterval frames and after reset(). The decoder
+ * rejects deltas until it has a keyframe, and again after a seq gap, so a lost frame can never
+ * leave the receiver with a silently wrong record.
+ */
+
+typedef enum DeltaField
+{
+    DELTA_EDGE_ID = 0,
+    DELTA_OFFSET,
+    DELTA_UNCERTAINTY,
+    DELTA_SPEED,
+    DELTA_ACCEL,
+    DELTA_SENSOR_CNT,
+    DELTA_FLAGS,
+    DELTA_FIELD_COUNT
+} DeltaField;
+
+#define DELTA_KEYFRAME          (BIT7)
+#define DELTA_ALL_FIELDS        ((1 << DELTA_FIELD_COUNT) - 1)
+
+#define DELTA_FLAG_POS_VALID    (BIT0)
+#define DELTA_FLAG_SPEED_VALID  (BIT1)
+#define DELTA_FLAG_GD0          (BIT2)
+#define DELTA_FLAG_REVERSING    (BIT3)
+#define DELTA_FLAG_STATIONARY   (BIT4)
+
+/* Worst case is a keyframe: array header, mask (uint8), seq (uint8), every field at full width */
+#define DELTA_MAX_FRAME_SIZE    (1 + 2 + 2 + 3 + 9 + 9 + 9 + 3 + 3 + 1)
+
+typedef enum DeltaStatus
+{
+    DELTA_OK = 0,               /**< Frame applied, output holds the full record */
+    DELTA_NEED_KEYFRAME,        /**< Delta dropped: no keyframe yet, or frames were lost since */
+    DELTA_MALFORMED             /**< Not a delta frame */
+} DeltaStatus;
+
+UTiny packDeltaFlags(const ngps_output &r);
+void unpackDeltaFlags(UTiny flags, ngps_output &r);
+
+class DeltaEncoder
+{
+public:
+    explicit DeltaEncoder(unsigned int keyframeInterval = 50);
+
+    /**
+     * Encode r relative to the previously encoded record. Returns bytes written, or 0 if
+     * capacity is below DELTA_MAX_FRAME_SIZE.
+     */
+    size_t encode(const ngps_output &r, char *out, size_t capacity);
+
+    /* Force the next frame to be a keyframe (e.g. after the receiver restarted) */
+    void reset() { sinceKeyframe = keyframeInterval; }
+
+private:
+    ngps_output previous;
+    unsigned int keyframeInterval;
+    unsigned int sinceKeyframe;
+    UTiny seq = 0;
+};
+
+class DeltaDecoder
+{
+public:
+    /* Apply one frame. On DELTA_OK out holds the rebuilt record */
+    DeltaStatus decode(const char *data, size_t len, ngps_output &out);
+
+    unsigned long gaps() const { return lostFrames; }
+
+private:
+    ngps_output current;
+    SysBool synced = FALSE;
+    UTiny expectedSeq = 0;
+    unsigned long lostFrames = 0;
+};
+
+#endif //DELTACODEC_H
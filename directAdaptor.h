@@ -0,0 +1,100 @@
+#ifndef DIRECTADAPTOR_H
+#define DIRECTADAPTOR_H
+
+#include <msgpack.hpp>
+#include "directCodec.h"
+
+/**
+ * msgpack-c adaptors generated from a DirectFieldList, in place of hand-written convert<>/pack<>
+ * specializations. At global scope:
+ *
+ *     typedef DIRECT_FIELDS(my_msg, id, value, valid) MyMsgFields;
+ *     DIRECT_MSGPACK_ADAPTOR(my_msg, MyMsgFields)
+ *
+ * pack<Struct> encodes with DirectCodec<Struct, Fields> into a stack buffer and appends it to the
+ * stream in one write; the bytes are the same as packing the fields one by one. convert<Struct>
+ * checks the array and its element count and converts each element as object::as<T>() does
+ * (SysBool through bool), throwing msgpack::type_error; the target is only assigned once every
+ * element has converted.
+ */
+
+namespace direct_codec {
+
+template <typename T>
+struct ObjectTraits
+{
+    static T as(const msgpack::object &o) { return o.as<T>(); }
+};
+
+template <>
+struct ObjectTraits<SysBool>
+{
+    static SysBool as(const msgpack::object &o) { return o.as<bool>() ? TRUE : FALSE; }
+};
+
+template <typename Fields>
+struct ObjectReader;
+
+template <>
+struct ObjectReader<DirectFieldList<> >
+{
+    template <typename Struct>
+    static void read(const msgpack::object *, Struct &) {}
+};
+
+template <typename Head, typename... Tail>
+struct ObjectReader<DirectFieldList<Head, Tail...> >
+{
+    template <typename Struct>
+    static void read(const msgpack::object *p, Struct &s)
+    {
+        Head::get(s) = ObjectTraits<typename Head::member_type>::as(*p);
+        ObjectReader<DirectFieldList<Tail...> >::read(p + 1, s);
+    }
+};
+
+template <typename Struct, typename Fields>
+inline const msgpack::object &convertObject(const msgpack::object &o, Struct &v)
+{
+    if (o.type != msgpack::type::ARRAY) throw msgpack::type_error();
+    if (o.via.array.size != (uint32_t)Fields::count) throw msgpack::type_error();
+    Struct converted;
+    ObjectReader<Fields>::read(o.via.array.ptr, converted);
+    v = converted;
+    return o;
+}
+
+template <typename Struct, typename Fields, typename Stream>
+inline msgpack::packer<Stream> &packObject(msgpack::packer<Stream> &o, const Struct &v)
+{
+    typedef DirectCodec<Struct, Fields> Codec;
+    char buf[Codec::maxSize];
+    size_t n = Codec::encode(v, buf, sizeof(buf));
+    o.pack_bin_body(buf, (uint32_t)n);      /* raw append of the already-encoded array */
+    return o;
+}
+
+} // namespace direct_codec
+
+#define DIRECT_MSGPACK_ADAPTOR(Struct, Fields) \
+namespace msgpack { \
+    MSGPACK_API_VERSION_NAMESPACE(MSGPACK_DEFAULT_API_NS) { \
+        namespace adaptor { \
+            template <> \
+            struct convert<Struct> { \
+                msgpack::object const& operator()(msgpack::object const& o, Struct& v) const { \
+                    return direct_codec::convertObject<Struct, Fields>(o, v); \
+                } \
+            }; \
+            template <> \
+            struct pack<Struct> { \
+                template <typename Stream> \
+                packer<Stream>& operator()(msgpack::packer<Stream>& o, Struct const& v) const { \
+                    return direct_codec::packObject<Struct, Fields>(o, v); \
+                } \
+            }; \
+        } \
+    } \
+}
+
+#endif //DIRECTADAPTOR_H
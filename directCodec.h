@@ -0,0 +1,555 @@
+#ifndef DIRECTCODEC_H
+#define DIRECTCODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <endian.h>
+#include <limits>
+#include <type_traits>
+#include "udpMsgPackDefs.h"
+
+/**
+ * Direct msgpack codec for fixed-layout structs.
+ *
+ * A struct is described at compile time by a DirectFieldList of member pointers (DIRECT_FIELDS).
+ * DirectCodec then encodes it as a msgpack array with one element per field, producing the same
+ * bytes as the msgpack-c packer (smallest-fit integers, true/false for SysBool) or, with
+ * DirectFixedEncoding / DirectWire32Encoding, full-width integers at constant offsets, and
+ * decodes the wire bytes straight into the struct without building a msgpack::object tree.
+ * Decoding accepts the same encodings that msgpack::object::as<T>() accepts. Errors are reported
+ * as DirectCodecStatus codes; nothing here throws or allocates.
+ */
+
+typedef enum DirectCodecStatus
+{
+    DIRECT_CODEC_OK = 0,            /**< Record decoded */
+    DIRECT_CODEC_TRUNCATED,         /**< Input ended before the record was complete */
+    DIRECT_CODEC_BAD_ARRAY,         /**< Not an array, or the element count does not match the field list */
+    DIRECT_CODEC_BAD_TYPE,          /**< Element has a msgpack type the field cannot hold */
+    DIRECT_CODEC_OUT_OF_RANGE       /**< Integer element does not fit in the field type */
+} DirectCodecStatus;
+
+namespace direct_codec {
+
+inline void put16(char *p, uint16_t v) { v = htobe16(v); memcpy(p, &v, 2); }
+inline void put32(char *p, uint32_t v) { v = htobe32(v); memcpy(p, &v, 4); }
+inline void put64(char *p, uint64_t v) { v = htobe64(v); memcpy(p, &v, 8); }
+inline uint16_t get16(const char *p) { uint16_t v; memcpy(&v, p, 2); return be16toh(v); }
+inline uint32_t get32(const char *p) { uint32_t v; memcpy(&v, p, 4); return be32toh(v); }
+inline uint64_t get64(const char *p) { uint64_t v; memcpy(&v, p, 8); return be64toh(v); }
+
+/* Smallest-fit unsigned encoding, identical to msgpack-c pack_imp_uint* */
+inline size_t encodeUnsigned(char *p, uint64_t v)
+{
+    if (v < 0x80) {
+        p[0] = (char)v;
+        return 1;
+    }
+    if (v < 0x100) {
+        p[0] = (char)0xcc;
+        p[1] = (char)v;
+        return 2;
+    }
+    if (v < 0x10000) {
+        p[0] = (char)0xcd;
+        put16(p + 1, (uint16_t)v);
+        return 3;
+    }
+    if (v < 0x100000000ULL) {
+        p[0] = (char)0xce;
+        put32(p + 1, (uint32_t)v);
+        return 5;
+    }
+    p[0] = (char)0xcf;
+    put64(p + 1, v);
+    return 9;
+}
+
+/* Smallest-fit signed encoding, identical to msgpack-c pack_imp_int* */
+inline size_t encodeSigned(char *p, int64_t v)
+{
+    if (v >= 0) {
+        return encodeUnsigned(p, (uint64_t)v);   /* positive values use the unsigned formats */
+    }
+    if (v >= -32) {
+        p[0] = (char)v;
+        return 1;
+    }
+    if (v >= -128) {
+        p[0] = (char)0xd0;
+        p[1] = (char)v;
+        return 2;
+    }
+    if (v >= -32768) {
+        p[0] = (char)0xd1;
+        put16(p + 1, (uint16_t)v);
+        return 3;
+    }
+    if (v >= -2147483648LL) {
+        p[0] = (char)0xd2;
+        put32(p + 1, (uint32_t)v);
+        return 5;
+    }
+    p[0] = (char)0xd3;
+    put64(p + 1, (uint64_t)v);
+    return 9;
+}
+
+/**
+ * Decode any msgpack integer. On success *negative tells which of u/s holds the value, mirroring
+ * msgpack::type::POSITIVE_INTEGER / NEGATIVE_INTEGER.
+ */
+inline DirectCodecStatus decodeInteger(const char *&p, const char *end, bool *negative, uint64_t *u, int64_t *s)
+{
+    if (p >= end) {
+        return DIRECT_CODEC_TRUNCATED;
+    }
+    uint8_t b = (uint8_t)*p;
+    if (b < 0x80) {
+        *negative = false;
+        *u = b;
+        p += 1;
+        return DIRECT_CODEC_OK;
+    }
+    if (b >= 0xe0) {
+        *negative = true;
+        *s = (int8_t)b;
+        p += 1;
+        return DIRECT_CODEC_OK;
+    }
+
+    size_t width;
+    switch (b) {
+        case 0xcc: case 0xd0: width = 1; break;
+        case 0xcd: case 0xd1: width = 2; break;
+        case 0xce: case 0xd2: width = 4; break;
+        case 0xcf: case 0xd3: width = 8; break;
+        default: return DIRECT_CODEC_BAD_TYPE;
+    }
+    if ((size_t)(end - p) < 1 + width) {
+        return DIRECT_CODEC_TRUNCATED;
+    }
+
+    const char *q = p + 1;
+    uint64_t raw = width == 1 ? (uint8_t)*q : width == 2 ? get16(q) : width == 4 ? get32(q) : get64(q);
+    p += 1 + width;
+
+    if (b <= 0xcf) {
+        *negative = false;
+        *u = raw;
+        return DIRECT_CODEC_OK;
+    }
+
+    int64_t v = width == 1 ? (int8_t)raw : width == 2 ? (int16_t)raw : width == 4 ? (int32_t)raw : (int64_t)raw;
+    *negative = v < 0;
+    if (v < 0) {
+        *s = v;
+    }
+    else {
+        *u = (uint64_t)v;
+    }
+    return DIRECT_CODEC_OK;
+}
+
+/**
+ * Wire traits per field type. Each specialization provides
+ *   maxSize                                   - worst-case encoded bytes
+ *   size_t encode(char*, T)                   - write the element, return bytes written
+ *   DirectCodecStatus decode(p, end, T&)      - read the element and advance p
+ *   bool inRange(T)                           - whether encode() can represent the value
+ */
+template <typename T, typename Enable = void>
+struct WireTraits;
+
+template <typename T>
+struct WireTraits<T, typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value &&
+                                             !std::is_same<T, bool>::value>::type>
+{
+    enum { maxSize = sizeof(T) == 1 ? 2 : 1 + sizeof(T) };
+
+    static size_t encode(char *p, T v) { return encodeUnsigned(p, v); }
+    static bool inRange(T) { return true; }
+
+    static DirectCodecStatus decode(const char *&p, const char *end, T &v)
+    {
+        bool negative;
+        uint64_t u;
+        int64_t s;
+        DirectCodecStatus status = decodeInteger(p, end, &negative, &u, &s);
+        if (status != DIRECT_CODEC_OK) {
+            return status;
+        }
+        if (negative || u > (uint64_t)std::numeric_limits<T>::max()) {
+            return DIRECT_CODEC_OUT_OF_RANGE;
+        }
+        v = (T)u;
+        return DIRECT_CODEC_OK;
+    }
+};
+
+template <typename T>
+struct WireTraits<T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type>
+{
+    enum { maxSize = 1 + sizeof(T) };
+
+    static size_t encode(char *p, T v) { return encodeSigned(p, v); }
+    static bool inRange(T) { return true; }
+
+    static DirectCodecStatus decode(const char *&p, const char *end, T &v)
+    {
+        bool negative;
+        uint64_t u;
+        int64_t s;
+        DirectCodecStatus status = decodeInteger(p, end, &negative, &u, &s);
+        if (status != DIRECT_CODEC_OK) {
+            return status;
+        }
+        if (negative ? s < (int64_t)std::numeric_limits<T>::min()
+                     : u > (uint64_t)std::numeric_limits<T>::max()) {
+            return DIRECT_CODEC_OUT_OF_RANGE;
+        }
+        v = negative ? (T)s : (T)u;
+        return DIRECT_CODEC_OK;
+    }
+};
+
+template <>
+struct WireTraits<SysBool>
+{
+    enum { maxSize = 1 };
+
+    static size_t encode(char *p, SysBool v)
+    {
+        p[0] = v ? (char)0xc3 : (char)0xc2;
+        return 1;
+    }
+
+    static bool inRange(SysBool) { return true; }
+
+    static DirectCodecStatus decode(const char *&p, const char *end, SysBool &v)
+    {
+        if (p >= end) {
+            return DIRECT_CODEC_TRUNCATED;
+        }
+        uint8_t b = (uint8_t)*p;
+        if (b != 0xc2 && b != 0xc3) {
+            return DIRECT_CODEC_BAD_TYPE;
+        }
+        v = b == 0xc3 ? TRUE : FALSE;
+        p += 1;
+        return DIRECT_CODEC_OK;
+    }
+};
+
+/**
+ * Fixed-width wire traits: every integer is written with the msgpack format of its type's full
+ * width (uint16 for UShort, int16 for SShort, ...) whatever its value, so a record of these
+ * fields always has the same size and layout. Any decoder reads them; decode takes the expected
+ * format without a width switch and falls back to WireTraits for anything else.
+ */
+template <typename T, typename Enable = void>
+struct FixedWireTraits : WireTraits<T>
+{
+};
+
+template <typename T>
+struct FixedWireTraits<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type>
+{
+    enum { maxSize = 1 + sizeof(T) };
+
+    static uint8_t tag()
+    {
+        return (uint8_t)((std::is_signed<T>::value ? 0xd0 : 0xcc) +
+                         (sizeof(T) == 1 ? 0 : sizeof(T) == 2 ? 1 : sizeof(T) == 4 ? 2 : 3));
+    }
+
+    static size_t encode(char *p, T v)
+    {
+        p[0] = (char)tag();
+        switch (sizeof(T)) {
+            case 1: p[1] = (char)v; break;
+            case 2: put16(p + 1, (uint16_t)v); break;
+            case 4: put32(p + 1, (uint32_t)v); break;
+            default: put64(p + 1, (uint64_t)v); break;
+        }
+        return maxSize;
+    }
+
+    static bool inRange(T) { return true; }
+
+    static DirectCodecStatus decode(const char *&p, const char *end, T &v)
+    {
+        if ((size_t)(end - p) >= (size_t)maxSize && (uint8_t)*p == tag()) {
+            const char *q = p + 1;
+            switch (sizeof(T)) {
+                case 1: v = (T)(uint8_t)*q; break;
+                case 2: v = (T)get16(q); break;
+                case 4: v = (T)get32(q); break;
+                default: v = (T)get64(q); break;
+            }
+            p += maxSize;
+            return DIRECT_CODEC_OK;
+        }
+        return WireTraits<T>::decode(p, end, v);
+    }
+};
+
+/**
+ * 32-bit wire traits: ULong and SLong are written as full-width uint32/int32 whatever the host's
+ * long size (sysDefs.h declares them 32-bit; LP64 makes them 64), and decoding rejects anything
+ * wider with DIRECT_CODEC_OUT_OF_RANGE, as the 32-bit target would. Other types are fixed width.
+ */
+template <typename T, typename Enable = void>
+struct Wire32Traits : FixedWireTraits<T>
+{
+};
+
+template <typename T>
+struct Wire32Traits<T, typename std::enable_if<std::is_same<T, ULong>::value || std::is_same<T, SLong>::value>::type>
+{
+    typedef typename std::conditional<std::is_signed<T>::value, int32_t, uint32_t>::type wire_type;
+    typedef FixedWireTraits<wire_type> wire;
+
+    enum { maxSize = wire::maxSize };
+
+    static bool inRange(T v)
+    {
+        return v >= (T)std::numeric_limits<wire_type>::min() && v <= (T)std::numeric_limits<wire_type>::max();
+    }
+
+    /* Truncates; DirectCodec::encode checks inRange() on every field first */
+    static size_t encode(char *p, T v) { return wire::encode(p, (wire_type)v); }
+
+    static DirectCodecStatus decode(const char *&p, const char *end, T &v)
+    {
+        wire_type w;
+        DirectCodecStatus status = wire::decode(p, end, w);
+        if (status == DIRECT_CODEC_OK) {
+            v = (T)w;
+        }
+        return status;
+    }
+};
+
+} // namespace direct_codec
+
+/**
+ * Integer encoding policy of a DirectCodec, chosen at compile time. Under a fixedWidth policy
+ * every record has the same size and each field a constant offset. Decoding accepts every msgpack
+ * integer format under every policy; only what encode() writes differs, except that
+ * DirectWire32Encoding also rejects ULong/SLong values outside 32 bits on both sides.
+ */
+struct DirectCompactEncoding        /**< Smallest fit, byte-identical to the msgpack-c packer */
+{
+    enum { fixedWidth = 0 };
+
+    template <typename T>
+    struct traits { typedef direct_codec::WireTraits<T> type; };
+};
+
+struct DirectFixedEncoding          /**< Full type width: constant record size and field offsets */
+{
+    enum { fixedWidth = 1 };
+
+    template <typename T>
+    struct traits { typedef direct_codec::FixedWireTraits<T> type; };
+};
+
+struct DirectWire32Encoding         /**< Full width, ULong/SLong as 32-bit: constant size on any host */
+{
+    enum { fixedWidth = 1 };
+
+    template <typename T>
+    struct traits { typedef direct_codec::Wire32Traits<T> type; };
+};
+
+/** One struct member in a DirectFieldList */
+template <typename Struct, typename Member, Member Struct::*Ptr>
+struct DirectField
+{
+    typedef Struct struct_type;
+    typedef Member member_type;
+
+    static const Member &get(const Struct &s) { return s.*Ptr; }
+    static Member &get(Struct &s) { return s.*Ptr; }
+};
+
+#define DIRECT_FIELD(Struct, member) DirectField<Struct, decltype(Struct::member), &Struct::member>
+
+/** Ordered list of DirectField; the order is the msgpack array order */
+template <typename... Fields>
+struct DirectFieldList;
+
+template <>
+struct DirectFieldList<>
+{
+    enum { count = 0 };
+
+    template <typename Encoding>
+    static constexpr size_t maxSize() { return 0; }
+
+    template <typename Encoding, typename Struct>
+    static size_t encode(char *, const Struct &) { return 0; }
+
+    template <typename Encoding, typename Struct>
+    static DirectCodecStatus decode(const char *&, const char *, Struct &) { return DIRECT_CODEC_OK; }
+
+    template <typename Encoding, typename Struct>
+    static bool inRange(const Struct &) { return true; }
+
+    template <typename Field>
+    static constexpr bool contains() { return false; }
+
+    template <typename Encoding, typename Field>
+    static constexpr size_t offsetOf() { return 0; }
+};
+
+template <typename Head, typename... Tail>
+struct DirectFieldList<Head, Tail...>
+{
+    typedef DirectFieldList<Tail...> tail;
+    enum { count = 1 + tail::count };
+
+    template <typename Encoding>
+    static constexpr size_t maxSize()
+    {
+        return Encoding::template traits<typename Head::member_type>::type::maxSize +
+               tail::template maxSize<Encoding>();
+    }
+
+    template <typename Encoding, typename Struct>
+    static size_t encode(char *p, const Struct &s)
+    {
+        size_t n = Encoding::template traits<typename Head::member_type>::type::encode(p, Head::get(s));
+        return n + tail::template encode<Encoding>(p + n, s);
+    }
+
+    template <typename Encoding, typename Struct>
+    static DirectCodecStatus decode(const char *&p, const char *end, Struct &s)
+    {
+        DirectCodecStatus status = Encoding::template traits<typename Head::member_type>::type::decode(p, end, Head::get(s));
+        if (status != DIRECT_CODEC_OK) {
+            return status;
+        }
+        return tail::template decode<Encoding>(p, end, s);
+    }
+
+    template <typename Encoding, typename Struct>
+    static bool inRange(const Struct &s)
+    {
+        return Encoding::template traits<typename Head::member_type>::type::inRange(Head::get(s)) &&
+               tail::template inRange<Encoding>(s);
+    }
+
+    template <typename Field>
+    static constexpr bool contains()
+    {
+        return std::is_same<Head, Field>::value || tail::template contains<Field>();
+    }
+
+    /** Byte offset of Field after the array header; exact only under a fixed-width encoding */
+    template <typename Encoding, typename Field>
+    static constexpr size_t offsetOf()
+    {
+        return std::is_same<Head, Field>::value ? 0
+               : Encoding::template traits<typename Head::member_type>::type::maxSize +
+                 tail::template offsetOf<Encoding, Field>();
+    }
+};
+
+/*
+ * DIRECT_FIELDS(Struct, a, b, c) is DirectFieldList<DIRECT_FIELD(Struct, a), DIRECT_FIELD(Struct, b),
+ * DIRECT_FIELD(Struct, c)>, for up to 15 members (the fixarray limit).
+ */
+#define DIRECT_FE_1(S, m)       DIRECT_FIELD(S, m)
+#define DIRECT_FE_2(S, m, ...)  DIRECT_FIELD(S, m), DIRECT_FE_1(S, __VA_ARGS__)
+#define DIRECT_FE_3(S, m, ...)  DIRECT_FIELD(S, m), DIRECT_FE_2(S, __VA_ARGS__)
+#define DIRECT_FE_4(S, m, ...)  DIRECT_FIELD(S, m), DIRECT_FE_3(S, __VA_ARGS__)
+#define DIRECT_FE_5(S, m, ...)  DIRECT_FIELD(S, m), DIRECT_FE_4(S, __VA_ARGS__)
+#define DIRECT_FE_6(S, m, ...)  DIRECT_FIELD(S, m), DIRECT_FE_5(S, __VA_ARGS__)
+#define DIRECT_FE_7(S, m, ...)  DIRECT_FIELD(S, m), DIRECT_FE_6(S, __VA_ARGS__)
+#define DIRECT_FE_8(S, m, ...)  DIRECT_FIELD(S, m), DIRECT_FE_7(S, __VA_ARGS__)
+#define DIRECT_FE_9(S, m, ...)  DIRECT_FIELD(S, m), DIRECT_FE_8(S, __VA_ARGS__)
+#define DIRECT_FE_10(S, m, ...) DIRECT_FIELD(S, m), DIRECT_FE_9(S, __VA_ARGS__)
+#define DIRECT_FE_11(S, m, ...) DIRECT_FIELD(S, m), DIRECT_FE_10(S, __VA_ARGS__)
+#define DIRECT_FE_12(S, m, ...) DIRECT_FIELD(S, m), DIRECT_FE_11(S, __VA_ARGS__)
+#define DIRECT_FE_13(S, m, ...) DIRECT_FIELD(S, m), DIRECT_FE_12(S, __VA_ARGS__)
+#define DIRECT_FE_14(S, m, ...) DIRECT_FIELD(S, m), DIRECT_FE_13(S, __VA_ARGS__)
+#define DIRECT_FE_15(S, m, ...) DIRECT_FIELD(S, m), DIRECT_FE_14(S, __VA_ARGS__)
+#define DIRECT_FE_COUNT(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, N, ...) DIRECT_FE_##N
+#define DIRECT_FIELDS(S, ...) \
+        DirectFieldList<DIRECT_FE_COUNT(__VA_ARGS__, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)(S, __VA_ARGS__)>
+
+template <typename Struct, typename Fields, typename Encoding = DirectCompactEncoding>
+class DirectCodec
+{
+    static_assert(Fields::count < 16, "DirectCodec only emits fixarray headers");
+
+public:
+    typedef Fields fields;
+    typedef Encoding encoding;
+
+    /** Worst-case size of one encoded record (the exact size under the fixed-width encodings) */
+    enum { maxSize = 1 + Fields::template maxSize<Encoding>() };
+
+    /**
+     * Encode s into out. Returns the number of bytes written, or 0 if capacity is below maxSize
+     * (the check is against the worst case so the field writers never need bounds checks) or a
+     * field value does not fit the encoding (only possible with DirectWire32Encoding).
+     */
+    static size_t encode(const Struct &s, char *out, size_t capacity)
+    {
+        if (capacity < (size_t)maxSize || !Fields::template inRange<Encoding>(s)) {
+            return 0;
+        }
+        out[0] = (char)(0x90 | Fields::count);
+        return 1 + Fields::template encode<Encoding>(out + 1, s);
+    }
+
+    /**
+     * Decode one record from [data, data + len). On success s is fully written and, if consumed
+     * is not NULL, *consumed holds the number of bytes used. On failure s may be partially written.
+     */
+    static DirectCodecStatus decode(const char *data, size_t len, Struct &s, size_t *consumed = NULL)
+    {
+        if (len == 0) {
+            return DIRECT_CODEC_TRUNCATED;
+        }
+        uint8_t b = (uint8_t)data[0];
+        uint32_t n;
+        const char *p;
+        if ((b & 0xf0) == 0x90) {
+            n = b & 0x0f;
+            p = data + 1;
+        }
+        else if (b == 0xdc) {
+            if (len < 3) {
+                return DIRECT_CODEC_TRUNCATED;
+            }
+            n = direct_codec::get16(data + 1);
+            p = data + 3;
+        }
+        else if (b == 0xdd) {
+            if (len < 5) {
+                return DIRECT_CODEC_TRUNCATED;
+            }
+            n = direct_codec::get32(data + 1);
+            p = data + 5;
+        }
+        else {
+            return DIRECT_CODEC_BAD_ARRAY;
+        }
+        if (n != (uint32_t)Fields::count) {
+            return DIRECT_CODEC_BAD_ARRAY;
+        }
+
+        DirectCodecStatus status = Fields::template decode<Encoding>(p, data + len, s);
+        if (status == DIRECT_CODEC_OK && consumed != NULL) {
+            *consumed = (size_t)(p - data);
+        }
+        return status;
+    }
+};
+
+#endif //DIRECTCODEC_H
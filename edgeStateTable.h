@@ -0,0 +1,137 @@
+#ifndef EDGESTATETABLE_H
+#define EDGESTATETABLE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include "ngpsOutput.h"
+
+/**
+ * Latest ngps_output per edge. edge_id is a UShort so the table is a dense array of one
+ * cache-line-aligned seqlock slot per edge.
+ *
+ * Writers (any number of decoding threads) claim a slot by moving its sequence from even to odd
+ * with a CAS, store the record, then release it with the next even value. Readers never block
+ * or write shared memory: they copy the record and retry if the sequence was odd or changed
+ * meanwhile. The record is stored as relaxed atomic words so concurrent copies are well defined.
+ */
+class EdgeStateTable
+{
+public:
+    enum { EDGE_COUNT = MAX_UNSIGNED_SHORT + 1 };
+
+    EdgeStateTable()
+    {
+        void *mem = aligned_alloc(CACHE_LINE, sizeof(Slot) * EDGE_COUNT);
+        if (mem == NULL) {
+            throw std::bad_alloc();
+        }
+        slots = static_cast<Slot *>(mem);
+        for (size_t i = 0; i < EDGE_COUNT; ++i) {
+            new (&slots[i]) Slot();
+        }
+    }
+
+    ~EdgeStateTable()
+    {
+        for (size_t i = 0; i < EDGE_COUNT; ++i) {
+            slots[i].~Slot();
+        }
+        free(slots);
+    }
+
+    EdgeStateTable(const EdgeStateTable &) = delete;
+    EdgeStateTable &operator=(const EdgeStateTable &) = delete;
+
+    void update(const ngps_output &msg)
+    {
+        Slot &slot = slots[msg.edge_id];
+        uint64_t words[WORDS] = {0};
+        memcpy(words, &msg, sizeof(msg));
+
+        uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+        for (unsigned int spins = 0;; ++spins) {
+            if ((seq & 1) == 0 &&
+                slot.seq.compare_exchange_weak(seq, seq + 1, std::memory_order_relaxed)) {
+                break;
+            }
+            backoff(spins);
+            seq = slot.seq.load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < WORDS; ++i) {
+            slot.words[i].store(words[i], std::memory_order_relaxed);
+        }
+        slot.seq.store(seq + 2, std::memory_order_release);
+    }
+
+    /* Copy a consistent snapshot of the latest report for edgeId. Returns FALSE if never reported */
+    SysBool latest(UShort edgeId, ngps_output &out) const
+    {
+        const Slot &slot = slots[edgeId];
+        uint64_t words[WORDS];
+        uint64_t before;
+        uint64_t after = 0;
+        unsigned int spins = 0;
+
+        do {
+            backoff(spins++);
+            before = slot.seq.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+            for (size_t i = 0; i < WORDS; ++i) {
+                words[i] = slot.words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = slot.seq.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+
+        if (before == 0) {
+            return FALSE;
+        }
+        memcpy(&out, words, sizeof(out));
+        return TRUE;
+    }
+
+    /* Number of completed updates of edgeId */
+    unsigned long updates(UShort edgeId) const
+    {
+        return (unsigned long)(slots[edgeId].seq.load(std::memory_order_acquire) >> 1);
+    }
+
+private:
+    static_assert(std::is_trivially_copyable<ngps_output>::value, "ngps_output is copied as raw words");
+
+    /* Spin briefly, then yield so a preempted writer can finish on an oversubscribed core */
+    static void backoff(unsigned int spins)
+    {
+        if (spins >= SPIN_LIMIT) {
+            std::this_thread::yield();
+        }
+    }
+
+    enum { CACHE_LINE = 64, SPIN_LIMIT = 64, WORDS = (sizeof(ngps_output) + sizeof(uint64_t) - 1) / sizeof(uint64_t) };
+
+    struct alignas(CACHE_LINE) Slot
+    {
+        std::atomic<uint64_t> seq{0};
+        std::atomic<uint64_t> words[WORDS];
+
+        Slot()
+        {
+            for (size_t i = 0; i < WORDS; ++i) {
+                words[i].store(0, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    Slot *slots;
+};
+
+#endif //EDGESTATETABLE_H
@@ -0,0 +1,514 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <arpa/inet.h>
+#include <linux/io_uring.h>
+#include <algorithm>
+#include <set>
+#include "eventLoop.h"
+#include "instrument.h"
+
+/**
+ * Readiness source behind NgpsEventLoop. wait() fills fds with sockets that became readable and
+ * returns their count, 0 on timeout, or RETURN_FAILURE.
+ */
+class EventPoller
+{
+public:
+    virtual ~EventPoller() {}
+    virtual int watch(int fd) = 0;
+    virtual int unwatch(int fd) = 0;
+    virtual int wait(int *fds, int max, const struct timespec &timeout) = 0;
+};
+
+namespace {
+
+class EpollPoller : public EventPoller
+{
+public:
+    EpollPoller() : epfd(epoll_create1(EPOLL_CLOEXEC)) {}
+    ~EpollPoller() override { if (epfd >= 0) close(epfd); }
+
+    bool ok() const { return epfd >= 0; }
+
+    int watch(int fd) override
+    {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0 ? RETURN_FAILURE : RETURN_SUCCESS;
+    }
+
+    int unwatch(int fd) override
+    {
+        return epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL) < 0 ? RETURN_FAILURE : RETURN_SUCCESS;
+    }
+
+    int wait(int *fds, int max, const struct timespec &timeout) override
+    {
+        struct epoll_event events[64];
+        int ms = (int)(timeout.tv_sec * 1000 + (timeout.tv_nsec + 999999) / 1000000);
+        int n = epoll_wait(epfd, events, MIN(max, (int)LENGTHOF(events)), ms);
+        if (n < 0) {
+            return errno == EINTR ? 0 : RETURN_FAILURE;
+        }
+        for (int i = 0; i < n; ++i) {
+            fds[i] = events[i].data.fd;
+        }
+        return n;
+    }
+
+private:
+    int epfd;
+};
+
+/*
+ * io_uring readiness via multishot IORING_OP_POLL_ADD, driven with raw syscalls so no liburing
+ * dependency is needed. Each watched fd has one poll request whose user_data is the fd; it is
+ * re-armed whenever the kernel ends the multishot sequence.
+ */
+class UringPoller : public EventPoller
+{
+public:
+    UringPoller()
+    {
+        struct io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        ringfd = (int)syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+        if (ringfd < 0) {
+            return;
+        }
+        if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+            close(ringfd);
+            ringfd = -1;
+            return;
+        }
+
+        sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        ringSize = MAX(sqSize, cqSize);
+        ring = mmap(NULL, ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQ_RING);
+        sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+        void *sqeMem = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQES);
+        if (ring == MAP_FAILED || sqeMem == MAP_FAILED) {
+            if (ring != MAP_FAILED) munmap(ring, ringSize);
+            if (sqeMem != MAP_FAILED) munmap(sqeMem, sqesSize);
+            ring = NULL;
+            close(ringfd);
+            ringfd = -1;
+            return;
+        }
+
+        char *base = (char *)ring;
+        sqHead = (unsigned *)(base + params.sq_off.head);
+        sqTail = (unsigned *)(base + params.sq_off.tail);
+        sqMask = *(unsigned *)(base + params.sq_off.ring_mask);
+        sqArray = (unsigned *)(base + params.sq_off.array);
+        cqHead = (unsigned *)(base + params.cq_off.head);
+        cqTail = (unsigned *)(base + params.cq_off.tail);
+        cqMask = *(unsigned *)(base + params.cq_off.ring_mask);
+        cqes = (struct io_uring_cqe *)(base + params.cq_off.cqes);
+        sqes = (struct io_uring_sqe *)sqeMem;
+        sqEntries = params.sq_entries;
+    }
+
+    ~UringPoller() override
+    {
+        if (ringfd >= 0) {
+            munmap(sqes, sqesSize);
+            munmap(ring, ringSize);
+            close(ringfd);
+        }
+    }
+
+    bool ok() const { return ringfd >= 0; }
+
+    int watch(int fd) override
+    {
+        if (!pollAdd(fd)) {
+            return RETURN_FAILURE;
+        }
+        watched.insert(fd);
+        return RETURN_SUCCESS;
+    }
+
+    int unwatch(int fd) override
+    {
+        if (watched.erase(fd) == 0) {
+            return RETURN_FAILURE;
+        }
+        struct io_uring_sqe *sqe = nextSqe();
+        if (sqe == NULL) {
+            return RETURN_FAILURE;
+        }
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = (uint64_t)fd;
+        sqe->user_data = REMOVE_TAG;
+        return RETURN_SUCCESS;
+    }
+
+    int wait(int *fds, int max, const struct timespec &timeout) override
+    {
+        int n = reap(fds, max);
+        if (n > 0 && pending == 0) {
+            return n;
+        }
+
+        struct __kernel_timespec ts;
+        ts.tv_sec = n > 0 ? 0 : timeout.tv_sec;
+        ts.tv_nsec = n > 0 ? 0 : timeout.tv_nsec;
+        struct io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+
+        unsigned submit = pending;
+        int rc = (int)syscall(__NR_io_uring_enter, ringfd, submit, n > 0 ? 0 : 1,
+                              IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+        if (rc < 0 && errno != ETIME && errno != EINTR && errno != EBUSY) {
+            return RETURN_FAILURE;
+        }
+        if (rc >= 0) {
+            pending -= MIN((unsigned)rc, pending);
+        }
+        return n + reap(fds + n, max - n);
+    }
+
+private:
+    enum { RING_ENTRIES = 256 };
+    static constexpr uint64_t REMOVE_TAG = ~(uint64_t)0;
+
+    struct io_uring_sqe *nextSqe()
+    {
+        unsigned tail = *sqTail;
+        if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+            return NULL;
+        }
+        struct io_uring_sqe *sqe = &sqes[tail & sqMask];
+        memset(sqe, 0, sizeof(*sqe));
+        sqArray[tail & sqMask] = tail & sqMask;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        ++pending;
+        return sqe;
+    }
+
+    bool pollAdd(int fd)
+    {
+        struct io_uring_sqe *sqe = nextSqe();
+        if (sqe == NULL) {
+            return false;
+        }
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = fd;
+        sqe->poll32_events = POLLIN;
+        sqe->len = IORING_POLL_ADD_MULTI;
+        sqe->user_data = (uint64_t)fd;
+        return true;
+    }
+
+    int reap(int *fds, int max)
+    {
+        int n = 0;
+        unsigned head = *cqHead;
+        while (n < max && head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+            const struct io_uring_cqe &cqe = cqes[head & cqMask];
+            ++head;
+            if (cqe.user_data == REMOVE_TAG) {
+                continue;
+            }
+            int fd = (int)cqe.user_data;
+            if (watched.count(fd) == 0) {
+                continue;
+            }
+            if (!(cqe.flags & IORING_CQE_F_MORE)) {
+                pollAdd(fd);    /* multishot ended (or was never supported): re-arm */
+            }
+            if (cqe.res > 0) {
+                fds[n++] = fd;
+            }
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        return n;
+    }
+
+    int ringfd = -1;
+    void *ring = NULL;
+    size_t ringSize = 0;
+    size_t sqSize = 0;
+    size_t cqSize = 0;
+    size_t sqesSize = 0;
+    unsigned *sqHead = NULL;
+    unsigned *sqTail = NULL;
+    unsigned sqMask = 0;
+    unsigned *sqArray = NULL;
+    unsigned sqEntries = 0;
+    unsigned *cqHead = NULL;
+    unsigned *cqTail = NULL;
+    unsigned cqMask = 0;
+    struct io_uring_cqe *cqes = NULL;
+    struct io_uring_sqe *sqes = NULL;
+    unsigned pending = 0;
+    std::set<int> watched;
+};
+
+} // namespace
+
+NgpsEventLoop::NgpsEventLoop(EventLoopBackend backend) : active(EVENT_LOOP_EPOLL)
+{
+    if (backend != EVENT_LOOP_EPOLL) {
+        std::unique_ptr<UringPoller> uring(new UringPoller());
+        if (uring->ok()) {
+            poller = std::move(uring);
+            active = EVENT_LOOP_IO_URING;
+            return;
+        }
+    }
+    poller.reset(new EpollPoller());
+}
+
+NgpsEventLoop::~NgpsEventLoop()
+{
+}
+
+uint64_t NgpsEventLoop::peerKey(int fd, const sockaddr_in &addr)
+{
+    // A datagram sent to INADDR_ANY reaches the local host and is answered from loopback
+    uint32_t ip = addr.sin_addr.s_addr == htonl(INADDR_ANY) ? htonl(INADDR_LOOPBACK) : addr.sin_addr.s_addr;
+    return ((uint64_t)(uint16_t)fd << 48) | ((uint64_t)ntohl(ip) << 16) | ntohs(addr.sin_port);
+}
+
+int NgpsEventLoop::addSocket(int fd, ReceiveHandler onReceive)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        return RETURN_FAILURE;
+    }
+    if (poller->watch(fd) != RETURN_SUCCESS) {
+        return RETURN_FAILURE;
+    }
+    sockets[fd] = onReceive;
+    return RETURN_SUCCESS;
+}
+
+int NgpsEventLoop::removeSocket(int fd)
+{
+    if (sockets.erase(fd) == 0) {
+        return RETURN_FAILURE;
+    }
+    backlog.erase(std::remove(backlog.begin(), backlog.end(), fd), backlog.end());
+    return poller->unwatch(fd);
+}
+
+int NgpsEventLoop::send(int fd, const sockaddr_in &to, const ngps_output &msg)
+{
+    char buf[NGPS_OUTPUT_MAX_PACKED_SIZE];
+    INSTRUMENT(uint64_t t0 = instrNow());
+    size_t n = NgpsCodec::encode(msg, buf, sizeof(buf));
+    INSTRUMENT(instrStage(STAGE_PACK, t0));
+    return send(fd, to, buf, n);
+}
+
+int NgpsEventLoop::send(int fd, const sockaddr_in &to, const char *data, size_t size)
+{
+    INSTRUMENT(uint64_t t1 = instrNow());
+    ssize_t sent = sendto(fd, data, size, MSG_DONTWAIT, (const struct sockaddr *)&to, sizeof(to));
+    INSTRUMENT(instrStage(STAGE_SEND, t1));
+    if (size == 0 || sent != (ssize_t)size) {
+        INSTRUMENT(instrCount(COUNTER_DROPS));
+        return RETURN_FAILURE;
+    }
+    return RETURN_SUCCESS;
+}
+
+int NgpsEventLoop::request(int fd, const sockaddr_in &to, const ngps_output &msg,
+                           std::chrono::microseconds timeout, ReplyHandler onReply)
+{
+    char buf[NGPS_OUTPUT_MAX_PACKED_SIZE];
+    INSTRUMENT(uint64_t t0 = instrNow());
+    size_t n = NgpsCodec::encode(msg, buf, sizeof(buf));
+    INSTRUMENT(instrStage(STAGE_PACK, t0));
+    return request(fd, to, buf, n, timeout, onReply);
+}
+
+int NgpsEventLoop::request(int fd, const sockaddr_in &to, const char *data, size_t size,
+                           std::chrono::microseconds timeout, ReplyHandler onReply)
+{
+    if (send(fd, to, data, size) != RETURN_SUCCESS) {
+        return RETURN_FAILURE;
+    }
+
+    uint64_t id = nextId++;
+    uint64_t peer = peerKey(fd, to);
+    Pending &pending = requests[id];
+    pending.peer = peer;
+    pending.onReply = onReply;
+    outstanding[peer].push_back(id);
+
+    Deadline deadline;
+    deadline.when = Clock::now() + timeout;
+    deadline.id = id;
+    deadlines.push(deadline);
+    return RETURN_SUCCESS;
+}
+
+void NgpsEventLoop::addTimer(std::chrono::microseconds delay, TimerHandler onTimer)
+{
+    uint64_t id = nextId++;
+    timers[id] = onTimer;
+
+    Deadline deadline;
+    deadline.when = Clock::now() + delay;
+    deadline.id = id;
+    deadlines.push(deadline);
+}
+
+int NgpsEventLoop::drain(int fd)
+{
+    int handled = 0;
+    char buffer[MAXLINE];
+
+    for (int reads = 0;; ++reads) {
+        if (reads == DRAIN_BATCH) {
+            // Readiness (io_uring multishot poll) is not reported again for what is still queued
+            if (std::find(backlog.begin(), backlog.end(), fd) == backlog.end()) {
+                backlog.push_back(fd);
+            }
+            break;
+        }
+        sockaddr_in from;
+        socklen_t len = sizeof(from);
+        INSTRUMENT(uint64_t t0 = instrNow());
+        ssize_t n = recvfrom(fd, buffer, MAXLINE, MSG_DONTWAIT | MSG_TRUNC, (struct sockaddr *)&from, &len);
+        if (n < 0) {
+            break;
+        }
+        INSTRUMENT(instrStage(STAGE_RECV, t0));
+        if (n > MAXLINE) {
+            INSTRUMENT(instrCount(COUNTER_TRUNCATED));
+            ++errors;
+            continue;
+        }
+
+        ngps_output msg;
+        INSTRUMENT(uint64_t t1 = instrNow());
+        if (NgpsCodec::decode(buffer, (size_t)n, msg) != DIRECT_CODEC_OK) {
+            INSTRUMENT(instrCount(COUNTER_DECODE_ERRORS));
+            ++errors;
+            continue;
+        }
+        INSTRUMENT(instrStage(STAGE_DECODE, t1));
+        INSTRUMENT(instrCount(COUNTER_MESSAGES));
+
+        std::map<uint64_t, std::deque<uint64_t> >::iterator waiting = outstanding.find(peerKey(fd, from));
+        if (waiting != outstanding.end()) {
+            uint64_t id = waiting->second.front();
+            waiting->second.pop_front();
+            if (waiting->second.empty()) {
+                outstanding.erase(waiting);
+            }
+            ReplyHandler onReply = requests[id].onReply;
+            requests.erase(id);     /* its deadline entry is skipped lazily in expire() */
+            onReply(NGPS_REQUEST_OK, msg);
+        }
+        else {
+            std::unordered_map<int, ReceiveHandler>::iterator socket = sockets.find(fd);
+            if (socket == sockets.end()) {
+                break;
+            }
+            if (socket->second) {
+                socket->second(fd, from, msg);
+            }
+        }
+        ++handled;
+    }
+    return handled;
+}
+
+int NgpsEventLoop::expire()
+{
+    int handled = 0;
+    Clock::time_point now = Clock::now();
+
+    while (!deadlines.empty() && deadlines.top().when <= now) {
+        uint64_t id = deadlines.top().id;
+        deadlines.pop();
+
+        std::unordered_map<uint64_t, TimerHandler>::iterator timer = timers.find(id);
+        if (timer != timers.end()) {
+            TimerHandler onTimer = timer->second;
+            timers.erase(timer);
+            onTimer();
+            ++handled;
+            continue;
+        }
+
+        std::unordered_map<uint64_t, Pending>::iterator pending = requests.find(id);
+        if (pending == requests.end()) {
+            continue;   /* already answered */
+        }
+        std::deque<uint64_t> &queue = outstanding[pending->second.peer];
+        for (std::deque<uint64_t>::iterator it = queue.begin(); it != queue.end(); ++it) {
+            if (*it == id) {
+                queue.erase(it);
+                break;
+            }
+        }
+        if (queue.empty()) {
+            outstanding.erase(pending->second.peer);
+        }
+        ReplyHandler onReply = pending->second.onReply;
+        requests.erase(pending);
+        onReply(NGPS_REQUEST_TIMEOUT, ngps_output());
+        ++handled;
+    }
+    return handled;
+}
+
+int NgpsEventLoop::runOnce(std::chrono::microseconds maxWait)
+{
+    Clock::duration wait = backlog.empty() ? Clock::duration(maxWait) : Clock::duration::zero();
+    if (!deadlines.empty()) {
+        Clock::duration untilDeadline = deadlines.top().when - Clock::now();
+        wait = MAX(Clock::duration::zero(), MIN(wait, untilDeadline));
+    }
+    long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(wait).count();
+    struct timespec timeout;
+    timeout.tv_sec = ns / 1000000000;
+    timeout.tv_nsec = ns % 1000000000;
+
+    int ready[64];
+    int n = poller->wait(ready, (int)LENGTHOF(ready), timeout);
+    if (n < 0) {
+        return RETURN_FAILURE;
+    }
+
+    int handled = 0;
+    std::vector<int> queued;
+    queued.swap(backlog);
+    for (int i = 0; i < n; ++i) {
+        queued.erase(std::remove(queued.begin(), queued.end(), ready[i]), queued.end());
+        handled += drain(ready[i]);
+    }
+    for (size_t i = 0; i < queued.size(); ++i) {
+        handled += drain(queued[i]);
+    }
+    return handled + expire();
+}
+
+void NgpsEventLoop::run()
+{
+    stopped = FALSE;
+    while (!stopped) {
+        if (runOnce(std::chrono::milliseconds(100)) < 0) {
+            break;
+        }
+    }
+}
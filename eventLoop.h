@@ -0,0 +1,128 @@
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#include <stdint.h>
+#include <netinet/in.h>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+#include "ngpsOutput.h"
+
+typedef enum EventLoopBackend
+{
+    EVENT_LOOP_AUTO = 0,        /**< io_uring when the kernel supports it, epoll otherwise */
+    EVENT_LOOP_IO_URING,
+    EVENT_LOOP_EPOLL
+} EventLoopBackend;
+
+typedef enum NgpsRequestStatus
+{
+    NGPS_REQUEST_OK = 0,        /**< Reply received and decoded */
+    NGPS_REQUEST_TIMEOUT        /**< No reply before the deadline */
+} NgpsRequestStatus;
+
+class EventPoller;
+
+/**
+ * Single-threaded event loop for ngps_output traffic over non-blocking UDP sockets.
+ *
+ * Any number of sockets can be registered; readiness comes from io_uring (multishot poll) or
+ * epoll. Decoded datagrams are delivered to the socket's receive handler unless they answer an
+ * outstanding request(): replies are matched to requests per (socket, peer) in FIFO order, since
+ * the wire format carries no request id. Requests and timers share one deadline heap, so nothing
+ * ever blocks past the next deadline. All handlers run on the thread calling run()/runOnce().
+ * A socket is read at most DRAIN_BATCH datagrams per runOnce(), so a flooding peer cannot keep
+ * timers and request timeouts from running; one left with datagrams queued is read again on the
+ * next runOnce() without waiting for readiness.
+ */
+class NgpsEventLoop
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+    typedef std::function<void(int fd, const sockaddr_in &from, const ngps_output &msg)> ReceiveHandler;
+    typedef std::function<void(NgpsRequestStatus status, const ngps_output &reply)> ReplyHandler;
+    typedef std::function<void()> TimerHandler;
+
+    explicit NgpsEventLoop(EventLoopBackend backend = EVENT_LOOP_AUTO);
+    ~NgpsEventLoop();
+
+    NgpsEventLoop(const NgpsEventLoop &) = delete;
+    NgpsEventLoop &operator=(const NgpsEventLoop &) = delete;
+
+    /* Backend actually in use (never EVENT_LOOP_AUTO) */
+    EventLoopBackend backend() const { return active; }
+
+    /* Make fd non-blocking and watch it. Returns RETURN_SUCCESS or RETURN_FAILURE */
+    int addSocket(int fd, ReceiveHandler onReceive);
+    int removeSocket(int fd);
+
+    /* Fire-and-forget send. Returns RETURN_SUCCESS or RETURN_FAILURE */
+    int send(int fd, const sockaddr_in &to, const ngps_output &msg);
+
+    /* Fire-and-forget send of an already encoded record (e.g. NgpsPreparedMessage::data()) */
+    int send(int fd, const sockaddr_in &to, const char *data, size_t size);
+
+    /**
+     * Send msg and call onReply with the next datagram from the same peer on the same socket,
+     * or with NGPS_REQUEST_TIMEOUT once timeout expires. Returns RETURN_FAILURE if the send fails
+     * (onReply is then never called).
+     */
+    int request(int fd, const sockaddr_in &to, const ngps_output &msg, std::chrono::microseconds timeout,
+                ReplyHandler onReply);
+
+    /* request() with an already encoded record */
+    int request(int fd, const sockaddr_in &to, const char *data, size_t size, std::chrono::microseconds timeout,
+                ReplyHandler onReply);
+
+    /* Call onTimer once after delay */
+    void addTimer(std::chrono::microseconds delay, TimerHandler onTimer);
+
+    /* Wait at most maxWait for I/O, dispatch it and any expired timers. Returns handlers run */
+    int runOnce(std::chrono::microseconds maxWait);
+
+    /* Dispatch until stop() is called from a handler */
+    void run();
+    void stop() { stopped = TRUE; }
+
+    unsigned long decodeErrors() const { return errors; }
+
+private:
+    enum { DRAIN_BATCH = 64 };
+
+    struct Pending
+    {
+        uint64_t peer;
+        ReplyHandler onReply;
+    };
+
+    struct Deadline
+    {
+        Clock::time_point when;
+        uint64_t id;
+        bool operator>(const Deadline &rhs) const { return when > rhs.when; }
+    };
+
+    static uint64_t peerKey(int fd, const sockaddr_in &addr);
+
+    int drain(int fd);
+    int expire();
+
+    std::unique_ptr<EventPoller> poller;
+    EventLoopBackend active;
+    std::unordered_map<int, ReceiveHandler> sockets;
+    std::unordered_map<uint64_t, Pending> requests;
+    std::unordered_map<uint64_t, TimerHandler> timers;
+    std::map<uint64_t, std::deque<uint64_t> > outstanding;    /* peer -> request ids, oldest first */
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline> > deadlines;
+    std::vector<int> backlog;       /* sockets whose last drain stopped at DRAIN_BATCH */
+    uint64_t nextId = 1;
+    SysBool stopped = FALSE;
+    unsigned long errors = 0;
+};
+
+#endif //EVENTLOOP_H
@@ -0,0 +1,48 @@
+#ifndef FIXEDBUFFER_H
+#define FIXEDBUFFER_H
+
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * Fixed-capacity msgpack output stream. It satisfies the Stream concept used by
+ * msgpack::packer<Stream> (a write(const char*, size_t) member) so the existing
+ * adaptor::pack specializations work unchanged, but it lives entirely inside the
+ * object: on the stack, in a ring slot, or embedded in another struct. It never
+ * calls the allocator. A write that does not fit is dropped and sets overflow().
+ */
+template <size_t Capacity>
+class FixedBuffer
+{
+public:
+    FixedBuffer() : used(0), overflowed(false) {}
+
+    void write(const char *buf, size_t len)
+    {
+        if (len > Capacity - used) {
+            overflowed = true;
+            return;
+        }
+        memcpy(bytes + used, buf, len);
+        used += len;
+    }
+
+    void clear()
+    {
+        used = 0;
+        overflowed = false;
+    }
+
+    char *data() { return bytes; }
+    const char *data() const { return bytes; }
+    size_t size() const { return used; }
+    bool overflow() const { return overflowed; }
+    static size_t capacity() { return Capacity; }
+
+private:
+    char bytes[Capacity];
+    size_t used;
+    bool overflowed;
+};
+
+#endif //FIXEDBUFFER_H
@@ -0,0 +1,246 @@
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+# include <x86intrin.h>
+#endif
+#include "instrument.h"
+
+namespace {
+
+struct ThreadStats
+{
+    std::atomic<uint64_t> buckets[STAGE_COUNT][INSTR_BUCKETS];
+    std::atomic<uint64_t> maxTicks[STAGE_COUNT];
+    std::atomic<uint64_t> counters[COUNTER_COUNT];
+
+    ThreadStats()
+    {
+        for (int s = 0; s < STAGE_COUNT; ++s) {
+            for (int b = 0; b < INSTR_BUCKETS; ++b) {
+                buckets[s][b].store(0, std::memory_order_relaxed);
+            }
+            maxTicks[s].store(0, std::memory_order_relaxed);
+        }
+        for (int c = 0; c < COUNTER_COUNT; ++c) {
+            counters[c].store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+/* Threads register once; their stats outlive them so a final snapshot still sees their counts */
+std::mutex registryLock;
+std::vector<std::unique_ptr<ThreadStats> > registry;
+thread_local ThreadStats *local = NULL;
+
+ThreadStats &threadStats()
+{
+    if (local == NULL) {
+        std::unique_ptr<ThreadStats> stats(new ThreadStats());
+        local = stats.get();
+        std::lock_guard<std::mutex> lock(registryLock);
+        registry.push_back(std::move(stats));
+    }
+    return *local;
+}
+
+/* Single-writer increment: only the owning thread stores, snapshots only load */
+inline void bump(std::atomic<uint64_t> &cell, uint64_t n)
+{
+    cell.store(cell.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+unsigned int bucketIndex(uint64_t v)
+{
+    if (v < (1 << INSTR_SUB_BITS)) {
+        return (unsigned int)v;
+    }
+    unsigned int msb = 63 - (unsigned int)__builtin_clzll(v);
+    unsigned int sub = (unsigned int)(v >> (msb - INSTR_SUB_BITS)) & ((1 << INSTR_SUB_BITS) - 1);
+    return (msb - INSTR_SUB_BITS + 1) * (1 << INSTR_SUB_BITS) + sub;
+}
+
+uint64_t bucketUpper(unsigned int i)
+{
+    if (i < (1 << INSTR_SUB_BITS)) {
+        return i;
+    }
+    unsigned int shift = (i >> INSTR_SUB_BITS) - 1;
+    uint64_t sub = i & ((1 << INSTR_SUB_BITS) - 1);
+    return (((1 << INSTR_SUB_BITS) + sub + 1) << shift) - 1;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/* TSC ticks per nanosecond, measured once against steady_clock */
+double calibrateTicksPerNs()
+{
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point t0 = Clock::now();
+    uint64_t c0 = __rdtsc();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    uint64_t c1 = __rdtsc();
+    double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count();
+    return ns > 0 ? (double)(c1 - c0) / ns : 1.0;
+}
+
+double ticksPerNs()
+{
+    static const double ratio = calibrateTicksPerNs();
+    return ratio;
+}
+#else
+double ticksPerNs()
+{
+    return 1.0;
+}
+#endif
+
+const char *const stageNames[STAGE_COUNT] = {"pack", "send", "recv", "unpack", "convert", "decode"};
+const char *const counterNames[COUNTER_COUNT] = {"messages", "drops", "decode_errors", "truncated"};
+
+} // namespace
+
+uint64_t InstrHistogram::percentileNs(double q) const
+{
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(q * (double)total);
+    if (rank >= total) {
+        rank = total - 1;
+    }
+    uint64_t seen = 0;
+    for (unsigned int i = 0; i < INSTR_BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen > rank) {
+            uint64_t upper = (uint64_t)((double)bucketUpper(i) / ticksPerNs());
+            return MIN(upper, maxNs);
+        }
+    }
+    return maxNs;
+}
+
+uint64_t instrNow()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void instrStage(InstrStage stage, uint64_t start)
+{
+    uint64_t ticks = instrNow() - start;
+    ThreadStats &stats = threadStats();
+    bump(stats.buckets[stage][bucketIndex(ticks)], 1);
+    if (ticks > stats.maxTicks[stage].load(std::memory_order_relaxed)) {
+        stats.maxTicks[stage].store(ticks, std::memory_order_relaxed);
+    }
+}
+
+void instrCount(InstrCounter counter, uint64_t n)
+{
+    bump(threadStats().counters[counter], n);
+}
+
+void instrSnapshot(InstrSnapshot &snapshot)
+{
+    memset(&snapshot, 0, sizeof(snapshot));
+    double ratio = ticksPerNs();
+
+    std::lock_guard<std::mutex> lock(registryLock);
+    for (size_t t = 0; t < registry.size(); ++t) {
+        const ThreadStats &stats = *registry[t];
+        for (int s = 0; s < STAGE_COUNT; ++s) {
+            InstrHistogram &h = snapshot.stages[s];
+            for (int b = 0; b < INSTR_BUCKETS; ++b) {
+                uint64_t n = stats.buckets[s][b].load(std::memory_order_relaxed);
+                h.counts[b] += n;
+                h.total += n;
+            }
+            uint64_t maxNs = (uint64_t)((double)stats.maxTicks[s].load(std::memory_order_relaxed) / ratio);
+            h.maxNs = MAX(h.maxNs, maxNs);
+        }
+        for (int c = 0; c < COUNTER_COUNT; ++c) {
+            snapshot.counters[c] += stats.counters[c].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+static size_t format(char *buf, size_t size)
+{
+    InstrSnapshot *snapshot = new InstrSnapshot;
+    instrSnapshot(*snapshot);
+
+    size_t used = 0;
+    for (int s = 0; s < STAGE_COUNT && used < size; ++s) {
+        const InstrHistogram &h = snapshot->stages[s];
+        used += (size_t)snprintf(buf + used, size - used,
+                                 "stage %-8s n=%llu p50=%lluns p99=%lluns p99.9=%lluns max=%lluns\n",
+                                 stageNames[s], (unsigned long long)h.total,
+                                 (unsigned long long)h.percentileNs(0.50), (unsigned long long)h.percentileNs(0.99),
+                                 (unsigned long long)h.percentileNs(0.999), (unsigned long long)h.maxNs);
+    }
+    for (int c = 0; c < COUNTER_COUNT && used < size; ++c) {
+        used += (size_t)snprintf(buf + used, size - used, "counter %s=%llu\n", counterNames[c],
+                                 (unsigned long long)snapshot->counters[c]);
+    }
+
+    delete snapshot;
+    return MIN(used, size - 1);
+}
+
+int instrDump(FILE *out)
+{
+    char buf[2048];
+    size_t n = format(buf, sizeof(buf));
+    return fwrite(buf, 1, n, out) == n ? RETURN_SUCCESS : RETURN_FAILURE;
+}
+
+int instrDumpFile(const char *path)
+{
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        return RETURN_FAILURE;
+    }
+    int rc = instrDump(out);
+    return fclose(out) == 0 ? rc : RETURN_FAILURE;
+}
+
+int instrDumpUdp(uint16_t port)
+{
+    char buf[2048];
+    size_t n = format(buf, sizeof(buf));
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return RETURN_FAILURE;
+    }
+    struct sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    to.sin_port = htons(port);
+    ssize_t sent = sendto(fd, buf, n, 0, (const struct sockaddr *)&to, sizeof(to));
+    close(fd);
+    return sent == (ssize_t)n ? RETURN_SUCCESS : RETURN_FAILURE;
+}
+
+const char *instrStageName(InstrStage stage)
+{
+    return stage < STAGE_COUNT ? stageNames[stage] : "?";
+}
+
+const char *instrCounterName(InstrCounter counter)
+{
+    return counter < COUNTER_COUNT ? counterNames[counter] : "?";
+}
@@ -0,0 +1,91 @@
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include "udpMsgPackDefs.h"
+
+/**
+ * Hot-path instrumentation: per-stage latency histograms and event counters.
+ *
+ * Every call site is wrapped in INSTRUMENT(), which by default expands to nothing, exactly like
+ * DEBUG() in sysDefs.h, so a normal build carries no instrumentation code at all. Build with
+ * -D'INSTRUMENT(x)=x' (CMake option UDPMSGPACK_INSTRUMENT) to compile it in:
+ *
+ *     INSTRUMENT(uint64_t t0 = instrNow());
+ *     sendto(...);
+ *     INSTRUMENT(instrStage(STAGE_SEND, t0));
+ *
+ * Each thread records into its own histograms (single writer, relaxed atomics, no locks and no
+ * allocation after the thread's first record), and instrSnapshot() merges all threads.
+ * Durations are taken from the TSC on x86-64 and from steady_clock elsewhere.
+ */
+#ifndef INSTRUMENT
+# define INSTRUMENT(x)
+#endif
+
+#define STATS_PORT  (20002)     /**< Default loopback port for instrDumpUdp() */
+
+typedef enum InstrStage
+{
+    STAGE_PACK = 0,             /**< msgpack::pack / NgpsCodec::encode */
+    STAGE_SEND,                 /**< sendto / sendmmsg */
+    STAGE_RECV,                 /**< recvfrom / recvmmsg */
+    STAGE_UNPACK,               /**< msgpack::unpack / unpacker::next */
+    STAGE_CONVERT,              /**< object::convert<ngps_output> */
+    STAGE_DECODE,               /**< NgpsCodec::decode (unpack and convert in one pass) */
+    STAGE_COUNT
+} InstrStage;
+
+typedef enum InstrCounter
+{
+    COUNTER_MESSAGES = 0,       /**< Records decoded */
+    COUNTER_DROPS,              /**< Datagrams lost (sequence gaps) or not sent */
+    COUNTER_DECODE_ERRORS,      /**< Datagrams or records that failed to decode */
+    COUNTER_TRUNCATED,          /**< Datagrams larger than the receive buffer (MSG_TRUNC) */
+    COUNTER_COUNT
+} InstrCounter;
+
+/* Log-linear bucketing shared by the recorder and the snapshot: 16 sub-buckets per power of two */
+#define INSTR_SUB_BITS  (4)
+#define INSTR_BUCKETS   (64 << INSTR_SUB_BITS)
+
+struct InstrHistogram
+{
+    uint64_t counts[INSTR_BUCKETS];
+    uint64_t total;
+    uint64_t maxNs;
+
+    /* Upper bound in ns of the bucket holding quantile q (0..1) */
+    uint64_t percentileNs(double q) const;
+};
+
+struct InstrSnapshot
+{
+    InstrHistogram stages[STAGE_COUNT];
+    uint64_t counters[COUNTER_COUNT];
+};
+
+/* Current timestamp in ticks (TSC or steady_clock ns) */
+uint64_t instrNow();
+
+/* Record the time since start (from instrNow()) for stage */
+void instrStage(InstrStage stage, uint64_t start);
+
+void instrCount(InstrCounter counter, uint64_t n = 1);
+
+/* Merge all threads into snapshot. Histogram values are converted to nanoseconds */
+void instrSnapshot(InstrSnapshot &snapshot);
+
+/* Write a text snapshot. Returns RETURN_SUCCESS or RETURN_FAILURE */
+int instrDump(FILE *out);
+int instrDumpFile(const char *path);
+
+/* Send a text snapshot as one datagram to 127.0.0.1:port */
+int instrDumpUdp(uint16_t port = STATS_PORT);
+
+const char *instrStageName(InstrStage stage);
+const char *instrCounterName(InstrCounter counter);
+
+#endif //INSTRUMENT_H
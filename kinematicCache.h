@@ -0,0 +1,231 @@
+#ifndef KINEMATICCACHE_H
+#define KINEMATICCACHE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#include <atomic>
+#include <new>
+#include <thread>
+#include "ngpsOutput.h"
+
+/**
+ * Per-edge motion state for answering "where is the train on edge e at time t" between reports.
+ *
+ * Each update() keeps the report's offset, speed, accel, direction of travel and the time it
+ * describes; estimate() extrapolates from it in constant time under constant acceleration
+ * (stopping at zero speed rather than reversing) and widens the reported uncertainty with age:
+ *
+ *     uncertainty(dt) = uncertainty + speedError * dt + accelError * dt^2 / 2
+ *
+ * Offsets increase in the direction of travel unless gd0 != reversing (see ngps_output), in which
+ * case they decrease. A report with pos_valid or speed_valid false invalidates the edge until the
+ * next valid one; a report older than the stored one is ignored. Extrapolated offsets are not
+ * clamped to the edge, whose length is not known here.
+ *
+ * Concurrency follows EdgeStateTable: one cache-line seqlock slot per edge, any number of writers
+ * (CAS from even to odd sequence), readers that never write shared memory and retry on change.
+ */
+
+typedef enum KinematicStatus
+{
+    KINEMATIC_OK = 0,           /**< Estimate written */
+    KINEMATIC_UNKNOWN,          /**< No report for this edge yet */
+    KINEMATIC_INVALID,          /**< Latest report had pos_valid or speed_valid false */
+    KINEMATIC_STALE             /**< Latest report is older than maxAgeNs at the query time */
+} KinematicStatus;
+
+struct KinematicConfig
+{
+    ULong speedErrorMmS = 100;          /* bound on the reported speed's error, mm/s */
+    ULong accelErrorMmS2 = 500;         /* bound on unreported acceleration change, mm/s/s */
+    uint64_t maxAgeNs = 5000000000ULL;  /* extrapolate at most this far past a report */
+};
+
+struct KinematicEstimate
+{
+    int64_t  offset;            /* mm from the start of the edge; may run past either end */
+    ULong    speed;             /* mm/s */
+    ULong    uncertainty;       /* mm */
+    SysBool  decreasing;        /* offset decreasing as the train moves */
+    uint64_t ageNs;             /* query time minus report time (0 for queries before the report) */
+};
+
+class KinematicCache
+{
+public:
+    enum { EDGE_COUNT = MAX_UNSIGNED_SHORT + 1 };
+
+    explicit KinematicCache(const KinematicConfig &config = KinematicConfig()) : config(config)
+    {
+        void *mem = aligned_alloc(CACHE_LINE, sizeof(Slot) * EDGE_COUNT);
+        if (mem == NULL) {
+            throw std::bad_alloc();
+        }
+        slots = static_cast<Slot *>(mem);
+        for (size_t i = 0; i < EDGE_COUNT; ++i) {
+            new (&slots[i]) Slot();
+        }
+    }
+
+    ~KinematicCache()
+    {
+        for (size_t i = 0; i < EDGE_COUNT; ++i) {
+            slots[i].~Slot();
+        }
+        free(slots);
+    }
+
+    KinematicCache(const KinematicCache &) = delete;
+    KinematicCache &operator=(const KinematicCache &) = delete;
+
+    /*
+     * Store msg as the state of its edge at timestampNs. Returns FALSE if a newer report is stored; an
+     * equal timestamp replaces, since UdpServer stamps a whole recvmmsg batch with one receive time
+     */
+    SysBool update(const ngps_output &msg, uint64_t timestampNs)
+    {
+        Slot &slot = slots[msg.edge_id];
+        uint64_t flags = FLAG_REPORTED;
+        if (msg.pos_valid && msg.speed_valid) {
+            flags |= FLAG_VALID;
+        }
+        if (msg.stationary) {
+            flags |= FLAG_STATIONARY;
+        }
+        if ((msg.gd0 ? 1 : 0) != (msg.reversing ? 1 : 0)) {
+            flags |= FLAG_DECREASING;
+        }
+
+        uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+        for (unsigned int spins = 0;; ++spins) {
+            if ((seq & 1) == 0 &&
+                slot.seq.compare_exchange_weak(seq, seq + 1, std::memory_order_relaxed)) {
+                break;
+            }
+            backoff(spins);
+            seq = slot.seq.load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+
+        SysBool stored = FALSE;
+        if (slot.flags.load(std::memory_order_relaxed) == 0 ||
+            timestampNs >= slot.timestampNs.load(std::memory_order_relaxed)) {
+            slot.timestampNs.store(timestampNs, std::memory_order_relaxed);
+            slot.offset.store((uint64_t)msg.offset, std::memory_order_relaxed);
+            slot.speed.store((uint64_t)msg.speed, std::memory_order_relaxed);
+            slot.uncertainty.store((uint64_t)msg.uncertainty, std::memory_order_relaxed);
+            slot.accel.store((int64_t)msg.accel, std::memory_order_relaxed);
+            slot.flags.store(flags, std::memory_order_relaxed);
+            stored = TRUE;
+        }
+        slot.seq.store(stored ? seq + 2 : seq, std::memory_order_release);
+        return stored;
+    }
+
+    /* Position of the train on edgeId at tNs, extrapolated from the latest report */
+    KinematicStatus estimate(UShort edgeId, uint64_t tNs, KinematicEstimate &out) const
+    {
+        State s;
+        snapshot(slots[edgeId], s);
+        if (!(s.flags & FLAG_REPORTED)) {
+            return KINEMATIC_UNKNOWN;
+        }
+        if (!(s.flags & FLAG_VALID)) {
+            return KINEMATIC_INVALID;
+        }
+        uint64_t age = tNs > s.timestampNs ? tNs - s.timestampNs : 0;
+        if (age > config.maxAgeNs) {
+            return KINEMATIC_STALE;
+        }
+
+        double dt = age * 1e-9;
+        double v0 = (double)s.speed;
+        double a = (double)s.accel;
+        double distance = 0;
+        double v = 0;
+        if (!(s.flags & FLAG_STATIONARY)) {
+            v = v0 + a * dt;
+            if (v >= 0) {
+                distance = (v0 + v) * 0.5 * dt;
+            }
+            else {
+                distance = v0 * v0 / (-2.0 * a);    /* stopped before t */
+                v = 0;
+            }
+        }
+        double spread = (double)config.speedErrorMmS * dt + (double)config.accelErrorMmS2 * dt * dt * 0.5;
+
+        out.decreasing = (s.flags & FLAG_DECREASING) ? TRUE : FALSE;
+        out.offset = (int64_t)s.offset + (int64_t)llround(out.decreasing ? -distance : distance);
+        out.speed = (ULong)llround(v);
+        out.uncertainty = (ULong)(s.uncertainty + (uint64_t)ceil(spread));
+        out.ageNs = age;
+        return KINEMATIC_OK;
+    }
+
+    /* Number of stored reports for edgeId */
+    unsigned long updates(UShort edgeId) const
+    {
+        return (unsigned long)(slots[edgeId].seq.load(std::memory_order_acquire) >> 1);
+    }
+
+private:
+    enum { CACHE_LINE = 64, SPIN_LIMIT = 64 };
+    enum { FLAG_REPORTED = 1, FLAG_VALID = 2, FLAG_STATIONARY = 4, FLAG_DECREASING = 8 };
+
+    struct State
+    {
+        uint64_t timestampNs;
+        uint64_t offset;
+        uint64_t speed;
+        uint64_t uncertainty;
+        int64_t  accel;
+        uint64_t flags;
+    };
+
+    struct alignas(CACHE_LINE) Slot
+    {
+        std::atomic<uint64_t> seq{0};
+        std::atomic<uint64_t> timestampNs{0};
+        std::atomic<uint64_t> offset{0};
+        std::atomic<uint64_t> speed{0};
+        std::atomic<uint64_t> uncertainty{0};
+        std::atomic<int64_t>  accel{0};
+        std::atomic<uint64_t> flags{0};
+    };
+
+    static void backoff(unsigned int spins)
+    {
+        if (spins >= SPIN_LIMIT) {
+            std::this_thread::yield();
+        }
+    }
+
+    static void snapshot(const Slot &slot, State &s)
+    {
+        uint64_t before;
+        uint64_t after = 0;
+        unsigned int spins = 0;
+        do {
+            backoff(spins++);
+            before = slot.seq.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+            s.timestampNs = slot.timestampNs.load(std::memory_order_relaxed);
+            s.offset = slot.offset.load(std::memory_order_relaxed);
+            s.speed = slot.speed.load(std::memory_order_relaxed);
+            s.uncertainty = slot.uncertainty.load(std::memory_order_relaxed);
+            s.accel = slot.accel.load(std::memory_order_relaxed);
+            s.flags = slot.flags.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = slot.seq.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+    }
+
+    KinematicConfig config;
+    Slot *slots;
+};
+
+#endif //KINEMATICCACHE_H
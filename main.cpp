@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <math.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
@@ -9,109 +10,20 @@
 #include <msgpack.hpp>
 #include <ostream>
 #include <iostream>
-#define REDUNDANCY_LEVEL 1
-#include "sysDefs.h"
-
-#define PORT    20001
-#define MAXLINE 1024
-
-
-struct ngps_output
-{
-    UShort  edge_id = 1;        /* Edge the reference position is on (zero if not localized) */
-    ULong   offset = 500;         /* Distance from start of the edge of reference position millimeters */
-    ULong   uncertainty = 2;    /* mm */
-    SysBool pos_valid = TRUE;
-    ULong   speed = 2000;          /* Speed of the train in mm/s */
-    SysBool speed_valid = TRUE;
-    SysBool gd0 = TRUE;            /* True if the reference position is on GD0 end */
-    SysBool reversing = FALSE;      /* gd0 ? offset decreasing : offset increasing */
-    SysBool stationary = FALSE;     /* True is train is stationary */
-    SShort  accel = 0;          /* mm/s/s */
-    UShort  sensorCnt = 1;
-
-    ngps_output() {}
-
-    ngps_output(UShort edgeId, ULong offset, ULong uncertainty, SysBool posValid, ULong speed, SysBool speedValid,
-                SysBool gd0, SysBool reversing, SysBool stationary, SShort accel, UShort sensorCnt) :
-                    edge_id(edgeId),
-                    offset(offset),
-                    uncertainty(uncertainty),
-                    pos_valid(posValid),
-                    speed(speed),
-                    speed_valid(speedValid),
-                    gd0(gd0),
-                    reversing(reversing),
-                    stationary(stationary),
-                    accel(accel),
-                    sensorCnt(sensorCnt) {}
-
-    friend std::ostream &operator<<(std::ostream &os, const ngps_output &output) {
-        os << "edge_id: " << output.edge_id << " offset: " << output.offset << " uncertainty: " << output.uncertainty
-           << " pos_valid: " << output.pos_valid << " speed: " << output.speed << " speed_valid: " << output.speed_valid
-           << " gd0: " << output.gd0 << " reversing: " << output.reversing << " stationary: " << output.stationary
-           << " accel: " << output.accel << " sensorCnt: " << output.sensorCnt;
-        return os;
-    }
-};
-
-namespace msgpack {
-    MSGPACK_API_VERSION_NAMESPACE(MSGPACK_DEFAULT_API_NS) {
-        namespace adaptor {
-
-            template<>
-            struct convert<ngps_output> {
-                msgpack::object const& operator()(msgpack::object const& o, ngps_output& v) const {
-                    if (o.type != msgpack::type::ARRAY) throw msgpack::type_error();
-                    if (o.via.array.size != 11) throw msgpack::type_error();
-                    v = ngps_output(
-                            o.via.array.ptr[0].as<UShort>(),
-                            o.via.array.ptr[1].as<ULong>(),
-                            o.via.array.ptr[2].as<ULong>(),
-                            (SysBool)o.via.array.ptr[3].as<bool>(),
-                            o.via.array.ptr[4].as<ULong>(),
-                            (SysBool)o.via.array.ptr[5].as<bool>(),
-                            (SysBool)o.via.array.ptr[6].as<bool>(),
-                            (SysBool)o.via.array.ptr[7].as<bool>(),
-                            (SysBool)o.via.array.ptr[8].as<bool>(),
-                            o.via.array.ptr[9].as<SShort>(),
-                            o.via.array.ptr[10].as<UShort>()
-                    );
-
-                    return o;
-                }
-            };
-//Template specialization for msgpacking ngps_output struct
-            template<>
-            struct pack<ngps_output>
-            {
-                template <typename Stream>
-                packer<Stream>& operator()(msgpack::packer<Stream>& o, ngps_output const& r) const
-                {
-                    o.pack_array(11);
-                    o.pack(r.edge_id);
-                    o.pack(r.offset);
-                    o.pack(r.uncertainty);
-                    o.pack(!!r.pos_valid); //using !! to convert from SysBool to bool
-                    o.pack(r.speed);
-                    o.pack(!!r.speed_valid);
-                    o.pack(!!r.gd0);
-                    o.pack(!!r.reversing);
-                    o.pack(!!r.stationary);
-                    o.pack(r.accel);
-                    o.pack(r.sensorCnt);
-                    return o;
-                }
-            };
-
-        } // namespace adaptor
-    } // MSGPACK_API_VERSION_NAMESPACE(MSGPACK_DEFAULT_API_NS)
-} // namespace msgpack
-
-int main() {
+#include <functional>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include "ngpsOutput.h"
+#include "captureLog.h"
+#include "udpServer.h"
+#include "eventLoop.h"
+#include "sendScheduler.h"
+#include "socketTuning.h"
+#include "instrument.h"
+
+static int runClient() {
     int sockfd;
-    char buffer[MAXLINE];
-    const char * hello = "Hello from client";
     struct sockaddr_in     servaddr;
 
     // Creating socket file descriptor
@@ -119,6 +31,10 @@ int main() {
         perror("socket creation failed");
         exit(EXIT_FAILURE);
     }
+    SocketTuning tuning;
+    tuning.timestamps = FALSE;
+    tuning.dropCounter = FALSE;
+    tuneSocket(sockfd, tuning);
 
     memset(&servaddr, 0, sizeof(servaddr));
 
@@ -127,36 +43,212 @@ int main() {
     servaddr.sin_port = htons(PORT);
     servaddr.sin_addr.s_addr = INADDR_ANY;
 
-    int n, len;
-    ngps_output ngps;
+    // Report at the cadence the train's motion calls for (sendIntervalNs); each reply is awaited
+    // asynchronously so a lost datagram costs one timeout instead of stalling the client
+    NgpsEventLoop loop;
+    loop.addSocket(sockfd, NgpsEventLoop::ReceiveHandler());
 
-    for (int i = 0; i < 10; ++i) {
+    // Only offset and speed change between reports: encode once, then patch those two fields
+    ngps_output ngps;
+    SendSchedulerConfig cadence;
+    NgpsPreparedMessage prepared;
+    prepared.prepare(ngps);
+    int i = 0;
+    int answered = 0;
+    std::function<void()> onAnswered = [&]() {
+        if (++answered == 10) {
+            loop.stop();
+        }
+    };
+    NgpsEventLoop::ReplyHandler onReply = [&](NgpsRequestStatus status, const ngps_output &rt) {
+        if (status == NGPS_REQUEST_OK) {
+            std::cout << rt << std::endl;
+        }
+        else {
+            printf("No reply within 1 s.\n");
+        }
+        onAnswered();
+    };
+    std::function<void()> sendNext = [&]() {
+        if (i == 10) {
+            return;
+        }
         ngps.offset += i * 100;
         ngps.speed += i * 1000;
+        ++i;
+
+        int status;
+        if (prepared.set<DIRECT_FIELD(ngps_output, offset)>(ngps.offset) &&
+            prepared.set<DIRECT_FIELD(ngps_output, speed)>(ngps.speed)) {
+            status = loop.request(sockfd, servaddr, prepared.data(), prepared.size(), std::chrono::seconds(1), onReply);
+        }
+        else {
+            status = loop.request(sockfd, servaddr, ngps, std::chrono::seconds(1), onReply);    /* beyond 32 bits */
+        }
+        if (status == RETURN_SUCCESS) {
+            printf("Hello message sent.\n");
+        }
+        else {
+            printf("Send failed.\n");
+            onAnswered();   /* no reply will come for it */
+        }
+        loop.addTimer(std::chrono::microseconds(sendIntervalNs(cadence, ngps) / 1000), sendNext);
+    };
+
+    sendNext();
+    loop.run();
+    INSTRUMENT(instrDump(stdout));
+
+    close(sockfd);
+    return 0;
+}
 
-        msgpack::sbuffer sbuf;
-        msgpack::pack(sbuf, ngps);
+static volatile sig_atomic_t serverStopped = 0;
 
-        sendto(sockfd, sbuf.data(), sbuf.size(),
-               MSG_CONFIRM, (const struct sockaddr *) &servaddr,
-               sizeof(servaddr));
-        printf("Hello message sent.\n");
+static void onSignal(int) {
+    serverStopped = 1;
+}
 
-        n = recvfrom(sockfd, (char *)buffer, MAXLINE,
-                     MSG_WAITALL, (struct sockaddr *) &servaddr,
-                     (socklen_t*)&len);
-        msgpack::object_handle oh =
-                msgpack::unpack(buffer, n);
+// Receive side: one SO_REUSEPORT socket and pinned thread per worker, echoing back to clients
+static int runServer(unsigned int workers) {
+    EdgeStateTable table;
+    UdpServerConfig config;
+    config.workers = workers;
 
-        msgpack::object obj = oh.get();
+    UdpServer server(config, table);
+    if (server.start() != RETURN_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+    printf("Listening on port %u with %u workers.\n", server.port(), workers);
 
-        ngps_output rt;
-        obj.convert(rt);
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
 
-        std::cout << rt << std::endl;
+    unsigned long last = 0;
+    while (!serverStopped) {
         sleep(1);
+        unsigned long decoded = server.decoded();
+        printf("decoded: %lu (%lu/s) errors: %lu\n", decoded, decoded - last, server.decodeErrors());
+        last = decoded;
+        INSTRUMENT(instrDumpUdp(STATS_PORT));
     }
 
-    close(sockfd);
+    server.stop();
+    INSTRUMENT(instrDumpFile("udpMsgPack.stats"));
     return 0;
-}
\ No newline at end of file
+}
+
+// Record every datagram arriving on PORT, with its arrival time and source, until SIGINT/SIGTERM
+static int runCapture(const char *path) {
+    int sockfd;
+    struct sockaddr_in servaddr;
+
+    if ( (sockfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0 ) {
+        perror("socket creation failed");
+        return EXIT_FAILURE;
+    }
+    memset(&servaddr, 0, sizeof(servaddr));
+    servaddr.sin_family = AF_INET;
+    servaddr.sin_addr.s_addr = INADDR_ANY;
+    servaddr.sin_port = htons(PORT);
+    if (bind(sockfd, (const struct sockaddr *)&servaddr, sizeof(servaddr)) < 0) {
+        perror("bind failed");
+        close(sockfd);
+        return EXIT_FAILURE;
+    }
+
+    CaptureWriter capture;
+    if (capture.open(path) != RETURN_SUCCESS) {
+        perror("capture open failed");
+        close(sockfd);
+        return EXIT_FAILURE;
+    }
+    printf("Capturing port %u to %s.\n", PORT, path);
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    char buffer[MAXLINE];
+    struct pollfd pfd;
+    pfd.fd = sockfd;
+    pfd.events = POLLIN;
+    while (!serverStopped) {
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+        struct sockaddr_in from;
+        socklen_t len = sizeof(from);
+        ssize_t n = recvfrom(sockfd, buffer, MAXLINE, 0, (struct sockaddr *)&from, &len);
+        if (n < 0) {
+            continue;
+        }
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        if (capture.append((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec, from, buffer,
+                           (size_t)n) != RETURN_SUCCESS) {
+            perror("capture append failed");
+            break;
+        }
+    }
+
+    printf("Captured %lu datagrams.\n", capture.records());
+    close(sockfd);
+    return capture.close() == RETURN_SUCCESS ? 0 : EXIT_FAILURE;
+}
+
+// Send a capture to PORT on localhost; speed is a multiple of real time, "max" sends back to back
+static int runReplay(const char *path, const char *speed) {
+    ReplayConfig config;
+    config.speed = 1.0;
+    if (speed != NULL && strcmp(speed, "max") == 0) {
+        config.speed = 0.0;
+    }
+    else if (speed != NULL) {
+        char *end;
+        config.speed = strtod(speed, &end);
+        if (end == speed || *end != '\0' || !(config.speed > 0) || !isfinite(config.speed)) {
+            fprintf(stderr, "usage: replay <capture> [speed | max]: speed must be a positive multiple of real time\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    CaptureReader reader;
+    if (reader.open(path) != RETURN_SUCCESS) {
+        fprintf(stderr, "%s: not a capture\n", path);
+        return EXIT_FAILURE;
+    }
+
+    int sockfd;
+    struct sockaddr_in servaddr;
+    if ( (sockfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0 ) {
+        perror("socket creation failed");
+        return EXIT_FAILURE;
+    }
+    memset(&servaddr, 0, sizeof(servaddr));
+    servaddr.sin_family = AF_INET;
+    servaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    servaddr.sin_port = htons(PORT);
+
+    ReplayStats stats;
+    int rc = replayCapture(reader, sockfd, servaddr, config, stats);
+    printf("Replayed %lu of %lu datagrams in %.3f s (errors %lu, max late %.1f us).\n", stats.sent, reader.size(),
+           stats.elapsedNs / 1e9, stats.errors, stats.maxLateNs / 1e3);
+
+    close(sockfd);
+    return rc == RETURN_SUCCESS ? 0 : EXIT_FAILURE;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 2 && strcmp(argv[1], "capture") == 0) {
+        return runCapture(argv[2]);
+    }
+    if (argc > 2 && strcmp(argv[1], "replay") == 0) {
+        return runReplay(argv[2], argc > 3 ? argv[3] : NULL);
+    }
+    if (argc > 1 && strcmp(argv[1], "server") == 0) {
+        unsigned int workers = argc > 2 ? (unsigned int)strtoul(argv[2], NULL, 10)
+                                        : (unsigned int)sysconf(_SC_NPROCESSORS_ONLN);
+        return runServer(workers > 0 ? workers : 1);
+    }
+    return runClient();
+}
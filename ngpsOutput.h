@@ -0,0 +1,108 @@
+#ifndef NGPSOUTPUT_H
+#define NGPSOUTPUT_H
+
+#include <ostream>
+#include <msgpack.hpp>
+#include "udpMsgPackDefs.h"
+#include "fixedBuffer.h"
+#include "directAdaptor.h"
+#include "preparedMessage.h"
+
+#define PORT    20001
+#define MAXLINE 1024
+
+/*
+ * Worst-case msgpack size of one ngps_output: array header (1), two UShort as uint16 (3 each),
+ * three ULong as uint64 (9 each, since ULong is 64-bit on LP64 hosts), five bools (1 each) and
+ * one SShort as int16 (3).
+ */
+#define NGPS_OUTPUT_MAX_PACKED_SIZE (1 + 2 * 3 + 3 * 9 + 5 * 1 + 3)
+
+/*
+ * Exact msgpack size of one ngps_output in the 32-bit wire profile (NgpsWire32Codec): array
+ * header (1), two UShort as uint16 (3 each), three ULong as uint32 (5 each), five bools (1 each)
+ * and one SShort as int16 (3), independent of the host's long size.
+ */
+#define NGPS_OUTPUT_WIRE32_SIZE     (1 + 2 * 3 + 3 * 5 + 5 * 1 + 3)
+
+
+struct ngps_output
+{
+    UShort  edge_id = 1;        /* Edge the reference position is on (zero if not localized) */
+    ULong   offset = 500;         /* Distance from start of the edge of reference position millimeters */
+    ULong   uncertainty = 2;    /* mm */
+    SysBool pos_valid = TRUE;
+    ULong   speed = 2000;          /* Speed of the train in mm/s */
+    SysBool speed_valid = TRUE;
+    SysBool gd0 = TRUE;            /* True if the reference position is on GD0 end */
+    SysBool reversing = FALSE;      /* gd0 ? offset decreasing : offset increasing */
+    SysBool stationary = FALSE;     /* True is train is stationary */
+    SShort  accel = 0;          /* mm/s/s */
+    UShort  sensorCnt = 1;
+
+    ngps_output() {}
+
+    ngps_output(UShort edgeId, ULong offset, ULong uncertainty, SysBool posValid, ULong speed, SysBool speedValid,
+                SysBool gd0, SysBool reversing, SysBool stationary, SShort accel, UShort sensorCnt) :
+                    edge_id(edgeId),
+                    offset(offset),
+                    uncertainty(uncertainty),
+                    pos_valid(posValid),
+                    speed(speed),
+                    speed_valid(speedValid),
+                    gd0(gd0),
+                    reversing(reversing),
+                    stationary(stationary),
+                    accel(accel),
+                    sensorCnt(sensorCnt) {}
+
+    bool operator==(const ngps_output &rhs) const {
+        return edge_id == rhs.edge_id && offset == rhs.offset && uncertainty == rhs.uncertainty &&
+               pos_valid == rhs.pos_valid && speed == rhs.speed && speed_valid == rhs.speed_valid &&
+               gd0 == rhs.gd0 && reversing == rhs.reversing && stationary == rhs.stationary &&
+               accel == rhs.accel && sensorCnt == rhs.sensorCnt;
+    }
+
+    bool operator!=(const ngps_output &rhs) const {
+        return !(rhs == *this);
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, const ngps_output &output) {
+        os << "edge_id: " << output.edge_id << " offset: " << output.offset << " uncertainty: " << output.uncertainty
+           << " pos_valid: " << output.pos_valid << " speed: " << output.speed << " speed_valid: " << output.speed_valid
+           << " gd0: " << output.gd0 << " reversing: " << output.reversing << " stationary: " << output.stationary
+           << " accel: " << output.accel << " sensorCnt: " << output.sensorCnt;
+        return os;
+    }
+};
+
+/* Wire order of the ngps_output fields */
+typedef DIRECT_FIELDS(ngps_output, edge_id, offset, uncertainty, pos_valid, speed, speed_valid, gd0, reversing,
+                      stationary, accel, sensorCnt) NgpsOutputFields;
+
+//Template specializations for msgpacking ngps_output struct, generated from NgpsOutputFields
+DIRECT_MSGPACK_ADAPTOR(ngps_output, NgpsOutputFields)
+
+/* Allocation-free pack target sized for exactly one ngps_output */
+typedef FixedBuffer<NGPS_OUTPUT_MAX_PACKED_SIZE> NgpsPackBuffer;
+
+/* Object-tree-free encoder/decoder producing the same bytes as pack<ngps_output> */
+typedef DirectCodec<ngps_output, NgpsOutputFields> NgpsCodec;
+
+/* Full-width integers: every record is NgpsFixedCodec::maxSize bytes with fields at fixed offsets */
+typedef DirectCodec<ngps_output, NgpsOutputFields, DirectFixedEncoding> NgpsFixedCodec;
+
+/*
+ * 32-bit wire profile: every record is NGPS_OUTPUT_WIRE32_SIZE bytes with ULong fields as uint32.
+ * encode() returns 0 for a record whose offset, uncertainty or speed exceeds 32 bits, and decode()
+ * rejects such values with DIRECT_CODEC_OUT_OF_RANGE. Any msgpack reader accepts the bytes.
+ */
+typedef DirectCodec<ngps_output, NgpsOutputFields, DirectWire32Encoding> NgpsWire32Codec;
+
+/* A 32-bit wire profile ngps_output encoded once and patched field by field between sends */
+typedef DirectPreparedMessage<ngps_output, NgpsOutputFields, DirectWire32Encoding> NgpsPreparedMessage;
+
+static_assert(NgpsCodec::maxSize == NGPS_OUTPUT_MAX_PACKED_SIZE, "NGPS_OUTPUT_MAX_PACKED_SIZE out of date");
+static_assert(NgpsWire32Codec::maxSize == NGPS_OUTPUT_WIRE32_SIZE, "NGPS_OUTPUT_WIRE32_SIZE out of date");
+
+#endif //NGPSOUTPUT_H
@@ -0,0 +1,54 @@
+#include "ngpsValidator.h"
+
+const char *const ngpsRejectNames[NGPS_REJECT_REASONS] = {"accepted", "truncated", "header", "count", "type",
+                                                          "range", "trailing", "edge", "limit"};
+
+static NgpsReject fromStatus(DirectCodecStatus status, uint8_t first)
+{
+    switch (status) {
+        case DIRECT_CODEC_OK:
+            return NGPS_ACCEPT;
+        case DIRECT_CODEC_TRUNCATED:
+            return NGPS_REJECT_TRUNCATED;
+        case DIRECT_CODEC_BAD_ARRAY:
+            return ((first & 0xf0) == 0x90 || first == 0xdc || first == 0xdd) ? NGPS_REJECT_COUNT
+                                                                               : NGPS_REJECT_HEADER;
+        case DIRECT_CODEC_BAD_TYPE:
+            return NGPS_REJECT_TYPE;
+        default:
+            return NGPS_REJECT_RANGE;
+    }
+}
+
+NgpsReject NgpsValidator::check(const char *data, size_t len, ngps_output *out)
+{
+    ngps_output scratch;
+    ngps_output &msg = out != NULL ? *out : scratch;
+    size_t consumed = 0;
+
+    NgpsReject reason = len == 0 ? NGPS_REJECT_TRUNCATED
+                                 : fromStatus(NgpsCodec::decode(data, len, msg, &consumed), (uint8_t)data[0]);
+    if (reason == NGPS_ACCEPT) {
+        if (consumed != len) {
+            reason = NGPS_REJECT_TRAILING;
+        }
+        else if (msg.pos_valid && msg.edge_id == 0) {
+            reason = NGPS_REJECT_EDGE;
+        }
+        else if (msg.offset > limits.maxOffset || msg.uncertainty > limits.maxUncertainty ||
+                 msg.speed > limits.maxSpeed || msg.sensorCnt > limits.maxSensorCnt) {
+            reason = NGPS_REJECT_LIMIT;
+        }
+    }
+    counts[reason].store(counts[reason].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return reason;
+}
+
+unsigned long NgpsValidator::rejected() const
+{
+    unsigned long total = 0;
+    for (int i = NGPS_REJECT_TRUNCATED; i < NGPS_REJECT_REASONS; ++i) {
+        total += counts[i].load(std::memory_order_relaxed);
+    }
+    return total;
+}
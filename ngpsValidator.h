@@ -0,0 +1,80 @@
+#ifndef NGPSVALIDATOR_H
+#define NGPSVALIDATOR_H
+
+#include <stddef.h>
+#include <atomic>
+#include "ngpsOutput.h"
+
+/**
+ * Fast reject of untrusted ngps_output datagrams before they reach msgpack::unpack /
+ * convert<ngps_output>, which throw on malformed input, or the application.
+ *
+ * check() makes one pass over the datagram with NgpsCodec: the array header, the element count
+ * (compared before any element is read, so a huge declared count costs nothing), then each
+ * field's msgpack type and integer range, stopping at the first problem. It then rejects trailing
+ * bytes and applies the semantic limits in NgpsLimits. At most 11 elements are read, whatever the
+ * input. Nothing throws or allocates. Every reject is counted by reason.
+ *
+ * One validator per receiving thread: counters are updated without atomic read-modify-write, and
+ * may be read from any thread.
+ */
+
+typedef enum NgpsReject
+{
+    NGPS_ACCEPT = 0,                /**< Well-formed record within limits */
+    NGPS_REJECT_TRUNCATED,          /**< Empty, or ends before the record is complete */
+    NGPS_REJECT_HEADER,             /**< First byte is not a msgpack array header */
+    NGPS_REJECT_COUNT,              /**< Array element count is not the ngps_output field count */
+    NGPS_REJECT_TYPE,               /**< Element with a msgpack type its field cannot hold */
+    NGPS_REJECT_RANGE,              /**< Integer element that does not fit its field type */
+    NGPS_REJECT_TRAILING,           /**< Bytes after the record */
+    NGPS_REJECT_EDGE,               /**< pos_valid with edge_id 0 (not localized) */
+    NGPS_REJECT_LIMIT,              /**< Field beyond NgpsLimits */
+    NGPS_REJECT_REASONS
+} NgpsReject;
+
+extern const char *const ngpsRejectNames[NGPS_REJECT_REASONS];
+
+/*
+ * Plausibility bounds. The defaults take the whole ULong range, because the default wire
+ * (pack<ngps_output>, NgpsCodec) carries ULong fields as uint64 when they need it and a receiver
+ * must accept what its own sender emits. wire32() bounds them to the 32-bit wire profile
+ * (NgpsWire32Codec), for receivers whose senders are all 32-bit.
+ */
+struct NgpsLimits
+{
+    ULong  maxOffset = (ULong)-1;           /* mm */
+    ULong  maxUncertainty = (ULong)-1;      /* mm */
+    ULong  maxSpeed = (ULong)-1;            /* mm/s */
+    UShort maxSensorCnt = MAX_UNSIGNED_SHORT;
+
+    static NgpsLimits wire32()
+    {
+        NgpsLimits limits;
+        limits.maxOffset = MAX_UNSIGNED_LONG;
+        limits.maxUncertainty = MAX_UNSIGNED_LONG;
+        limits.maxSpeed = MAX_UNSIGNED_LONG;
+        return limits;
+    }
+};
+
+class NgpsValidator
+{
+public:
+    explicit NgpsValidator(const NgpsLimits &limits = NgpsLimits()) : limits(limits) {}
+
+    void setLimits(const NgpsLimits &l) { limits = l; }
+
+    /* Validate one datagram and, if out is not NULL, decode it there (valid only on NGPS_ACCEPT) */
+    NgpsReject check(const char *data, size_t len, ngps_output *out = NULL);
+
+    /* Datagrams rejected for reason (NGPS_ACCEPT: accepted), since construction */
+    unsigned long count(NgpsReject reason) const { return counts[reason].load(std::memory_order_relaxed); }
+    unsigned long rejected() const;
+
+private:
+    NgpsLimits limits;
+    std::atomic<unsigned long> counts[NGPS_REJECT_REASONS] = {};
+};
+
+#endif //NGPSVALIDATOR_H
@@ -0,0 +1,381 @@
+#ifndef POSITIONINDEX_H
+#define POSITIONINDEX_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+#include <thread>
+#include <vector>
+#include "ngpsOutput.h"
+
+/**
+ * Live train positions indexed per edge, for "which trains are within X mm of offset O on edge E"
+ * and "nearest train ahead of O on edge E".
+ *
+ * ngps_output carries no train identity, so the caller keys each report by a TrainId of its own
+ * (e.g. NgpsEnvelope::senderId, or the index of the sending socket address). Each edge holds a
+ * flat array of up to perEdgeCapacity entries sorted by offset: update() finds the position by
+ * binary search and shifts the few entries after it, and a train moving to another edge is
+ * inserted there before it is removed from the old one. A report with pos_valid false removes the
+ * train until its next valid report.
+ *
+ * Every entry is an interval [offset - uncertainty, offset + uncertainty]. The edge also keeps the
+ * largest uncertainty among its entries, so a range query binary-searches offsets widened by it
+ * and then tests each candidate's own interval.
+ *
+ * Concurrency follows EdgeStateTable: one seqlock per edge (CAS from even to odd sequence),
+ * entries stored as relaxed atomic words, readers that never write shared memory and retry on
+ * change. Any number of writer threads may update the index, but each train must be updated by
+ * one thread at a time (its reports come from one sender, as SO_REUSEPORT hashing ensures).
+ */
+
+typedef UShort TrainId;
+
+struct PositionIndexConfig
+{
+    unsigned int perEdgeCapacity = 16;      /* trains indexed on one edge at a time */
+};
+
+struct PositionHit
+{
+    TrainId  train;
+    int64_t  offset;            /* mm from the start of the edge */
+    ULong    uncertainty;       /* mm */
+    SysBool  decreasing;        /* offset decreasing as the train moves (gd0 != reversing) */
+    int64_t  clearance;         /* nearestAhead(): gap from the query offset to the near end of the train's interval; <= 0 if they overlap */
+};
+
+class PositionIndex
+{
+public:
+    enum { EDGE_COUNT = MAX_UNSIGNED_SHORT + 1, TRAIN_COUNT = MAX_UNSIGNED_SHORT + 1, NO_TRAIN = TRAIN_COUNT };
+
+    explicit PositionIndex(const PositionIndexConfig &config = PositionIndexConfig()) :
+            capacity(MAX(config.perEdgeCapacity, 1u)),
+            trains(TRAIN_COUNT)
+    {
+        void *mem = aligned_alloc(CACHE_LINE, sizeof(Slot) * EDGE_COUNT);
+        void *words = aligned_alloc(CACHE_LINE, sizeof(Entry) * EDGE_COUNT * capacity);
+        if (mem == NULL || words == NULL) {
+            free(mem);
+            free(words);
+            throw std::bad_alloc();
+        }
+        slots = static_cast<Slot *>(mem);
+        entries = static_cast<Entry *>(words);
+        for (size_t i = 0; i < EDGE_COUNT; ++i) {
+            new (&slots[i]) Slot();
+        }
+        for (size_t i = 0; i < (size_t)EDGE_COUNT * capacity; ++i) {
+            new (&entries[i]) Entry();
+        }
+    }
+
+    ~PositionIndex()
+    {
+        for (size_t i = 0; i < (size_t)EDGE_COUNT * capacity; ++i) {
+            entries[i].~Entry();
+        }
+        for (size_t i = 0; i < EDGE_COUNT; ++i) {
+            slots[i].~Slot();
+        }
+        free(entries);
+        free(slots);
+    }
+
+    PositionIndex(const PositionIndex &) = delete;
+    PositionIndex &operator=(const PositionIndex &) = delete;
+
+    /* Index msg as the position of train. Returns FALSE if the train is not indexed afterwards (invalid report, edge full) */
+    SysBool update(TrainId train, const ngps_output &msg)
+    {
+        Train &t = trains[train];
+        if (!msg.pos_valid) {
+            if (t.indexed) {
+                erase(t.edge, train);
+                t.indexed = FALSE;
+            }
+            return FALSE;
+        }
+
+        uint64_t packed = pack(train, msg);
+        if (t.indexed && t.edge == msg.edge_id) {
+            t.indexed = insert(msg.edge_id, (uint64_t)msg.offset, packed, TRUE);    /* move in place */
+            return t.indexed;
+        }
+        SysBool inserted = insert(msg.edge_id, (uint64_t)msg.offset, packed, FALSE);
+        if (t.indexed) {
+            erase(t.edge, train);
+        }
+        t.edge = msg.edge_id;
+        t.indexed = inserted;
+        return inserted;
+    }
+
+    /* Drop train from the index */
+    void remove(TrainId train)
+    {
+        Train &t = trains[train];
+        if (t.indexed) {
+            erase(t.edge, train);
+            t.indexed = FALSE;
+        }
+    }
+
+    /**
+     * Trains on edgeId whose interval comes within distance of offset, in increasing offset order.
+     * Writes at most max hits (clearance 0) and returns the number of trains that matched.
+     */
+    size_t within(UShort edgeId, uint64_t offset, uint64_t distance, PositionHit *out, size_t max) const
+    {
+        const Slot &slot = slots[edgeId];
+        const Entry *edge = &entries[(size_t)edgeId * capacity];
+        size_t matched;
+        for (unsigned int spins = 0;; ++spins) {
+            backoff(spins);
+            uint64_t before = slot.seq.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+            uint32_t count = MIN(slot.count.load(std::memory_order_relaxed), (uint32_t)capacity);
+            uint64_t widen = distance + slot.maxUncertainty.load(std::memory_order_relaxed);
+            uint64_t low = offset > widen ? offset - widen : 0;
+            uint64_t high = offset + widen;
+
+            matched = 0;
+            for (size_t i = lowerBound(edge, count, low); i < count; ++i) {
+                uint64_t at = edge[i].offset.load(std::memory_order_relaxed);
+                if (at > high) {
+                    break;
+                }
+                uint64_t packed = edge[i].packed.load(std::memory_order_relaxed);
+                uint64_t reach = distance + uncertaintyOf(packed);
+                if ((at > offset ? at - offset : offset - at) <= reach) {
+                    if (matched < max) {
+                        hit(at, packed, 0, out[matched]);
+                    }
+                    ++matched;
+                }
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) == before) {
+                return matched;
+            }
+        }
+    }
+
+    /**
+     * Nearest train other than self on edgeId strictly ahead of offset: the next larger offset, or
+     * the next smaller one if decreasing. Returns FALSE if there is none.
+     */
+    SysBool nearestAhead(UShort edgeId, uint64_t offset, SysBool decreasing, PositionHit &out,
+                         unsigned int self = NO_TRAIN) const
+    {
+        const Slot &slot = slots[edgeId];
+        const Entry *edge = &entries[(size_t)edgeId * capacity];
+        for (unsigned int spins = 0;; ++spins) {
+            backoff(spins);
+            uint64_t before = slot.seq.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+            uint32_t count = MIN(slot.count.load(std::memory_order_relaxed), (uint32_t)capacity);
+            SysBool found = FALSE;
+            if (!decreasing) {
+                for (size_t i = lowerBound(edge, count, offset + 1); i < count && !found; ++i) {
+                    found = candidate(edge[i], offset, self, out);
+                }
+            }
+            else {
+                for (size_t i = lowerBound(edge, count, offset); i > 0 && !found; --i) {
+                    found = candidate(edge[i - 1], offset, self, out);
+                }
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) == before) {
+                return found;
+            }
+        }
+    }
+
+    /* Trains indexed on edgeId */
+    size_t count(UShort edgeId) const { return slots[edgeId].count.load(std::memory_order_relaxed); }
+
+    /* Valid reports that could not be indexed because their edge was full */
+    unsigned long overflows() const { return overflowed.load(std::memory_order_relaxed); }
+
+private:
+    enum { CACHE_LINE = 64, SPIN_LIMIT = 64 };
+
+    /* packed: uncertainty (32 bits, saturated) | train << 32 | decreasing << 48 */
+    struct Entry
+    {
+        std::atomic<uint64_t> offset{0};
+        std::atomic<uint64_t> packed{0};
+    };
+
+    struct alignas(CACHE_LINE) Slot
+    {
+        std::atomic<uint64_t> seq{0};
+        std::atomic<uint32_t> count{0};
+        std::atomic<uint64_t> maxUncertainty{0};
+    };
+
+    struct Train
+    {
+        UShort edge = 0;
+        SysBool indexed = FALSE;
+    };
+
+    static uint64_t pack(TrainId train, const ngps_output &msg)
+    {
+        uint64_t uncertainty = MIN((uint64_t)msg.uncertainty, (uint64_t)0xffffffffu);
+        uint64_t decreasing = (msg.gd0 ? 1 : 0) != (msg.reversing ? 1 : 0) ? 1 : 0;
+        return uncertainty | (uint64_t)train << 32 | decreasing << 48;
+    }
+
+    static uint64_t uncertaintyOf(uint64_t packed) { return packed & 0xffffffffu; }
+    static TrainId trainOf(uint64_t packed) { return (TrainId)(packed >> 32); }
+
+    static void hit(uint64_t offset, uint64_t packed, int64_t clearance, PositionHit &out)
+    {
+        out.train = trainOf(packed);
+        out.offset = (int64_t)offset;
+        out.uncertainty = (ULong)uncertaintyOf(packed);
+        out.decreasing = (packed >> 48) & 1 ? TRUE : FALSE;
+        out.clearance = clearance;
+    }
+
+    static SysBool candidate(const Entry &e, uint64_t offset, unsigned int self, PositionHit &out)
+    {
+        uint64_t packed = e.packed.load(std::memory_order_relaxed);
+        if (trainOf(packed) == self) {
+            return FALSE;
+        }
+        uint64_t at = e.offset.load(std::memory_order_relaxed);
+        int64_t gap = at > offset ? (int64_t)(at - offset) : (int64_t)(offset - at);
+        hit(at, packed, gap - (int64_t)uncertaintyOf(packed), out);
+        return TRUE;
+    }
+
+    /* First of the count sorted entries with offset >= value */
+    static size_t lowerBound(const Entry *edge, size_t count, uint64_t value)
+    {
+        size_t lo = 0;
+        size_t hi = count;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (edge[mid].offset.load(std::memory_order_relaxed) < value) {
+                lo = mid + 1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    static void backoff(unsigned int spins)
+    {
+        if (spins >= SPIN_LIMIT) {
+            std::this_thread::yield();
+        }
+    }
+
+    uint64_t lock(Slot &slot)
+    {
+        uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+        for (unsigned int spins = 0;; ++spins) {
+            if ((seq & 1) == 0 &&
+                slot.seq.compare_exchange_weak(seq, seq + 1, std::memory_order_relaxed)) {
+                break;
+            }
+            backoff(spins);
+            seq = slot.seq.load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        return seq;
+    }
+
+    /* Recompute the widest interval after a change (the writer holds the slot) */
+    static void refreshMaxUncertainty(Slot &slot, const Entry *edge, uint32_t count)
+    {
+        uint64_t widest = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            widest = MAX(widest, uncertaintyOf(edge[i].packed.load(std::memory_order_relaxed)));
+        }
+        slot.maxUncertainty.store(widest, std::memory_order_relaxed);
+    }
+
+    /* Remove entry i of count (the writer holds the slot) */
+    static void removeAt(Entry *edge, uint32_t count, uint32_t i)
+    {
+        for (uint32_t k = i + 1; k < count; ++k) {
+            edge[k - 1].offset.store(edge[k].offset.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            edge[k - 1].packed.store(edge[k].packed.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+    }
+
+    static int find(const Entry *edge, uint32_t count, TrainId train)
+    {
+        for (uint32_t i = 0; i < count; ++i) {
+            if (trainOf(edge[i].packed.load(std::memory_order_relaxed)) == train) {
+                return (int)i;
+            }
+        }
+        return -1;
+    }
+
+    /* Insert an entry; with replace, the train's current entry on this edge goes in the same critical section */
+    SysBool insert(UShort edgeId, uint64_t offset, uint64_t packed, SysBool replace)
+    {
+        Slot &slot = slots[edgeId];
+        Entry *edge = &entries[(size_t)edgeId * capacity];
+        uint64_t seq = lock(slot);
+        uint32_t count = slot.count.load(std::memory_order_relaxed);
+        int old = replace ? find(edge, count, trainOf(packed)) : -1;
+        if (old >= 0) {
+            removeAt(edge, count--, (uint32_t)old);
+        }
+        if (count == capacity) {
+            slot.seq.store(seq, std::memory_order_release);
+            overflowed.fetch_add(1, std::memory_order_relaxed);
+            return FALSE;
+        }
+        size_t at = lowerBound(edge, count, offset);
+        for (size_t i = count; i > at; --i) {
+            edge[i].offset.store(edge[i - 1].offset.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            edge[i].packed.store(edge[i - 1].packed.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        edge[at].offset.store(offset, std::memory_order_relaxed);
+        edge[at].packed.store(packed, std::memory_order_relaxed);
+        slot.count.store(count + 1, std::memory_order_relaxed);
+        refreshMaxUncertainty(slot, edge, count + 1);
+        slot.seq.store(seq + 2, std::memory_order_release);
+        return TRUE;
+    }
+
+    void erase(UShort edgeId, TrainId train)
+    {
+        Slot &slot = slots[edgeId];
+        Entry *edge = &entries[(size_t)edgeId * capacity];
+        uint64_t seq = lock(slot);
+        uint32_t count = slot.count.load(std::memory_order_relaxed);
+        int i = find(edge, count, train);
+        if (i >= 0) {
+            removeAt(edge, count, (uint32_t)i);
+            slot.count.store(count - 1, std::memory_order_relaxed);
+            refreshMaxUncertainty(slot, edge, count - 1);
+        }
+        slot.seq.store(seq + 2, std::memory_order_release);
+    }
+
+    size_t capacity;
+    Slot *slots;
+    Entry *entries;
+    std::vector<Train> trains;          /* written only by the thread updating that train */
+    std::atomic<unsigned long> overflowed{0};
+};
+
+#endif //POSITIONINDEX_H
@@ -0,0 +1,63 @@
+#ifndef PREPAREDMESSAGE_H
+#define PREPAREDMESSAGE_H
+
+#include "directCodec.h"
+
+/**
+ * An encoded record kept ready to send, for periodic messages where only a few fields change
+ * between cycles. prepare() encodes the whole struct once under a fixed-width encoding, where
+ * every field has a constant offset known at compile time; set<Field>() then overwrites just that
+ * field's bytes (a tag byte and one big-endian store), and data()/size() go to the kernel as they
+ * are. The buffer is always a complete, valid record.
+ *
+ *     DirectPreparedMessage<ngps_output, NgpsOutputFields> msg;
+ *     msg.prepare(ngps);
+ *     msg.set<DIRECT_FIELD(ngps_output, offset)>(ngps.offset);
+ *     sendto(fd, msg.data(), msg.size(), ...);
+ */
+template <typename Struct, typename Fields, typename Encoding = DirectWire32Encoding>
+class DirectPreparedMessage
+{
+    static_assert(Encoding::fixedWidth, "in-place patching needs a fixed-width encoding");
+
+public:
+    typedef DirectCodec<Struct, Fields, Encoding> codec;
+
+    enum { messageSize = codec::maxSize };
+
+    DirectPreparedMessage() : prepared(FALSE) {}
+
+    /* Encode s as the template. Returns RETURN_FAILURE if a field does not fit the encoding */
+    int prepare(const Struct &s)
+    {
+        prepared = codec::encode(s, bytes, sizeof(bytes)) == (size_t)messageSize ? TRUE : FALSE;
+        return prepared ? RETURN_SUCCESS : RETURN_FAILURE;
+    }
+
+    /* Overwrite one field. FALSE (message unchanged) if not prepared or v does not fit the encoding */
+    template <typename Field>
+    SysBool set(const typename Field::member_type &v)
+    {
+        static_assert(Fields::template contains<Field>(), "field is not in the field list");
+        typedef typename Encoding::template traits<typename Field::member_type>::type traits;
+        if (!prepared || !traits::inRange(v)) {
+            return FALSE;
+        }
+        traits::encode(bytes + offsetOf<Field>(), v);
+        return TRUE;
+    }
+
+    /* Byte offset of Field in data() */
+    template <typename Field>
+    static constexpr size_t offsetOf() { return 1 + Fields::template offsetOf<Encoding, Field>(); }
+
+    SysBool valid() const { return prepared; }
+    const char *data() const { return bytes; }
+    size_t size() const { return prepared ? (size_t)messageSize : 0; }
+
+private:
+    char bytes[messageSize];
+    SysBool prepared;
+};
+
+#endif //PREPAREDMESSAGE_H
@@ -0,0 +1,205 @@
+#include "replicaVoter.h"
+
+static_assert((VOTE_WINDOW & (VOTE_WINDOW - 1)) == 0, "VOTE_WINDOW must be a power of two");
+
+unsigned int ngpsFieldDiff(const ngps_output &a, const ngps_output &b)
+{
+    unsigned int fields = 0;
+    fields |= (a.edge_id != b.edge_id) ? 1u << VOTE_EDGE_ID : 0;
+    fields |= (a.offset != b.offset) ? 1u << VOTE_OFFSET : 0;
+    fields |= (a.uncertainty != b.uncertainty) ? 1u << VOTE_UNCERTAINTY : 0;
+    fields |= (!a.pos_valid != !b.pos_valid) ? 1u << VOTE_POS_VALID : 0;
+    fields |= (a.speed != b.speed) ? 1u << VOTE_SPEED : 0;
+    fields |= (!a.speed_valid != !b.speed_valid) ? 1u << VOTE_SPEED_VALID : 0;
+    fields |= (!a.gd0 != !b.gd0) ? 1u << VOTE_GD0 : 0;
+    fields |= (!a.reversing != !b.reversing) ? 1u << VOTE_REVERSING : 0;
+    fields |= (!a.stationary != !b.stationary) ? 1u << VOTE_STATIONARY : 0;
+    fields |= (a.accel != b.accel) ? 1u << VOTE_ACCEL : 0;
+    fields |= (a.sensorCnt != b.sensorCnt) ? 1u << VOTE_SENSOR_CNT : 0;
+    return fields;
+}
+
+ReplicaVoter::ReplicaVoter(unsigned int replicas, ResultHandler onResult, std::chrono::microseconds voteTimeout) :
+        replicaCount(replicas == REDUNDANCY_LEVEL_2 ? REDUNDANCY_LEVEL_2 : REDUNDANCY_LEVEL_3),
+        allPresent((1u << replicaCount) - 1),
+        onResult(onResult),
+        voteTimeout(voteTimeout)
+{
+}
+
+void ReplicaVoter::publish(const Cycle &c, VoteOutcome outcome, const ngps_output &value, unsigned int dissent,
+                           Clock::time_point now)
+{
+    VoteResult result;
+    result.cycle = c.cycle;
+    result.outcome = outcome;
+    result.value = value;
+    result.present = c.present;
+    result.dissent = dissent;
+    result.fields = 0;
+    for (unsigned int i = 0; i < replicaCount; ++i) {
+        for (unsigned int j = i + 1; j < replicaCount; ++j) {
+            if ((c.present & (1u << i)) && (c.present & (1u << j))) {
+                result.fields |= ngpsFieldDiff(c.values[i], c.values[j]);
+            }
+        }
+    }
+    result.latency = std::chrono::duration_cast<std::chrono::nanoseconds>(now - c.first);
+
+    switch (outcome) {
+        case VOTE_AGREED:     ++counters.agreed;     break;
+        case VOTE_DISAGREED:  ++counters.disagreed;  break;
+        case VOTE_INCOMPLETE: ++counters.incomplete; break;
+        case VOTE_DISSENT:    ++counters.dissents;   break;
+    }
+    onResult(result);
+}
+
+void ReplicaVoter::decide(Cycle &c, SysBool final, Clock::time_point now)
+{
+    unsigned int present = 0;
+    int majority = -1;
+    for (unsigned int i = 0; i < replicaCount; ++i) {
+        if (!(c.present & (1u << i))) {
+            continue;
+        }
+        ++present;
+        for (unsigned int j = i + 1; j < replicaCount && majority < 0; ++j) {
+            if ((c.present & (1u << j)) && c.values[i] == c.values[j]) {
+                majority = (int)i;
+            }
+        }
+    }
+
+    // 2oo2 needs both replicas; 2oo3 needs any two that agree
+    SysBool complete = c.present == allPresent ? TRUE : FALSE;
+    if (majority >= 0 && (replicaCount == REDUNDANCY_LEVEL_3 || complete)) {
+        c.voted = c.values[majority];
+        c.decided = TRUE;
+        unsigned int dissent = 0;
+        for (unsigned int i = 0; i < replicaCount; ++i) {
+            if ((c.present & (1u << i)) && c.values[i] != c.voted) {
+                dissent |= 1u << i;
+                ++counters.outvoted[i];
+            }
+        }
+        publish(c, VOTE_AGREED, c.voted, dissent, now);
+    }
+    else if (complete || final) {
+        c.decided = TRUE;
+        if (present >= MIN_REDUNDANCY_LEVEL) {
+            publish(c, VOTE_DISAGREED, ngps_output(), c.present, now);
+        }
+        else {
+            publish(c, VOTE_INCOMPLETE, ngps_output(), 0, now);
+        }
+    }
+}
+
+void ReplicaVoter::close(Cycle &c, Clock::time_point now)
+{
+    if (!c.decided) {
+        decide(c, TRUE, now);
+    }
+    for (unsigned int i = 0; i < replicaCount; ++i) {
+        if (!(c.present & (1u << i))) {
+            ++counters.missing[i];
+        }
+    }
+    c.open = FALSE;
+}
+
+int ReplicaVoter::submit(ReplicaId replica, uint32_t cycle, const ngps_output &msg, Clock::time_point now)
+{
+    if (replica < REPLICA_1 || (unsigned int)(replica - REPLICA_1) >= replicaCount) {
+        return RETURN_FAILURE;
+    }
+    unsigned int index = (unsigned int)(replica - REPLICA_1);
+
+    if (started && (int32_t)(cycle - oldest) < -(int32_t)REORDER_RESYNC_DISTANCE) {
+        // Far behind: the replicas restarted. Close what the old run left and follow the new one
+        for (uint32_t k = oldest; (int32_t)(newest - k) >= 0; ++k) {
+            Cycle &c = ring[k % VOTE_WINDOW];
+            if (c.open && c.cycle == k) {
+                close(c, now);
+            }
+        }
+        started = FALSE;
+    }
+    if (!started) {
+        oldest = cycle;
+        newest = cycle - 1;
+        started = TRUE;
+    }
+
+    if ((int32_t)(cycle - oldest) < 0) {
+        ++counters.late;
+        expire(now);
+        return RETURN_SUCCESS;
+    }
+
+    if ((uint32_t)(cycle - oldest) >= VOTE_WINDOW) {
+        // The window has to move: whatever falls out of it is closed undecided-as-is
+        uint32_t floor = cycle - (VOTE_WINDOW - 1);
+        for (; (int32_t)(floor - oldest) > 0 && (int32_t)(newest - oldest) >= 0; ++oldest) {
+            Cycle &c = ring[oldest % VOTE_WINDOW];
+            if (c.open && c.cycle == oldest) {
+                close(c, now);
+            }
+        }
+        oldest = floor;
+        if ((int32_t)(newest - oldest) < 0) {
+            newest = oldest - 1;
+        }
+    }
+
+    // Open every cycle up to this one, so a cycle no replica delivered still times out in order
+    for (; (int32_t)(cycle - newest) > 0; ) {
+        ++newest;
+        Cycle &c = ring[newest % VOTE_WINDOW];
+        c.open = TRUE;
+        c.decided = FALSE;
+        c.cycle = newest;
+        c.present = 0;
+        c.first = now;
+    }
+
+    Cycle &c = ring[cycle % VOTE_WINDOW];
+    if (!c.open || (c.present & (1u << index))) {
+        ++counters.late;
+        expire(now);
+        return RETURN_SUCCESS;
+    }
+    c.values[index] = msg;
+    c.present |= 1u << index;
+
+    if (c.decided) {
+        if (c.voted != msg) {
+            ++counters.outvoted[index];
+            publish(c, VOTE_DISSENT, c.voted, 1u << index, now);
+        }
+    }
+    else {
+        decide(c, FALSE, now);
+    }
+    if (c.present == allPresent) {
+        close(c, now);
+    }
+
+    expire(now);
+    return RETURN_SUCCESS;
+}
+
+void ReplicaVoter::expire(Clock::time_point now)
+{
+    while (started && (int32_t)(newest - oldest) >= 0) {
+        Cycle &c = ring[oldest % VOTE_WINDOW];
+        if (c.open && c.cycle == oldest) {
+            if (now - c.first < voteTimeout) {
+                break;
+            }
+            close(c, now);
+        }
+        ++oldest;
+    }
+}
@@ -0,0 +1,134 @@
+#ifndef REPLICAVOTER_H
+#define REPLICAVOTER_H
+
+#include <stdint.h>
+#include <chrono>
+#include <functional>
+#include "ngpsOutput.h"
+#include "udpSequence.h"
+
+/**
+ * Receive-side voter for redundant ngps_output streams.
+ *
+ * Every replica computes the same record for the same cycle (the NgpsEnvelope seq when the
+ * replicas send sequenced envelopes with senderId = ReplicaId). Records are aligned by cycle in a
+ * ring of VOTE_WINDOW cycles and compared field by field:
+ *   2oo3 - published as soon as two replicas agree, without waiting for the third. The third is
+ *          still compared when it arrives and reported as a dissent if it differs.
+ *   2oo2 - published when both replicas have arrived and agree.
+ * A cycle that can not be decided within voteTimeout of its first record (a replica lags or is
+ * gone), or that falls out of the window, is published as VOTE_DISAGREED or VOTE_INCOMPLETE, so
+ * the decision latency is bounded by voteTimeout even when one replica stalls.
+ *
+ * Time only advances through submit() and expire(); call expire() from the receive loop when no
+ * records arrive. Not thread-safe.
+ */
+
+#define VOTE_WINDOW     (64)    /**< Cycles that can be open at once; must be a power of two */
+
+typedef enum VoteOutcome
+{
+    VOTE_AGREED = 0,            /**< A majority agreed; value holds the voted record */
+    VOTE_DISAGREED,             /**< Enough replicas arrived but no majority agreed */
+    VOTE_INCOMPLETE,            /**< Fewer than two replicas arrived in time */
+    VOTE_DISSENT                /**< A replica arriving after VOTE_AGREED differs from the voted record */
+} VoteOutcome;
+
+/* Bit i of VoteResult::fields is field i of pack<ngps_output> */
+typedef enum VoteField
+{
+    VOTE_EDGE_ID = 0,
+    VOTE_OFFSET,
+    VOTE_UNCERTAINTY,
+    VOTE_POS_VALID,
+    VOTE_SPEED,
+    VOTE_SPEED_VALID,
+    VOTE_GD0,
+    VOTE_REVERSING,
+    VOTE_STATIONARY,
+    VOTE_ACCEL,
+    VOTE_SENSOR_CNT,
+    VOTE_FIELD_COUNT
+} VoteField;
+
+#define REPLICA_BIT(r)  (1u << ((r) - REPLICA_1))
+
+struct VoteResult
+{
+    uint32_t     cycle;
+    VoteOutcome  outcome;
+    ngps_output  value;         /* voted record (VOTE_AGREED, VOTE_DISSENT) */
+    unsigned int present;       /* REPLICA_BIT of every replica that arrived so far */
+    unsigned int dissent;       /* REPLICA_BIT of replicas differing from value, or all present if no majority */
+    unsigned int fields;        /* VoteField bits that differ between any two present replicas */
+    std::chrono::nanoseconds latency;   /* first record of the cycle to this result */
+};
+
+struct VoteStats
+{
+    unsigned long agreed = 0;
+    unsigned long disagreed = 0;
+    unsigned long incomplete = 0;
+    unsigned long dissents = 0;
+    unsigned long late = 0;                         /* records for cycles already closed */
+    unsigned long missing[MAX_NUMBER_OF_REPLICAS] = {};    /* per replica: cycles closed without it */
+    unsigned long outvoted[MAX_NUMBER_OF_REPLICAS] = {};   /* per replica: disagreed with the vote */
+};
+
+/* VoteField bits of the fields in which a and b differ */
+unsigned int ngpsFieldDiff(const ngps_output &a, const ngps_output &b);
+
+class ReplicaVoter
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+    typedef std::function<void(const VoteResult &result)> ResultHandler;
+
+    /* replicas is REDUNDANCY_LEVEL_2 (2oo2) or REDUNDANCY_LEVEL_3 (2oo3) */
+    ReplicaVoter(unsigned int replicas, ResultHandler onResult,
+                 std::chrono::microseconds voteTimeout = std::chrono::microseconds(2000));
+
+    /* Add replica's record for cycle. Returns RETURN_FAILURE for a replica id out of range */
+    int submit(ReplicaId replica, uint32_t cycle, const ngps_output &msg, Clock::time_point now);
+
+    /* senderId carries the ReplicaId, seq the cycle */
+    int submit(const NgpsEnvelope &env, Clock::time_point now)
+    {
+        return submit((ReplicaId)env.senderId, env.seq, env.payload, now);
+    }
+
+    /* Close every cycle whose first record is older than voteTimeout */
+    void expire(Clock::time_point now);
+
+    unsigned int replicas() const { return replicaCount; }
+    const VoteStats &stats() const { return counters; }
+
+private:
+    struct Cycle
+    {
+        SysBool open = FALSE;
+        SysBool decided = FALSE;
+        uint32_t cycle = 0;
+        unsigned int present = 0;
+        Clock::time_point first;
+        ngps_output values[MAX_NUMBER_OF_REPLICAS];
+        ngps_output voted;
+    };
+
+    void decide(Cycle &c, SysBool final, Clock::time_point now);
+    void close(Cycle &c, Clock::time_point now);
+    void publish(const Cycle &c, VoteOutcome outcome, const ngps_output &value, unsigned int dissent,
+                 Clock::time_point now);
+
+    unsigned int replicaCount;
+    unsigned int allPresent;
+    ResultHandler onResult;
+    std::chrono::microseconds voteTimeout;
+    Cycle ring[VOTE_WINDOW];
+    SysBool started = FALSE;
+    uint32_t oldest = 0;            /* lowest cycle that may still be open */
+    uint32_t newest = 0;            /* highest cycle seen */
+    VoteStats counters;
+};
+
+#endif //REPLICAVOTER_H
@@ -0,0 +1,150 @@
+#include <stdlib.h>
+#include "sendScheduler.h"
+
+uint64_t sendIntervalNs(const SendSchedulerConfig &config, const ngps_output &s)
+{
+    if (s.stationary) {
+        return config.stationaryIntervalNs;
+    }
+    uint64_t speed = (uint64_t)s.speed + (uint64_t)abs((int)s.accel);
+    if (speed == 0) {
+        return config.maxIntervalNs;
+    }
+    uint64_t interval = (uint64_t)config.distanceStepMm * 1000000000ULL / speed;
+    return MIN(MAX(interval, config.minIntervalNs), config.maxIntervalNs);
+}
+
+SendScheduler::SendScheduler(const SendSchedulerConfig &config, DueHandler onDue, uint64_t startNs) :
+        config(config),
+        onDue(onDue),
+        startNs(startNs)
+{
+    uint64_t slots = 1;
+    while (slots < config.wheelSlots) {
+        slots <<= 1;
+    }
+    mask = slots - 1;
+    wheel.assign(slots, NIL);
+    if (this->config.tickNs == 0) {
+        this->config.tickNs = 1;
+    }
+}
+
+void SendScheduler::link(uint32_t id)
+{
+    Source &s = sources[id];
+    uint64_t tick = MAX(dueTickOf(s.dueNs), currentTick + 1);     /* already past: next run() */
+    s.slot = (uint32_t)(tick & mask);
+    uint32_t &head = wheel[s.slot];
+    s.prev = NIL;
+    s.next = head;
+    if (head != NIL) {
+        sources[head].prev = id;
+    }
+    head = id;
+}
+
+void SendScheduler::unlink(uint32_t id)
+{
+    Source &s = sources[id];
+    if (s.prev != NIL) {
+        sources[s.prev].next = s.next;
+    }
+    else {
+        wheel[s.slot] = s.next;
+    }
+    if (s.next != NIL) {
+        sources[s.next].prev = s.prev;
+    }
+    s.prev = NIL;
+    s.next = NIL;
+}
+
+SendSourceId SendScheduler::add(const ngps_output &state, uint64_t firstDueNs)
+{
+    uint32_t id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+    }
+    else {
+        id = (uint32_t)sources.size();
+        sources.push_back(Source());
+    }
+    Source &s = sources[id];
+    s.intervalNs = MAX(sendIntervalNs(config, state), (uint64_t)1);
+    s.dueNs = firstDueNs;
+    s.lastDueNs = 0;
+    s.live = TRUE;
+    link(id);
+    ++active;
+    return id;
+}
+
+void SendScheduler::update(SendSourceId id, const ngps_output &state)
+{
+    Source &s = sources[id];
+    if (!s.live) {
+        return;
+    }
+    s.intervalNs = MAX(sendIntervalNs(config, state), (uint64_t)1);
+    if (s.lastDueNs != 0 && s.lastDueNs + s.intervalNs < s.dueNs) {
+        unlink(id);
+        s.dueNs = s.lastDueNs + s.intervalNs;
+        link(id);
+    }
+}
+
+void SendScheduler::remove(SendSourceId id)
+{
+    Source &s = sources[id];
+    if (!s.live) {
+        return;
+    }
+    unlink(id);
+    s.live = FALSE;
+    freeIds.push_back(id);
+    --active;
+}
+
+size_t SendScheduler::run(uint64_t nowNs)
+{
+    uint64_t nowTick = tickOf(nowNs);
+    if (nowTick <= currentTick) {
+        return 0;
+    }
+
+    // After a stall longer than the wheel, one pass over every slot still finds all due sources
+    batch.clear();
+    uint64_t last = MIN(nowTick, currentTick + mask + 1);
+    for (uint64_t t = currentTick + 1; t <= last; ++t) {
+        uint32_t id = wheel[t & mask];
+        while (id != NIL) {
+            Source &s = sources[id];
+            uint32_t next = s.next;
+            if (dueTickOf(s.dueNs) <= nowTick) {       /* not a later lap */
+                unlink(id);
+                SendDue due;
+                due.id = id;
+                due.dueNs = s.dueNs;
+                batch.push_back(due);
+            }
+            id = next;
+        }
+    }
+    currentTick = nowTick;
+
+    for (size_t i = 0; i < batch.size(); ++i) {
+        Source &s = sources[batch[i].id];
+        s.lastDueNs = s.dueNs;
+        s.dueNs += s.intervalNs;
+        if (s.dueNs <= nowNs) {
+            s.dueNs += ((nowNs - s.dueNs) / s.intervalNs + 1) * s.intervalNs;     /* skip missed reports */
+        }
+        link(batch[i].id);
+    }
+    if (!batch.empty()) {
+        onDue(batch.data(), batch.size(), nowNs);
+    }
+    return batch.size();
+}
@@ -0,0 +1,101 @@
+#ifndef SENDSCHEDULER_H
+#define SENDSCHEDULER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <vector>
+#include "ngpsOutput.h"
+
+/**
+ * Per-source report cadence from the source's own motion, driven by a hashed timer wheel.
+ *
+ * sendIntervalNs() picks the interval that keeps the distance travelled between two reports near
+ * distanceStepMm at the speed expected a second from now (speed + |accel|), clamped to
+ * [minIntervalNs, maxIntervalNs]; stationary sources report every stationaryIntervalNs.
+ *
+ * SendScheduler keeps every source in one wheel slot per tick (intrusive lists, O(1) add, remove
+ * and reschedule). run(now) walks the ticks elapsed since the last call and hands every source
+ * that came due to the handler in a single batch, so one wakeup serves all of them (e.g. one
+ * sendmmsg). Sources are rescheduled from their due time, not from the time they ran, so rates do
+ * not drift; a source that fell more than an interval behind skips to the next one instead of
+ * bursting.
+ */
+
+struct SendSchedulerConfig
+{
+    uint64_t tickNs = 1000000;                  /* wheel resolution */
+    unsigned int wheelSlots = 8192;             /* rounded up to a power of two */
+    ULong distanceStepMm = 2000;                /* target distance between reports */
+    uint64_t minIntervalNs = 50000000;
+    uint64_t maxIntervalNs = 2000000000;
+    uint64_t stationaryIntervalNs = 5000000000ULL;
+};
+
+typedef uint32_t SendSourceId;
+
+struct SendDue
+{
+    SendSourceId id;
+    uint64_t dueNs;         /* when the source was due; the batch runs at or after this */
+};
+
+/* Report interval for a source in state s */
+uint64_t sendIntervalNs(const SendSchedulerConfig &config, const ngps_output &s);
+
+class SendScheduler
+{
+public:
+    typedef std::function<void(const SendDue *due, size_t count, uint64_t nowNs)> DueHandler;
+
+    SendScheduler(const SendSchedulerConfig &config, DueHandler onDue, uint64_t startNs);
+
+    /* Add a source whose first report is due at firstDueNs. Returns its id (ids are reused after remove) */
+    SendSourceId add(const ngps_output &state, uint64_t firstDueNs);
+
+    /* Re-derive the interval from a new state; brings the next report forward if it is now due sooner */
+    void update(SendSourceId id, const ngps_output &state);
+    void remove(SendSourceId id);
+
+    /* Run every source due up to nowNs in one handler call. Returns the number run */
+    size_t run(uint64_t nowNs);
+
+    /* Start of the next tick after the last run(); sleep until then between calls */
+    uint64_t nextTickNs() const { return startNs + (currentTick + 1) * config.tickNs; }
+
+    uint64_t intervalNs(SendSourceId id) const { return sources[id].intervalNs; }
+    size_t size() const { return active; }
+
+private:
+    enum { NIL = 0xffffffffu };
+
+    struct Source
+    {
+        uint64_t intervalNs = 0;
+        uint64_t dueNs = 0;
+        uint64_t lastDueNs = 0;     /* due time of the last run, 0 before the first */
+        uint32_t slot = 0;          /* wheel slot holding the source */
+        uint32_t prev = NIL;
+        uint32_t next = NIL;
+        SysBool live = FALSE;
+    };
+
+    /* Tick in progress at ns, and the first tick whose start is at or after ns (a source never runs early) */
+    uint64_t tickOf(uint64_t ns) const { return ns <= startNs ? 0 : (ns - startNs) / config.tickNs; }
+    uint64_t dueTickOf(uint64_t ns) const { return ns <= startNs ? 0 : (ns - startNs + config.tickNs - 1) / config.tickNs; }
+    void link(uint32_t id);
+    void unlink(uint32_t id);
+
+    SendSchedulerConfig config;
+    DueHandler onDue;
+    uint64_t startNs;
+    uint64_t currentTick = 0;       /* every slot up to and including this tick has run */
+    uint64_t mask;
+    std::vector<uint32_t> wheel;    /* head of each slot's list */
+    std::vector<Source> sources;
+    std::vector<uint32_t> freeIds;
+    std::vector<SendDue> batch;
+    size_t active = 0;
+};
+
+#endif //SENDSCHEDULER_H
@@ -0,0 +1,299 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "shmRing.h"
+#include "instrument.h"
+
+static uint64_t monotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+/* Shared (not FUTEX_PRIVATE_FLAG) futex calls: the word lives in memory mapped by several processes */
+static void futexWait(std::atomic<uint32_t> *word, uint32_t expected, uint64_t timeoutNs)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t)(timeoutNs / 1000000000ULL);
+    ts.tv_nsec = (long)(timeoutNs % 1000000000ULL);
+    syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT, expected, &ts, NULL, 0);
+}
+
+static void futexWakeAll(std::atomic<uint32_t> *word)
+{
+    syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static size_t ringBytes(uint32_t capacity)
+{
+    size_t headerSize = (sizeof(ShmRingHeader) + sizeof(ShmRingSlot) - 1) / sizeof(ShmRingSlot) * sizeof(ShmRingSlot);
+    return headerSize + (size_t)capacity * sizeof(ShmRingSlot);
+}
+
+static ShmRingSlot *ringSlots(ShmRingHeader *header)
+{
+    return (ShmRingSlot *)((char *)header + ringBytes(0));
+}
+
+int ShmRingSender::open(const char *ringName, const ShmRingConfig &config)
+{
+    close();
+    if (strlen(ringName) >= sizeof(name) || config.capacity == 0 || config.capacity > (1u << 24)) {
+        return RETURN_FAILURE;
+    }
+    uint32_t capacity = 1;
+    while (capacity < config.capacity) {
+        capacity <<= 1;
+    }
+
+    shm_unlink(ringName);       /* receivers of an old ring keep it until they close */
+    int fd = shm_open(ringName, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        return RETURN_FAILURE;
+    }
+    size_t size = ringBytes(capacity);
+    void *base = MAP_FAILED;
+    if (ftruncate(fd, (off_t)size) == 0) {
+        base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        shm_unlink(ringName);
+        return RETURN_FAILURE;
+    }
+
+    // ftruncate zero-filled the segment: every slot seq is 0 and head is 0. The magic goes in last
+    // so a receiver attaching meanwhile sees an incomplete header and fails
+    strcpy(name, ringName);
+    header = (ShmRingHeader *)base;
+    slots = ringSlots(header);
+    mapped = size;
+    mask = capacity - 1;
+    next = 0;
+    header->version = SHM_RING_VERSION;
+    header->capacity = capacity;
+    header->format = (uint32_t)config.format;
+    header->recordSize = sizeof(ngps_output);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(header->magic, SHM_RING_MAGIC, sizeof(header->magic));
+    return RETURN_SUCCESS;
+}
+
+void ShmRingSender::close()
+{
+    if (header != NULL) {
+        munmap(header, mapped);
+        shm_unlink(name);
+        header = NULL;
+        slots = NULL;
+    }
+    mapped = 0;
+    name[0] = '\0';
+}
+
+ShmRingSlot &ShmRingSender::claim()
+{
+    ShmRingSlot &slot = slots[next & mask];
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);    /* seq 0 is visible before any new payload byte */
+    return slot;
+}
+
+void ShmRingSender::publish(ShmRingSlot &slot)
+{
+    ++next;
+    slot.seq.store(next, std::memory_order_release);
+    header->head.store(next, std::memory_order_seq_cst);
+    // Pairs with the receiver's sleepers increment then head check: one of the two sides sees the other
+    if (header->sleepers.load(std::memory_order_seq_cst) != 0) {
+        header->wakeSeq.fetch_add(1, std::memory_order_seq_cst);
+        futexWakeAll(&header->wakeSeq);
+    }
+}
+
+int ShmRingSender::send(const ngps_output &msg)
+{
+    if (header == NULL) {
+        return RETURN_FAILURE;
+    }
+    ShmRingSlot &slot = claim();
+    if (header->format == SHM_RING_RAW) {
+        memcpy(slot.data, &msg, sizeof(msg));
+        slot.length = sizeof(msg);
+    }
+    else {
+        INSTRUMENT(uint64_t t0 = instrNow());
+        slot.length = (uint32_t)NgpsCodec::encode(msg, slot.data, sizeof(slot.data));
+        INSTRUMENT(instrStage(STAGE_PACK, t0));
+    }
+    publish(slot);
+    return RETURN_SUCCESS;
+}
+
+int ShmRingSender::send(const char *data, size_t size)
+{
+    if (header == NULL || header->format != SHM_RING_ENCODED || size > SHM_RING_PAYLOAD) {
+        return RETURN_FAILURE;
+    }
+    ShmRingSlot &slot = claim();
+    memcpy(slot.data, data, size);
+    slot.length = (uint32_t)size;
+    publish(slot);
+    return RETURN_SUCCESS;
+}
+
+int ShmRingReceiver::open(const char *name, ShmWakeMode wakeMode, std::chrono::microseconds waitTimeout)
+{
+    close();
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return RETURN_FAILURE;
+    }
+    struct stat st;
+    void *base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= ringBytes(0)) {
+        base = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        return RETURN_FAILURE;
+    }
+    header = (ShmRingHeader *)base;
+    mapped = (size_t)st.st_size;
+
+    SysBool valid = memcmp(header->magic, SHM_RING_MAGIC, sizeof(header->magic)) == 0 ? TRUE : FALSE;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (!valid || header->version != SHM_RING_VERSION || header->capacity == 0 ||
+        (header->capacity & (header->capacity - 1)) != 0 || ringBytes(header->capacity) > mapped ||
+        header->format > SHM_RING_RAW ||
+        (header->format == SHM_RING_RAW && header->recordSize != sizeof(ngps_output))) {
+        close();
+        return RETURN_FAILURE;
+    }
+    slots = ringSlots(header);
+    capacity = header->capacity;
+    format = (ShmRingFormat)header->format;
+    mode = wakeMode;
+    timeout = waitTimeout;
+    next = header->head.load(std::memory_order_acquire);
+    return RETURN_SUCCESS;
+}
+
+void ShmRingReceiver::close()
+{
+    if (header != NULL) {
+        munmap(header, mapped);
+        header = NULL;
+        slots = NULL;
+    }
+    mapped = 0;
+    capacity = 0;
+    next = 0;
+}
+
+int ShmRingReceiver::drain(ngps_output *out, unsigned int max)
+{
+    uint64_t head = header->head.load(std::memory_order_acquire);
+    if (head - next > capacity) {
+        overrun += (unsigned long)(head - capacity - next);
+        next = head - capacity;
+    }
+
+    int n = 0;
+    char copy[SHM_RING_PAYLOAD];
+    for (; next < head && (unsigned int)n < max; ++next) {
+        const ShmRingSlot &slot = slots[next & (capacity - 1)];
+        if (slot.seq.load(std::memory_order_acquire) != next + 1) {
+            ++overrun;      /* already rewritten for a later lap */
+            continue;
+        }
+        uint32_t length = MIN(slot.length, (uint32_t)sizeof(copy));
+        memcpy(copy, slot.data, length);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != next + 1) {
+            ++overrun;      /* overwritten while being copied */
+            continue;
+        }
+
+        if (format == SHM_RING_RAW) {
+            memcpy(&out[n], copy, sizeof(ngps_output));
+            ++n;
+            continue;
+        }
+        INSTRUMENT(uint64_t t0 = instrNow());
+        DirectCodecStatus status = NgpsCodec::decode(copy, length, out[n]);
+        INSTRUMENT(instrStage(STAGE_DECODE, t0));
+        if (status == DIRECT_CODEC_OK) {
+            ++n;
+        }
+        else {
+            INSTRUMENT(instrCount(COUNTER_DECODE_ERRORS));
+            ++errors;
+        }
+    }
+    INSTRUMENT(instrCount(COUNTER_MESSAGES, (unsigned long)n));
+    return n;
+}
+
+void ShmRingReceiver::sleep(uint64_t deadlineNs)
+{
+    header->sleepers.fetch_add(1, std::memory_order_seq_cst);
+    uint32_t seen = header->wakeSeq.load(std::memory_order_seq_cst);
+    if (header->head.load(std::memory_order_seq_cst) == next) {
+        uint64_t now = monotonicNs();
+        if (now < deadlineNs) {
+            futexWait(&header->wakeSeq, seen, deadlineNs - now);
+        }
+    }
+    header->sleepers.fetch_sub(1, std::memory_order_seq_cst);
+}
+
+int ShmRingReceiver::receive(ngps_output *out, unsigned int max)
+{
+    if (header == NULL) {
+        return RETURN_FAILURE;
+    }
+    if (max == 0) {
+        return 0;
+    }
+    uint64_t deadline = monotonicNs() + (uint64_t)timeout.count() * 1000ULL;
+    for (unsigned int polls = 1;; ++polls) {
+        if (header->head.load(std::memory_order_acquire) != next) {
+            int n = drain(out, max);
+            if (n > 0) {
+                return n;
+            }
+            continue;   /* everything available was lost or undecodable */
+        }
+        if (polls % SHM_RING_SPIN != 0) {
+            cpuRelax();
+            continue;
+        }
+        if (monotonicNs() >= deadline) {
+            return 0;
+        }
+        if (mode == SHM_WAKE_BUSY_POLL) {
+            sched_yield();
+        }
+        else {
+            sleep(deadline);
+        }
+    }
+}
@@ -0,0 +1,151 @@
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include "ngpsOutput.h"
+
+/**
+ * Single-producer / multi-consumer ngps_output ring in POSIX shared memory, for a producer and
+ * consumers on the same host. ShmRingSender and ShmRingReceiver have the send()/receive()
+ * interface of the UDP transports, without the kernel crossings and socket copies.
+ *
+ * Every receiver sees every record (broadcast): each one keeps its own read position, and the
+ * producer never waits for them. A receiver that falls more than capacity records behind loses the
+ * oldest ones, counted in lost(). Each slot carries a sequence number written after its payload,
+ * so a receiver detects a slot overwritten while it was being copied. Records are stored
+ * NgpsCodec-encoded (any process) or as the raw struct (same build on both sides only).
+ *
+ * Receivers wait in one of two modes: SHM_WAKE_FUTEX spins briefly, then sleeps on a futex that
+ * the producer wakes only when someone is asleep; SHM_WAKE_BUSY_POLL never sleeps, yielding the
+ * CPU every SHM_RING_SPIN polls.
+ */
+
+#define SHM_RING_MAGIC      "NGPSSHM1"
+#define SHM_RING_VERSION    (1)
+#define SHM_RING_SPIN       (256)       /**< Polls before a receiver sleeps (futex) or yields (busy poll) */
+#define SHM_RING_PAYLOAD    (MAX(NGPS_OUTPUT_MAX_PACKED_SIZE, sizeof(ngps_output)))
+
+typedef enum ShmRingFormat
+{
+    SHM_RING_ENCODED = 0,       /**< NgpsCodec bytes, as in a datagram */
+    SHM_RING_RAW                /**< ngps_output copied as is */
+} ShmRingFormat;
+
+typedef enum ShmWakeMode
+{
+    SHM_WAKE_FUTEX = 0,         /**< Spin, then sleep until the producer publishes */
+    SHM_WAKE_BUSY_POLL          /**< Spin and yield; lowest latency with a core to spare */
+} ShmWakeMode;
+
+struct ShmRingConfig
+{
+    unsigned int capacity = 4096;               /* slots, rounded up to a power of two */
+    ShmRingFormat format = SHM_RING_ENCODED;
+};
+
+struct alignas(64) ShmRingSlot
+{
+    std::atomic<uint64_t> seq;      /* record number + 1 once written, 0 while being written */
+    uint32_t length;
+    char data[SHM_RING_PAYLOAD];
+};
+
+struct ShmRingHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t format;
+    uint32_t recordSize;            /* sizeof(ngps_output) of the producer, checked for SHM_RING_RAW */
+    alignas(64) std::atomic<uint64_t> head;     /* records published */
+    alignas(64) std::atomic<uint32_t> wakeSeq;  /* futex word, bumped when sleepers is non-zero */
+    std::atomic<uint32_t> sleepers;
+};
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "shared-memory atomics must be lock-free");
+
+class ShmRingSender
+{
+public:
+    ShmRingSender() {}
+    ~ShmRingSender() { close(); }
+
+    ShmRingSender(const ShmRingSender &) = delete;
+    ShmRingSender &operator=(const ShmRingSender &) = delete;
+
+    /* Create the ring as name (e.g. "/ngps"), replacing any old one. Returns RETURN_SUCCESS or RETURN_FAILURE */
+    int open(const char *name, const ShmRingConfig &config = ShmRingConfig());
+
+    /* Unmap and unlink the ring; attached receivers keep their mapping */
+    void close();
+
+    /* Publish one record. Returns RETURN_SUCCESS or RETURN_FAILURE (not open, encode failed) */
+    int send(const ngps_output &msg);
+
+    /* Publish an already encoded record (SHM_RING_ENCODED rings only) */
+    int send(const char *data, size_t size);
+
+    /* Records are visible as soon as send() returns; these exist for parity with UdpBatchSender */
+    int poll() { return 0; }
+    int flush() { return 0; }
+
+    uint64_t published() const { return next; }
+
+private:
+    ShmRingSlot &claim();
+    void publish(ShmRingSlot &slot);
+
+    char name[64] = "";
+    ShmRingHeader *header = NULL;
+    ShmRingSlot *slots = NULL;
+    size_t mapped = 0;
+    uint64_t mask = 0;
+    uint64_t next = 0;
+};
+
+class ShmRingReceiver
+{
+public:
+    ShmRingReceiver() {}
+    ~ShmRingReceiver() { close(); }
+
+    ShmRingReceiver(const ShmRingReceiver &) = delete;
+    ShmRingReceiver &operator=(const ShmRingReceiver &) = delete;
+
+    /**
+     * Attach to the ring created by a ShmRingSender; only records published from now on are
+     * received. Returns RETURN_SUCCESS or RETURN_FAILURE (missing, bad header, raw layout mismatch)
+     */
+    int open(const char *name, ShmWakeMode mode = SHM_WAKE_FUTEX,
+             std::chrono::microseconds timeout = std::chrono::microseconds(1000));
+    void close();
+
+    /**
+     * Wait up to timeout for the first record, then take whatever is published (at most max).
+     * Returns the number of records written to out, 0 on timeout, or RETURN_FAILURE.
+     */
+    int receive(ngps_output *out, unsigned int max);
+
+    unsigned long lost() const { return overrun; }
+    unsigned long decodeErrors() const { return errors; }
+
+private:
+    int drain(ngps_output *out, unsigned int max);
+    void sleep(uint64_t deadlineNs);
+
+    ShmRingHeader *header = NULL;         /* mapped writable: receivers register as sleepers */
+    const ShmRingSlot *slots = NULL;
+    size_t mapped = 0;
+    uint64_t capacity = 0;
+    uint64_t next = 0;
+    ShmRingFormat format = SHM_RING_ENCODED;
+    ShmWakeMode mode = SHM_WAKE_FUTEX;
+    std::chrono::microseconds timeout = std::chrono::microseconds(1000);
+    unsigned long overrun = 0;
+    unsigned long errors = 0;
+};
+
+#endif //SHMRING_H
@@ -0,0 +1,184 @@
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <linux/sock_diag.h>
+#include "socketTuning.h"
+#include "instrument.h"
+
+#ifndef SO_RXQ_OVFL
+# define SO_RXQ_OVFL    40
+#endif
+#ifndef SO_MEMINFO
+# define SO_MEMINFO     55
+#endif
+
+static SysBool setBuffer(int fd, int forceOption, int option, int bytes)
+{
+    if (setsockopt(fd, SOL_SOCKET, forceOption, &bytes, sizeof(bytes)) == 0) {
+        return TRUE;
+    }
+    return setsockopt(fd, SOL_SOCKET, option, &bytes, sizeof(bytes)) == 0 ? TRUE : FALSE;
+}
+
+static int getInt(int fd, int option)
+{
+    int value = 0;
+    socklen_t len = sizeof(value);
+    getsockopt(fd, SOL_SOCKET, option, &value, &len);
+    return value;
+}
+
+int tuneSocket(int fd, const SocketTuning &tuning, SocketTuningReport *report)
+{
+    SocketTuningReport granted;
+    int one = 1;
+    int status = RETURN_SUCCESS;
+
+    if (tuning.receiveBuffer > 0 && !setBuffer(fd, SO_RCVBUFFORCE, SO_RCVBUF, tuning.receiveBuffer)) {
+        status = RETURN_FAILURE;
+    }
+    if (tuning.sendBuffer > 0 && !setBuffer(fd, SO_SNDBUFFORCE, SO_SNDBUF, tuning.sendBuffer)) {
+        status = RETURN_FAILURE;
+    }
+    granted.receiveBuffer = getInt(fd, SO_RCVBUF);
+    granted.sendBuffer = getInt(fd, SO_SNDBUF);
+
+    // Without CAP_NET_ADMIN the plain options succeed but are capped at rmem_max / wmem_max
+    if (granted.receiveBuffer < tuning.receiveBuffer || granted.sendBuffer < tuning.sendBuffer) {
+        status = RETURN_FAILURE;
+    }
+
+    if (tuning.timestamps) {
+        if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof(one)) == 0) {
+            granted.timestamps = TRUE;
+        }
+        else {
+            status = RETURN_FAILURE;
+        }
+    }
+    if (tuning.dropCounter) {
+        if (setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one)) == 0) {
+            granted.dropCounter = TRUE;
+        }
+        else {
+            status = RETURN_FAILURE;
+        }
+    }
+    if (tuning.busyPollUs > 0) {
+        int us = (int)tuning.busyPollUs;
+        if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &us, sizeof(us)) == 0) {
+            granted.busyPoll = TRUE;
+        }
+        else {
+            status = RETURN_FAILURE;
+        }
+    }
+
+    if (report != NULL) {
+        *report = granted;
+    }
+    return status;
+}
+
+UdpTimedReceiver::UdpTimedReceiver(int sockfd, const UdpBatchConfig &config) :
+        sockfd(sockfd),
+        config(checkedConfig(config)),
+        buffers((size_t)this->config.batchSize * MAXLINE),
+        control((size_t)this->config.batchSize * CONTROL_SIZE),
+        iovecs(this->config.batchSize),
+        headers(this->config.batchSize)
+{
+    memset(headers.data(), 0, headers.size() * sizeof(mmsghdr));
+    for (unsigned int i = 0; i < this->config.batchSize; ++i) {
+        iovecs[i].iov_base = &buffers[(size_t)i * MAXLINE];
+        iovecs[i].iov_len = MAXLINE;
+        headers[i].msg_hdr.msg_iov = &iovecs[i];
+        headers[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+int UdpTimedReceiver::receive(NgpsTimedRecord *out, unsigned int max)
+{
+    struct pollfd pfd;
+    pfd.fd = sockfd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    long long us = config.flushTimeout.count();
+    struct timespec timeout;
+    timeout.tv_sec = us / 1000000;
+    timeout.tv_nsec = (us % 1000000) * 1000;
+
+    int ready = ppoll(&pfd, 1, &timeout, NULL);
+    if (ready < 0) {
+        return errno == EINTR ? 0 : RETURN_FAILURE;
+    }
+    if (ready == 0) {
+        return 0;
+    }
+
+    // recvmmsg shrinks msg_controllen to what it wrote: reset it for every call
+    unsigned int want = MIN(max, config.batchSize);
+    for (unsigned int i = 0; i < want; ++i) {
+        headers[i].msg_hdr.msg_control = &control[(size_t)i * CONTROL_SIZE];
+        headers[i].msg_hdr.msg_controllen = CONTROL_SIZE;
+    }
+    INSTRUMENT(uint64_t t0 = instrNow());
+    int n = recvmmsg(sockfd, headers.data(), want, MSG_DONTWAIT, NULL);
+    INSTRUMENT(instrStage(STAGE_RECV, t0));
+    if (n < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : RETURN_FAILURE;
+    }
+
+    int decoded = 0;
+    for (int i = 0; i < n; ++i) {
+        struct msghdr &hdr = headers[i].msg_hdr;
+        uint64_t kernelNs = 0;
+        for (struct cmsghdr *c = CMSG_FIRSTHDR(&hdr); c != NULL; c = CMSG_NXTHDR(&hdr, c)) {
+            if (c->cmsg_level != SOL_SOCKET) {
+                continue;
+            }
+            if (c->cmsg_type == SCM_TIMESTAMPNS) {
+                struct timespec ts;
+                memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+                kernelNs = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+            }
+            else if (c->cmsg_type == SO_RXQ_OVFL) {
+                uint32_t count;
+                memcpy(&count, CMSG_DATA(c), sizeof(count));
+                INSTRUMENT(if (count > drops) instrCount(COUNTER_DROPS, count - drops));
+                drops = MAX(drops, (unsigned long)count);
+            }
+        }
+
+        NgpsTimedRecord &r = out[decoded];
+        INSTRUMENT(uint64_t t1 = instrNow());
+        if ((hdr.msg_flags & MSG_TRUNC) ||
+            validator.check((const char *)iovecs[i].iov_base, headers[i].msg_len, &r.msg) != NGPS_ACCEPT) {
+            INSTRUMENT(instrCount((hdr.msg_flags & MSG_TRUNC) ? COUNTER_TRUNCATED : COUNTER_DECODE_ERRORS));
+            ++errors;
+            continue;
+        }
+        INSTRUMENT(instrStage(STAGE_DECODE, t1));
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        r.kernelNs = kernelNs;
+        r.decodedNs = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+        ++decoded;
+    }
+    INSTRUMENT(instrCount(COUNTER_MESSAGES, decoded));
+    return decoded;
+}
+
+unsigned long UdpTimedReceiver::kernelDrops() const
+{
+    // The SO_RXQ_OVFL count only arrives with a datagram, so drops after the last one are missing from it
+    uint32_t meminfo[SK_MEMINFO_VARS];
+    socklen_t len = sizeof(meminfo);
+    if (getsockopt(sockfd, SOL_SOCKET, SO_MEMINFO, meminfo, &len) == 0 &&
+        len > SK_MEMINFO_DROPS * sizeof(uint32_t)) {
+        return MAX(drops, (unsigned long)meminfo[SK_MEMINFO_DROPS]);
+    }
+    return drops;
+}
@@ -0,0 +1,94 @@
+#ifndef SOCKETTUNING_H
+#define SOCKETTUNING_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <vector>
+#include "ngpsOutput.h"
+#include "udpBatch.h"
+
+/**
+ * Socket options for the ngps_output receive path, and a receiver that reports per datagram how
+ * long it waited in the kernel.
+ *
+ * tuneSocket() sizes the kernel buffers (SO_RCVBUFFORCE / SO_SNDBUFFORCE when the process has
+ * CAP_NET_ADMIN, otherwise SO_RCVBUF / SO_SNDBUF, capped by net.core.rmem_max / wmem_max) and turns
+ * on SO_TIMESTAMPNS receive timestamps, SO_RXQ_OVFL drop counts and SO_BUSY_POLL. Every option
+ * is attempted; the report says what the kernel actually granted.
+ *
+ * UdpTimedReceiver reads with recvmmsg like UdpBatchReceiver, checks and decodes with an
+ * NgpsValidator (no allocation), and returns each record with the kernel's receive timestamp and
+ * the time decoding finished, both CLOCK_REALTIME, so decodedNs - kernelNs is the kernel-to-decode
+ * latency: socket queueing, wakeup and decode. kernelDrops() gives the number of datagrams the
+ * socket dropped because its buffer was full.
+ */
+
+struct SocketTuning
+{
+    int receiveBuffer = 8 << 20;        /* bytes requested; 0 leaves the default */
+    int sendBuffer = 1 << 20;
+    SysBool timestamps = TRUE;          /* SO_TIMESTAMPNS */
+    SysBool dropCounter = TRUE;         /* SO_RXQ_OVFL */
+    unsigned int busyPollUs = 0;        /* SO_BUSY_POLL; 0 leaves it off */
+};
+
+struct SocketTuningReport
+{
+    int receiveBuffer = 0;              /* bytes granted, as getsockopt reports them (twice the usable size) */
+    int sendBuffer = 0;
+    SysBool timestamps = FALSE;
+    SysBool dropCounter = FALSE;
+    SysBool busyPoll = FALSE;
+};
+
+/* Apply tuning to fd. Returns RETURN_FAILURE if any requested option was refused (the others still apply) */
+int tuneSocket(int fd, const SocketTuning &tuning, SocketTuningReport *report = NULL);
+
+struct NgpsTimedRecord
+{
+    ngps_output msg;
+    uint64_t kernelNs;          /* SO_TIMESTAMPNS arrival time, 0 if the datagram carried none */
+    uint64_t decodedNs;         /* when decoding finished */
+
+    uint64_t latencyNs() const { return kernelNs != 0 && decodedNs > kernelNs ? decodedNs - kernelNs : 0; }
+};
+
+class UdpTimedReceiver
+{
+public:
+    explicit UdpTimedReceiver(int sockfd, const UdpBatchConfig &config = UdpBatchConfig());
+
+    /**
+     * Wait up to flushTimeout for the first datagram, then drain whatever is queued (at most
+     * min(batchSize, max)). Returns the number of records written to out, 0 on timeout, or
+     * RETURN_FAILURE.
+     */
+    int receive(NgpsTimedRecord *out, unsigned int max);
+
+    /**
+     * Datagrams dropped by the socket so far, read from SO_MEMINFO; falls back to the SO_RXQ_OVFL count
+     * of the last datagram received on kernels without it
+     */
+    unsigned long kernelDrops() const;
+    unsigned long decodeErrors() const { return errors; }
+
+    /* Per-reason reject counts */
+    const NgpsValidator &validation() const { return validator; }
+
+private:
+    enum { CONTROL_SIZE = 64 };
+
+    int sockfd;
+    UdpBatchConfig config;
+    std::vector<char> buffers;
+    std::vector<char> control;
+    std::vector<iovec> iovecs;
+    std::vector<mmsghdr> headers;
+    NgpsValidator validator;
+    unsigned long drops = 0;
+    unsigned long errors = 0;
+};
+
+#endif //SOCKETTUNING_H
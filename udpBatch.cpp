@@ -0,0 +1,142 @@
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include "udpBatch.h"
+#include "instrument.h"
+
+UdpBatchSender::UdpBatchSender(int sockfd, const sockaddr_in &dest, const UdpBatchConfig &config) :
+        sockfd(sockfd),
+        dest(dest),
+        config(checkedConfig(config)),
+        slots(this->config.batchSize),
+        iovecs(this->config.batchSize),
+        headers(this->config.batchSize)
+{
+    memset(headers.data(), 0, headers.size() * sizeof(mmsghdr));
+    for (unsigned int i = 0; i < this->config.batchSize; ++i) {
+        headers[i].msg_hdr.msg_name = &this->dest;
+        headers[i].msg_hdr.msg_namelen = sizeof(this->dest);
+        headers[i].msg_hdr.msg_iov = &iovecs[i];
+        headers[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+int UdpBatchSender::send(const ngps_output &msg)
+{
+    if (count == 0) {
+        oldest = Clock::now();
+    }
+
+    NgpsPackBuffer &slot = slots[count];
+    slot.clear();
+    INSTRUMENT(uint64_t t0 = instrNow());
+    msgpack::pack(slot, msg);
+    INSTRUMENT(instrStage(STAGE_PACK, t0));
+    ++count;
+
+    if (count == config.batchSize) {
+        return flush();
+    }
+    return poll();
+}
+
+int UdpBatchSender::poll()
+{
+    if (count == 0 || Clock::now() - oldest < config.flushTimeout) {
+        return 0;
+    }
+    return flush();
+}
+
+int UdpBatchSender::flush()
+{
+    unsigned int sent = 0;
+
+    for (unsigned int i = 0; i < count; ++i) {
+        iovecs[i].iov_base = slots[i].data();
+        iovecs[i].iov_len = slots[i].size();
+    }
+
+    while (sent < count) {
+        INSTRUMENT(uint64_t t0 = instrNow());
+        int n = sendmmsg(sockfd, &headers[sent], count - sent, 0);
+        INSTRUMENT(instrStage(STAGE_SEND, t0));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            INSTRUMENT(instrCount(COUNTER_DROPS, count - sent));
+            count = 0;
+            return RETURN_FAILURE;
+        }
+        sent += n;
+    }
+
+    count = 0;
+    return (int)sent;
+}
+
+UdpBatchReceiver::UdpBatchReceiver(int sockfd, const UdpBatchConfig &config) :
+        sockfd(sockfd),
+        config(checkedConfig(config)),
+        buffers((size_t)this->config.batchSize * MAXLINE),
+        iovecs(this->config.batchSize),
+        headers(this->config.batchSize)
+{
+    memset(headers.data(), 0, headers.size() * sizeof(mmsghdr));
+    for (unsigned int i = 0; i < this->config.batchSize; ++i) {
+        iovecs[i].iov_base = &buffers[(size_t)i * MAXLINE];
+        iovecs[i].iov_len = MAXLINE;
+        headers[i].msg_hdr.msg_iov = &iovecs[i];
+        headers[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+int UdpBatchReceiver::receive(ngps_output *out, unsigned int max)
+{
+    struct pollfd pfd;
+    pfd.fd = sockfd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    long long us = config.flushTimeout.count();
+    struct timespec timeout;
+    timeout.tv_sec = us / 1000000;
+    timeout.tv_nsec = (us % 1000000) * 1000;
+
+    int ready = ppoll(&pfd, 1, &timeout, NULL);
+    if (ready < 0) {
+        return errno == EINTR ? 0 : RETURN_FAILURE;
+    }
+    if (ready == 0) {
+        return 0;
+    }
+
+    unsigned int want = MIN(max, config.batchSize);
+    INSTRUMENT(uint64_t t0 = instrNow());
+    int n = recvmmsg(sockfd, headers.data(), want, MSG_DONTWAIT, NULL);
+    INSTRUMENT(instrStage(STAGE_RECV, t0));
+    if (n < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : RETURN_FAILURE;
+    }
+
+    int decoded = 0;
+    for (int i = 0; i < n; ++i) {
+        if (headers[i].msg_hdr.msg_flags & MSG_TRUNC) {
+            INSTRUMENT(instrCount(COUNTER_TRUNCATED));
+            ++errors;
+            continue;
+        }
+        INSTRUMENT(uint64_t t1 = instrNow());
+        if (validator.check((const char *)iovecs[i].iov_base, headers[i].msg_len, &out[decoded]) != NGPS_ACCEPT) {
+            INSTRUMENT(instrCount(COUNTER_DECODE_ERRORS));
+            ++errors;
+            continue;
+        }
+        INSTRUMENT(instrStage(STAGE_DECODE, t1));
+        ++decoded;
+    }
+    INSTRUMENT(instrCount(COUNTER_MESSAGES, decoded));
+    return decoded;
+}
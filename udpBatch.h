@@ -0,0 +1,101 @@
+#ifndef UDPBATCH_H
+#define UDPBATCH_H
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <chrono>
+#include <vector>
+#include <msgpack.hpp>
+#include "ngpsOutput.h"
+#include "ngpsValidator.h"
+
+/**
+ * Batching parameters shared by the sender and the receiver.
+ * batchSize     - maximum number of datagrams handed to one sendmmsg/recvmmsg call (0 is taken as 1)
+ * flushTimeout  - sender: maximum time a queued message waits before the batch is flushed
+ *                 receiver: maximum time receive() waits for the first datagram of a batch
+ */
+struct UdpBatchConfig
+{
+    unsigned int batchSize = 32;
+    std::chrono::microseconds flushTimeout = std::chrono::microseconds(1000);
+};
+
+/* config with batchSize 0 taken as 1, for the constructors that size their batches from it */
+inline UdpBatchConfig checkedConfig(const UdpBatchConfig &config)
+{
+    UdpBatchConfig checked = config;
+    checked.batchSize = MAX(checked.batchSize, 1u);
+    return checked;
+}
+
+/**
+ * Queues ngps_output records, one msgpack datagram each, and sends a whole batch
+ * with a single sendmmsg() call once batchSize records are queued or the oldest
+ * queued record is older than flushTimeout.
+ */
+class UdpBatchSender
+{
+public:
+    UdpBatchSender(int sockfd, const sockaddr_in &dest, const UdpBatchConfig &config = UdpBatchConfig());
+
+    /* Queue one record. Returns the number of datagrams flushed (0 if only queued) or RETURN_FAILURE */
+    int send(const ngps_output &msg);
+
+    /* Flush the batch if the flush timeout has expired. Same return convention as send() */
+    int poll();
+
+    /* Send every queued record now. Returns the number of datagrams sent or RETURN_FAILURE */
+    int flush();
+
+    unsigned int pending() const { return count; }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    int sockfd;
+    sockaddr_in dest;
+    UdpBatchConfig config;
+    std::vector<NgpsPackBuffer> slots;
+    std::vector<iovec> iovecs;
+    std::vector<mmsghdr> headers;
+    unsigned int count = 0;
+    Clock::time_point oldest;
+};
+
+/**
+ * Receives up to batchSize datagrams with a single recvmmsg() call and decodes
+ * each of them into an ngps_output. Datagrams that fail to decode are dropped
+ * and counted in decodeErrors(). An NgpsValidator checks and decodes each datagram
+ * in one pass, so malformed input is rejected without an exception and a steady
+ * stream of records makes no heap allocations.
+ */
+class UdpBatchReceiver
+{
+public:
+    explicit UdpBatchReceiver(int sockfd, const UdpBatchConfig &config = UdpBatchConfig());
+
+    /**
+     * Wait up to flushTimeout for the first datagram, then drain whatever is queued
+     * (at most min(batchSize, max) datagrams). Returns the number of records written
+     * to out, 0 on timeout, or RETURN_FAILURE.
+     */
+    int receive(ngps_output *out, unsigned int max);
+
+    unsigned long decodeErrors() const { return errors; }
+
+    /* Per-reason reject counts */
+    const NgpsValidator &validation() const { return validator; }
+
+private:
+    int sockfd;
+    UdpBatchConfig config;
+    std::vector<char> buffers;
+    std::vector<iovec> iovecs;
+    std::vector<mmsghdr> headers;
+    NgpsValidator validator;
+    unsigned long errors = 0;
+};
+
+#endif //UDPBATCH_H
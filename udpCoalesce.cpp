@@ -0,0 +1,199 @@
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include "udpCoalesce.h"
+#include "instrument.h"
+
+UdpCoalescingSender::UdpCoalescingSender(int sockfd, const sockaddr_in &dest, size_t maxDatagram,
+                                         std::chrono::microseconds flushTimeout) :
+        sockfd(sockfd),
+        dest(dest),
+        maxDatagram(MAX(MIN(maxDatagram, (size_t)MAXLINE),
+                        (size_t)(COALESCE_HEADER_SIZE + NGPS_OUTPUT_MAX_PACKED_SIZE))),
+        flushTimeout(flushTimeout)
+{
+}
+
+int UdpCoalescingSender::add(const ngps_output &msg)
+{
+    // NgpsCodec writes the same bytes as pack<ngps_output>; encoding first lets the datagram
+    // be filled by actual rather than worst-case record size
+    char record[NGPS_OUTPUT_MAX_PACKED_SIZE];
+    INSTRUMENT(uint64_t t0 = instrNow());
+    size_t size = NgpsCodec::encode(msg, record, sizeof(record));
+    INSTRUMENT(instrStage(STAGE_PACK, t0));
+
+    int sent = 0;
+    if (used + size > maxDatagram) {
+        sent = flush();
+        if (sent < 0) {
+            return RETURN_FAILURE;
+        }
+    }
+    if (count == 0) {
+        oldest = Clock::now();
+    }
+
+    memcpy(datagram + used, record, size);
+    used += size;
+    ++count;
+
+    if (count == COALESCE_MAX_RECORDS) {
+        int n = flush();
+        return n < 0 ? RETURN_FAILURE : sent + n;
+    }
+    if (sent == 0) {
+        sent = poll();
+    }
+    return sent;
+}
+
+int UdpCoalescingSender::poll()
+{
+    if (count == 0 || Clock::now() - oldest < flushTimeout) {
+        return 0;
+    }
+    return flush();
+}
+
+int UdpCoalescingSender::flush()
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    datagram[0] = (char)COALESCE_MAGIC;
+    datagram[1] = (char)count;
+    datagram[2] = (char)(seq >> 8);
+    datagram[3] = (char)seq;
+
+    INSTRUMENT(uint64_t t0 = instrNow());
+    ssize_t n = sendto(sockfd, datagram, used, 0, (const struct sockaddr *)&dest, sizeof(dest));
+    INSTRUMENT(instrStage(STAGE_SEND, t0));
+    INSTRUMENT(if (n < 0) instrCount(COUNTER_DROPS, count));
+    ++seq;
+    count = 0;
+    used = COALESCE_HEADER_SIZE;
+    return n < 0 ? RETURN_FAILURE : 1;
+}
+
+UdpCoalescingReceiver::UdpCoalescingReceiver(int sockfd, std::chrono::microseconds timeout) :
+        sockfd(sockfd),
+        timeout(timeout)
+{
+}
+
+int UdpCoalescingReceiver::recvDatagram()
+{
+    struct pollfd pfd;
+    pfd.fd = sockfd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    long long us = timeout.count();
+    struct timespec ts;
+    ts.tv_sec = us / 1000000;
+    ts.tv_nsec = (us % 1000000) * 1000;
+
+    int ready = ppoll(&pfd, 1, &ts, NULL);
+    if (ready <= 0) {
+        return (ready == 0 || errno == EINTR) ? 0 : RETURN_FAILURE;
+    }
+
+    // Nothing from the previous datagram is pending, so the buffer is reused from its start
+    unpacker.reserve_buffer(MAXLINE);
+    INSTRUMENT(uint64_t t0 = instrNow());
+    ssize_t n = recvfrom(sockfd, unpacker.buffer(), MAXLINE, MSG_DONTWAIT | MSG_TRUNC, NULL, NULL);
+    if (n < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : RETURN_FAILURE;
+    }
+    INSTRUMENT(instrStage(STAGE_RECV, t0));
+    if (n == 0) {
+        return 0;
+    }
+    if (n > MAXLINE) {
+        INSTRUMENT(instrCount(COUNTER_TRUNCATED));
+        ++errors;
+        return 0;
+    }
+    unpacker.buffer_consumed((size_t)n);
+
+    const unsigned char *header = (const unsigned char *)unpacker.nonparsed_buffer();
+    if (header[0] != COALESCE_MAGIC) {
+        remaining = 1;      /* plain pack<ngps_output> datagram */
+        return 1;
+    }
+    if (n < COALESCE_HEADER_SIZE) {
+        unpacker.skip_nonparsed_buffer((size_t)n);
+        ++errors;
+        return 0;
+    }
+
+    UShort seq = (UShort)((header[2] << 8) | header[3]);
+    if (haveSeq && seq != expectedSeq) {
+        lost += (UShort)(seq - expectedSeq);
+        INSTRUMENT(instrCount(COUNTER_DROPS, (UShort)(seq - expectedSeq)));
+    }
+    haveSeq = TRUE;
+    expectedSeq = (UShort)(seq + 1);
+
+    remaining = header[1];
+    unpacker.skip_nonparsed_buffer(COALESCE_HEADER_SIZE);
+    return 1;
+}
+
+void UdpCoalescingReceiver::discardDatagram()
+{
+    // A failed next() keeps the bytes it took in its parse context, which would prefix the next datagram
+    unpacker.reset();
+    unpacker.skip_nonparsed_buffer(unpacker.nonparsed_size());
+    remaining = 0;
+}
+
+int UdpCoalescingReceiver::receive(ngps_output *out, unsigned int max)
+{
+    if (remaining == 0) {
+        int rc = recvDatagram();
+        if (rc <= 0) {
+            return rc;
+        }
+    }
+
+    unsigned int decoded = 0;
+    msgpack::object_handle oh;
+    while (remaining > 0 && decoded < max) {
+        --remaining;
+        try {
+            INSTRUMENT(uint64_t t0 = instrNow());
+            if (!unpacker.next(oh)) {
+                INSTRUMENT(instrCount(COUNTER_DECODE_ERRORS));
+                ++errors;           /* the datagram ends inside a record */
+                discardDatagram();
+                break;
+            }
+            INSTRUMENT(instrStage(STAGE_UNPACK, t0));
+            INSTRUMENT(uint64_t t1 = instrNow());
+            oh.get().convert(out[decoded]);
+            INSTRUMENT(instrStage(STAGE_CONVERT, t1));
+            ++decoded;
+        }
+        catch (const msgpack::unpack_error &) {
+            INSTRUMENT(instrCount(COUNTER_DECODE_ERRORS));
+            ++errors;               /* the rest of the datagram can not be framed */
+            discardDatagram();
+            break;
+        }
+        catch (const msgpack::type_error &) {
+            INSTRUMENT(instrCount(COUNTER_DECODE_ERRORS));
+            ++errors;
+        }
+    }
+    INSTRUMENT(instrCount(COUNTER_MESSAGES, decoded));
+
+    if (remaining == 0 && unpacker.nonparsed_size() > 0) {
+        ++errors;                   /* trailing bytes after the last record */
+        unpacker.skip_nonparsed_buffer(unpacker.nonparsed_size());
+    }
+    return (int)decoded;
+}
@@ -0,0 +1,91 @@
+#ifndef UDPCOALESCE_H
+#define UDPCOALESCE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <chrono>
+#include <msgpack.hpp>
+#include "ngpsOutput.h"
+
+/**
+ * Coalesced datagram layout:
+ *   byte 0     COALESCE_MAGIC (0xc1, a byte msgpack never emits, so a coalesced datagram can not
+ *              be mistaken for a plain pack<ngps_output> datagram)
+ *   byte 1     record count
+ *   bytes 2-3  datagram sequence number, big endian
+ *   bytes 4-   count msgpack-encoded ngps_output records, back to back
+ */
+#define COALESCE_MAGIC          (0xc1)
+#define COALESCE_HEADER_SIZE    (4)
+#define COALESCE_MAX_RECORDS    (MAX_UNSIGNED_TINY)
+
+/**
+ * Packs as many ngps_output records as fit into one datagram of at most maxDatagram bytes and
+ * sends it when the next record might not fit, when COALESCE_MAX_RECORDS is reached, or when the
+ * oldest record has waited flushTimeout (checked by add() and poll()). maxDatagram is clamped to
+ * [COALESCE_HEADER_SIZE + NGPS_OUTPUT_MAX_PACKED_SIZE, MAXLINE], so any record fits an empty datagram.
+ */
+class UdpCoalescingSender
+{
+public:
+    UdpCoalescingSender(int sockfd, const sockaddr_in &dest, size_t maxDatagram = MAXLINE,
+                        std::chrono::microseconds flushTimeout = std::chrono::microseconds(1000));
+
+    /* Queue one record. Returns datagrams sent (0 or 1) or RETURN_FAILURE */
+    int add(const ngps_output &msg);
+    int poll();
+    int flush();
+
+    unsigned int pending() const { return count; }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    int sockfd;
+    sockaddr_in dest;
+    size_t maxDatagram;
+    std::chrono::microseconds flushTimeout;
+    char datagram[MAXLINE];
+    size_t used = COALESCE_HEADER_SIZE;
+    unsigned int count = 0;
+    UShort seq = 0;
+    Clock::time_point oldest;
+};
+
+/**
+ * Receives coalesced (or plain single-record) datagrams straight into a msgpack::unpacker buffer
+ * and streams the records out of it, so payload bytes are never copied after recv. Records left
+ * over when the caller's array is full are returned by the next receive().
+ */
+class UdpCoalescingReceiver
+{
+public:
+    explicit UdpCoalescingReceiver(int sockfd,
+                                   std::chrono::microseconds timeout = std::chrono::microseconds(1000));
+
+    /**
+     * Return up to max buffered records, receiving one datagram first if none are buffered.
+     * Returns the number of records written to out, 0 on timeout, or RETURN_FAILURE.
+     */
+    int receive(ngps_output *out, unsigned int max);
+
+    unsigned long decodeErrors() const { return errors; }
+    unsigned long lostDatagrams() const { return lost; }
+
+private:
+    int recvDatagram();
+    void discardDatagram();
+
+    int sockfd;
+    std::chrono::microseconds timeout;
+    msgpack::unpacker unpacker;
+    unsigned int remaining = 0;     /* records of the current datagram not yet returned */
+    SysBool haveSeq = FALSE;
+    UShort expectedSeq = 0;
+    unsigned long errors = 0;
+    unsigned long lost = 0;
+};
+
+#endif //UDPCOALESCE_H
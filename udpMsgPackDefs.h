@@ -0,0 +1,14 @@
+#ifndef UDPMSGPACKDEFS_H
+#define UDPMSGPACKDEFS_H
+
+/*
+ * Project-wide entry point to sysDefs.h. sysDefs.h requires REDUNDANCY_LEVEL; this application
+ * runs a single stream unless the build overrides it (CMake cache variable UDPMSGPACK_REDUNDANCY_LEVEL,
+ * or -DREDUNDANCY_LEVEL=3).
+ */
+#ifndef REDUNDANCY_LEVEL
+#define REDUNDANCY_LEVEL 1
+#endif
+#include "sysDefs.h"
+
+#endif //UDPMSGPACKDEFS_H
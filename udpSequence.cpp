@@ -0,0 +1,299 @@
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include "udpSequence.h"
+#include "instrument.h"
+
+static_assert((REORDER_WINDOW & (REORDER_WINDOW - 1)) == 0, "REORDER_WINDOW must be a power of two");
+static_assert(REORDER_WINDOW <= 64, "ReorderBuffer history mask holds 64 sequence numbers");
+
+ReorderBuffer::ReorderBuffer(std::chrono::microseconds holdTimeout) :
+        holdTimeout(holdTimeout)
+{
+}
+
+void ReorderBuffer::reset(uint32_t seq, uint64_t timestampNs)
+{
+    started = TRUE;
+    next = seq;
+    highest = seq;
+    newestNs = timestampNs;
+    history = 0;
+}
+
+/* Release or skip the record at next */
+void ReorderBuffer::advance(NgpsEnvelope *out, unsigned int &released)
+{
+    Slot &slot = slots[next % REORDER_WINDOW];
+    if (slot.full) {
+        out[released++] = slot.env;
+        slot.full = FALSE;
+        --heldCount;
+        history = (history << 1) | 1;
+        ++counters.delivered;
+    }
+    else {
+        history <<= 1;
+        ++counters.lost;
+    }
+    ++next;
+}
+
+void ReorderBuffer::drain(NgpsEnvelope *out, unsigned int &released)
+{
+    while (slots[next % REORDER_WINDOW].full) {
+        advance(out, released);
+    }
+}
+
+SequenceStatus ReorderBuffer::push(const NgpsEnvelope &env, Clock::time_point now, NgpsEnvelope *out,
+                                   unsigned int *released)
+{
+    SequenceStatus status = SEQUENCE_IN_ORDER;
+    unsigned int n = 0;
+    *released = 0;
+
+    if (!started) {
+        reset(env.seq, env.timestampNs);
+    }
+
+    int32_t distance = (int32_t)(env.seq - next);
+    if (distance < 0) {
+        // A late or duplicated datagram was stamped before the newest one seen; a restarted sender's after it
+        uint32_t age = (uint32_t)-(int64_t)distance;
+        if (age <= REORDER_RESYNC_DISTANCE && env.timestampNs <= newestNs) {
+            if (age <= 64 && ((history >> (age - 1)) & 1)) {
+                ++counters.duplicates;
+                return SEQUENCE_DUPLICATE;
+            }
+            ++counters.stale;
+            return SEQUENCE_STALE;
+        }
+        // The sender restarted. Hand over what the old stream left, then follow the new one
+        while (heldCount > 0) {
+            advance(out, n);
+        }
+        reset(env.seq, env.timestampNs);
+        ++counters.resyncs;
+        status = SEQUENCE_RESYNC;
+    }
+    else if (distance >= REORDER_WINDOW) {
+        // Too far ahead to hold: give up the oldest gaps until env.seq fits in the window
+        while ((uint32_t)(env.seq - next) >= REORDER_WINDOW) {
+            if (heldCount == 0) {
+                uint32_t skip = env.seq - next - (REORDER_WINDOW - 1);
+                counters.lost += skip;
+                history = skip >= 64 ? 0 : history << skip;
+                next += skip;
+                break;
+            }
+            advance(out, n);
+        }
+    }
+
+    Slot &slot = slots[env.seq % REORDER_WINDOW];
+    if (slot.full) {
+        ++counters.duplicates;
+        *released = n;
+        return SEQUENCE_DUPLICATE;
+    }
+    slot.env = env;
+    slot.full = TRUE;
+    ++heldCount;
+
+    if ((int32_t)(env.seq - highest) < 0) {
+        ++counters.reordered;
+    }
+    else {
+        highest = env.seq;
+    }
+    newestNs = MAX(newestNs, env.timestampNs);
+
+    if (env.seq != next && status != SEQUENCE_RESYNC) {
+        status = SEQUENCE_BUFFERED;
+        if (heldCount == 1) {
+            gapSince = now;
+        }
+    }
+
+    unsigned int before = n;
+    drain(out, n);
+    if (n > before && heldCount > 0) {
+        gapSince = now;         /* a later gap is open now */
+    }
+    *released = n;
+    return status;
+}
+
+unsigned int ReorderBuffer::expire(Clock::time_point now, NgpsEnvelope *out)
+{
+    if (heldCount == 0 || now - gapSince < holdTimeout) {
+        return 0;
+    }
+
+    unsigned int n = 0;
+    while (!slots[next % REORDER_WINDOW].full) {
+        advance(out, n);
+    }
+    drain(out, n);
+    if (heldCount > 0) {
+        gapSince = now;
+    }
+    return n;
+}
+
+UdpSequencedSender::UdpSequencedSender(int sockfd, const sockaddr_in &dest, UShort senderId) :
+        sockfd(sockfd),
+        dest(dest),
+        senderId(senderId)
+{
+}
+
+int UdpSequencedSender::send(const ngps_output &msg)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    NgpsEnvelope env;
+    env.senderId = senderId;
+    env.seq = seq++;
+    env.timestampNs = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    env.payload = msg;
+
+    buffer.clear();
+    INSTRUMENT(uint64_t t0 = instrNow());
+    msgpack::pack(buffer, env);
+    INSTRUMENT(instrStage(STAGE_PACK, t0));
+
+    INSTRUMENT(uint64_t t1 = instrNow());
+    ssize_t n = sendto(sockfd, buffer.data(), buffer.size(), 0, (const struct sockaddr *)&dest, sizeof(dest));
+    INSTRUMENT(instrStage(STAGE_SEND, t1));
+    if (n < 0) {
+        INSTRUMENT(instrCount(COUNTER_DROPS));
+        return RETURN_FAILURE;
+    }
+    return RETURN_SUCCESS;
+}
+
+UdpSequencedReceiver::UdpSequencedReceiver(int sockfd, std::chrono::microseconds timeout,
+                                           std::chrono::microseconds holdTimeout) :
+        sockfd(sockfd),
+        timeout(timeout),
+        holdTimeout(holdTimeout)
+{
+}
+
+int UdpSequencedReceiver::recvDatagram(SysBool wait)
+{
+    if (wait) {
+        struct pollfd pfd;
+        pfd.fd = sockfd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        long long us = timeout.count();
+        struct timespec ts;
+        ts.tv_sec = us / 1000000;
+        ts.tv_nsec = (us % 1000000) * 1000;
+
+        int ready = ppoll(&pfd, 1, &ts, NULL);
+        if (ready <= 0) {
+            return (ready == 0 || errno == EINTR) ? 0 : RETURN_FAILURE;
+        }
+    }
+
+    char buffer[MAXLINE];
+    INSTRUMENT(uint64_t t0 = instrNow());
+    ssize_t n = recvfrom(sockfd, buffer, MAXLINE, MSG_DONTWAIT | MSG_TRUNC, NULL, NULL);
+    if (n < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : RETURN_FAILURE;
+    }
+    INSTRUMENT(instrStage(STAGE_RECV, t0));
+    if (n == 0 || n > MAXLINE) {
+        INSTRUMENT(if (n > MAXLINE) instrCount(COUNTER_TRUNCATED));
+        ++errors;
+        return 1;
+    }
+
+    NgpsEnvelope env;
+    try {
+        INSTRUMENT(uint64_t t1 = instrNow());
+        msgpack::object obj = arena.unpack(buffer, (size_t)n);
+        INSTRUMENT(instrStage(STAGE_UNPACK, t1));
+        INSTRUMENT(uint64_t t2 = instrNow());
+        if (obj.type == msgpack::type::ARRAY && obj.via.array.size == NGPS_ENVELOPE_FIELDS) {
+            obj.convert(env);
+        }
+        else {
+            obj.convert(env.payload);       /* bare ngps_output: not sequenced */
+            ready.push_back(env);
+            INSTRUMENT(instrStage(STAGE_CONVERT, t2));
+            return 1;
+        }
+        INSTRUMENT(instrStage(STAGE_CONVERT, t2));
+    }
+    catch (const std::exception &) {
+        INSTRUMENT(instrCount(COUNTER_DECODE_ERRORS));
+        ++errors;
+        return 1;
+    }
+
+    std::unordered_map<UShort, ReorderBuffer>::iterator it = streams.find(env.senderId);
+    if (it == streams.end()) {
+        it = streams.emplace(env.senderId, ReorderBuffer(holdTimeout)).first;
+    }
+    unsigned int count = 0;
+    it->second.push(env, ReorderBuffer::Clock::now(), released, &count);
+    ready.insert(ready.end(), released, released + count);
+    return 1;
+}
+
+void UdpSequencedReceiver::expireAll()
+{
+    ReorderBuffer::Clock::time_point now = ReorderBuffer::Clock::now();
+    for (std::unordered_map<UShort, ReorderBuffer>::iterator it = streams.begin(); it != streams.end(); ++it) {
+        unsigned int count = it->second.expire(now, released);
+        ready.insert(ready.end(), released, released + count);
+    }
+}
+
+int UdpSequencedReceiver::receive(NgpsEnvelope *out, unsigned int max)
+{
+    if (readyHead == ready.size()) {
+        // Everything released has been returned: reuse the storage rather than free and grow it again
+        ready.clear();
+        readyHead = 0;
+        int rc = recvDatagram(TRUE);
+        // Drain what is already queued so reordered neighbours meet in the window
+        for (unsigned int i = 0; rc > 0 && i < REORDER_WINDOW; ++i) {
+            rc = recvDatagram(FALSE);
+        }
+        if (rc < 0) {
+            return RETURN_FAILURE;
+        }
+        expireAll();
+    }
+
+    unsigned int count = (unsigned int)MIN((size_t)max, ready.size() - readyHead);
+    for (unsigned int i = 0; i < count; ++i) {
+        out[i] = ready[readyHead++];
+    }
+    INSTRUMENT(instrCount(COUNTER_MESSAGES, count));
+    return (int)count;
+}
+
+SequenceStats UdpSequencedReceiver::stats() const
+{
+    SequenceStats total;
+    for (std::unordered_map<UShort, ReorderBuffer>::const_iterator it = streams.begin(); it != streams.end(); ++it) {
+        const SequenceStats &s = it->second.stats();
+        total.delivered += s.delivered;
+        total.lost += s.lost;
+        total.reordered += s.reordered;
+        total.duplicates += s.duplicates;
+        total.stale += s.stale;
+        total.resyncs += s.resyncs;
+    }
+    return total;
+}
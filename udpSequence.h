@@ -0,0 +1,205 @@
+#ifndef UDPSEQUENCE_H
+#define UDPSEQUENCE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+#include <msgpack.hpp>
+#include "ngpsOutput.h"
+#include "unpackArena.h"
+
+/**
+ * Sequenced datagram: a msgpack array of 4
+ *   [0] sender id    uint16, chosen by the sender and unique per stream
+ *   [1] sequence     uint32, +1 per datagram, wraps
+ *   [2] timestamp    uint64, sender CLOCK_REALTIME in ns when the datagram was stamped
+ *   [3] payload      ngps_output as written by pack<ngps_output>
+ * An envelope starts with fixarray(4) (0x94); a bare ngps_output starts with fixarray(11) (0x9b),
+ * so a receiver can accept both on the same socket.
+ */
+#define NGPS_ENVELOPE_FIELDS            (4)
+#define NGPS_ENVELOPE_MAX_PACKED_SIZE   (1 + 3 + 5 + 9 + NGPS_OUTPUT_MAX_PACKED_SIZE)
+
+#define REORDER_WINDOW          (64)    /**< Sequence numbers a ReorderBuffer holds ahead of the next expected */
+#define REORDER_RESYNC_DISTANCE (4096)  /**< Farther behind than this is a sender restart, whatever the timestamp */
+
+struct NgpsEnvelope
+{
+    UShort      senderId = 0;
+    uint32_t    seq = 0;
+    uint64_t    timestampNs = 0;
+    ngps_output payload;
+};
+
+namespace msgpack {
+    MSGPACK_API_VERSION_NAMESPACE(MSGPACK_DEFAULT_API_NS) {
+        namespace adaptor {
+
+            template<>
+            struct convert<NgpsEnvelope> {
+                msgpack::object const& operator()(msgpack::object const& o, NgpsEnvelope& v) const {
+                    if (o.type != msgpack::type::ARRAY) throw msgpack::type_error();
+                    if (o.via.array.size != NGPS_ENVELOPE_FIELDS) throw msgpack::type_error();
+                    v.senderId = o.via.array.ptr[0].as<UShort>();
+                    v.seq = o.via.array.ptr[1].as<uint32_t>();
+                    v.timestampNs = o.via.array.ptr[2].as<uint64_t>();
+                    o.via.array.ptr[3].convert(v.payload);
+                    return o;
+                }
+            };
+
+            template<>
+            struct pack<NgpsEnvelope>
+            {
+                template <typename Stream>
+                packer<Stream>& operator()(msgpack::packer<Stream>& o, NgpsEnvelope const& r) const
+                {
+                    o.pack_array(NGPS_ENVELOPE_FIELDS);
+                    o.pack(r.senderId);
+                    o.pack(r.seq);
+                    o.pack(r.timestampNs);
+                    o.pack(r.payload);
+                    return o;
+                }
+            };
+
+        } // namespace adaptor
+    } // MSGPACK_API_VERSION_NAMESPACE(MSGPACK_DEFAULT_API_NS)
+} // namespace msgpack
+
+typedef FixedBuffer<NGPS_ENVELOPE_MAX_PACKED_SIZE> NgpsEnvelopeBuffer;
+
+typedef enum SequenceStatus
+{
+    SEQUENCE_IN_ORDER = 0,      /**< The next expected sequence; released immediately */
+    SEQUENCE_BUFFERED,          /**< Ahead of a gap; held until the gap fills or times out */
+    SEQUENCE_DUPLICATE,         /**< Already released or already held */
+    SEQUENCE_STALE,             /**< Behind the window, or its gap was already given up as lost */
+    SEQUENCE_RESYNC             /**< Sender restarted; stream state reset to this datagram */
+} SequenceStatus;
+
+struct SequenceStats
+{
+    unsigned long delivered = 0;    /**< Records released in sequence order */
+    unsigned long lost = 0;         /**< Sequence numbers skipped because they never arrived in time */
+    unsigned long reordered = 0;    /**< Arrived with a lower sequence than one already seen */
+    unsigned long duplicates = 0;
+    unsigned long stale = 0;
+    unsigned long resyncs = 0;
+};
+
+/**
+ * Per-sender reorder window. Records are released strictly in sequence order, so an older
+ * position can never be released after a newer one from the same sender. A record that arrives
+ * ahead of a gap is held in a ring of REORDER_WINDOW slots; the gap is given up as lost when a
+ * record arrives too far ahead to be held, or when expire() finds it older than holdTimeout.
+ * Duplicates and stale records are rejected with a slot lookup and a 64-bit history mask.
+ * A sequence behind the window is a sender restart, not a stale record, when it is stamped later
+ * than any record seen so far or lies more than REORDER_RESYNC_DISTANCE behind.
+ *
+ * out passed to push() and expire() must have room for REORDER_WINDOW records.
+ */
+class ReorderBuffer
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    explicit ReorderBuffer(std::chrono::microseconds holdTimeout = std::chrono::microseconds(5000));
+
+    /* Accept one record; any records it makes releasable are written to out and counted in *released */
+    SequenceStatus push(const NgpsEnvelope &env, Clock::time_point now, NgpsEnvelope *out, unsigned int *released);
+
+    /* Give up the current gap if it has been open for holdTimeout. Returns records written to out */
+    unsigned int expire(Clock::time_point now, NgpsEnvelope *out);
+
+    unsigned int held() const { return heldCount; }
+    const SequenceStats &stats() const { return counters; }
+
+private:
+    struct Slot
+    {
+        SysBool full = FALSE;
+        NgpsEnvelope env;
+    };
+
+    void reset(uint32_t seq, uint64_t timestampNs);
+    void advance(NgpsEnvelope *out, unsigned int &released);
+    void drain(NgpsEnvelope *out, unsigned int &released);
+
+    std::chrono::microseconds holdTimeout;
+    Slot slots[REORDER_WINDOW];
+    SysBool started = FALSE;
+    uint32_t next = 0;              /* next sequence to release */
+    uint32_t highest = 0;           /* highest sequence seen */
+    uint64_t newestNs = 0;          /* latest sender timestamp seen */
+    uint64_t history = 0;           /* bit i set: sequence next - 1 - i was released */
+    unsigned int heldCount = 0;
+    Clock::time_point gapSince;
+    SequenceStats counters;
+};
+
+/**
+ * Stamps each ngps_output with this sender's id, the next sequence number and the current time,
+ * and sends it as one NgpsEnvelope datagram.
+ */
+class UdpSequencedSender
+{
+public:
+    UdpSequencedSender(int sockfd, const sockaddr_in &dest, UShort senderId);
+
+    /* Returns RETURN_SUCCESS or RETURN_FAILURE. A failed send still consumes its sequence number */
+    int send(const ngps_output &msg);
+
+    uint32_t nextSeq() const { return seq; }
+
+private:
+    int sockfd;
+    sockaddr_in dest;
+    UShort senderId;
+    uint32_t seq = 0;
+    NgpsEnvelopeBuffer buffer;
+};
+
+/**
+ * Receives NgpsEnvelope datagrams from any number of senders and releases their records in
+ * per-sender sequence order through one ReorderBuffer per sender id. Bare ngps_output datagrams
+ * are passed through unsequenced with senderId 0 and seq 0.
+ */
+class UdpSequencedReceiver
+{
+public:
+    explicit UdpSequencedReceiver(int sockfd,
+                                  std::chrono::microseconds timeout = std::chrono::microseconds(1000),
+                                  std::chrono::microseconds holdTimeout = std::chrono::microseconds(5000));
+
+    /**
+     * Return up to max released records, receiving datagrams (waiting up to timeout for the first)
+     * and expiring open gaps if none are ready. Returns the number of records written to out,
+     * 0 on timeout, or RETURN_FAILURE.
+     */
+    int receive(NgpsEnvelope *out, unsigned int max);
+
+    /* Counters summed over all senders */
+    SequenceStats stats() const;
+    unsigned long decodeErrors() const { return errors; }
+
+private:
+    int recvDatagram(SysBool wait);
+    void expireAll();
+
+    int sockfd;
+    std::chrono::microseconds timeout;
+    std::chrono::microseconds holdTimeout;
+    std::unordered_map<UShort, ReorderBuffer> streams;
+    std::vector<NgpsEnvelope> ready;    /* released, not yet returned: from readyHead on */
+    size_t readyHead = 0;
+    NgpsEnvelope released[REORDER_WINDOW];
+    UnpackArena arena;
+    unsigned long errors = 0;
+};
+
+#endif //UDPSEQUENCE_H
@@ -0,0 +1,218 @@
+#include <errno.h>
+#include <stdio.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "udpServer.h"
+#include "instrument.h"
+
+UdpServer::UdpServer(const UdpServerConfig &config, EdgeStateTable &table) :
+        config(config),
+        table(table),
+        workers(config.workers)
+{
+    for (unsigned int i = 0; i < workers.size(); ++i) {
+        workers[i].validator.setLimits(config.limits);
+    }
+}
+
+UdpServer::~UdpServer()
+{
+    stop();
+}
+
+int UdpServer::start()
+{
+    uint16_t port = config.port;
+
+    for (unsigned int i = 0; i < workers.size(); ++i) {
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0) {
+            perror("socket creation failed");
+            stop();
+            return RETURN_FAILURE;
+        }
+        int one = 1;
+        if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+            perror("SO_REUSEPORT failed");
+            close(fd);
+            stop();
+            return RETURN_FAILURE;
+        }
+        SocketTuning tuning = config.tuning;
+        tuning.timestamps = FALSE;
+        tuning.dropCounter = FALSE;
+        SocketTuningReport granted;
+        if (tuneSocket(fd, tuning, &granted) != RETURN_SUCCESS && i == 0) {
+            fprintf(stderr, "socket tuning partly refused: SO_RCVBUF %d SO_SNDBUF %d busy poll %s\n",
+                    granted.receiveBuffer, granted.sendBuffer, granted.busyPoll ? "on" : "off");
+        }
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = INADDR_ANY;
+        addr.sin_port = htons(port);
+        if (bind(fd, (const struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            perror("bind failed");
+            close(fd);
+            stop();
+            return RETURN_FAILURE;
+        }
+
+        // With port 0 the first socket picks an ephemeral port and the others join it
+        socklen_t len = sizeof(addr);
+        getsockname(fd, (struct sockaddr *)&addr, &len);
+        port = ntohs(addr.sin_port);
+
+        workers[i].sockfd = fd;
+    }
+    boundPort = port;
+
+    running = true;
+    for (unsigned int i = 0; i < workers.size(); ++i) {
+        workers[i].thread = std::thread(&UdpServer::run, this, i);
+    }
+    return RETURN_SUCCESS;
+}
+
+void UdpServer::stop()
+{
+    running = false;
+    for (unsigned int i = 0; i < workers.size(); ++i) {
+        if (workers[i].thread.joinable()) {
+            workers[i].thread.join();
+        }
+        if (workers[i].sockfd >= 0) {
+            close(workers[i].sockfd);
+            workers[i].sockfd = -1;
+        }
+    }
+}
+
+unsigned long UdpServer::decoded() const
+{
+    unsigned long total = 0;
+    for (unsigned int i = 0; i < workers.size(); ++i) {
+        total += workers[i].decoded.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+unsigned long UdpServer::decodeErrors() const
+{
+    unsigned long total = 0;
+    for (unsigned int i = 0; i < workers.size(); ++i) {
+        total += workers[i].errors.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+unsigned long UdpServer::rejects(NgpsReject reason) const
+{
+    unsigned long total = 0;
+    for (unsigned int i = 0; i < workers.size(); ++i) {
+        total += workers[i].validator.count(reason);
+    }
+    return total;
+}
+
+void UdpServer::run(unsigned int index)
+{
+    Worker &worker = workers[index];
+    const unsigned int batch = config.batchSize;
+
+    if (config.pinCores) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(index % (unsigned int)sysconf(_SC_NPROCESSORS_ONLN), &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+
+    std::vector<char> buffers((size_t)batch * MAXLINE);
+    std::vector<iovec> iovecs(batch);
+    std::vector<sockaddr_in> peers(batch);
+    std::vector<mmsghdr> headers(batch);
+
+    struct pollfd pfd;
+    pfd.fd = worker.sockfd;
+    pfd.events = POLLIN;
+
+    // Wake up periodically so stop() is noticed even when no traffic arrives
+    struct timespec idle;
+    idle.tv_sec = 0;
+    idle.tv_nsec = 100 * 1000 * 1000;
+
+    while (running.load(std::memory_order_relaxed)) {
+        for (unsigned int i = 0; i < batch; ++i) {
+            iovecs[i].iov_base = &buffers[(size_t)i * MAXLINE];
+            iovecs[i].iov_len = MAXLINE;
+            memset(&headers[i].msg_hdr, 0, sizeof(headers[i].msg_hdr));
+            headers[i].msg_hdr.msg_name = &peers[i];
+            headers[i].msg_hdr.msg_namelen = sizeof(peers[i]);
+            headers[i].msg_hdr.msg_iov = &iovecs[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        INSTRUMENT(uint64_t t0 = instrNow());
+        int n = recvmmsg(worker.sockfd, headers.data(), batch, MSG_DONTWAIT, NULL);
+        if (n <= 0) {
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("recvmmsg failed");
+                return;
+            }
+            pfd.revents = 0;
+            ppoll(&pfd, 1, &idle, NULL);
+            continue;
+        }
+
+        INSTRUMENT(instrStage(STAGE_RECV, t0));
+
+        uint64_t receivedNs = 0;
+        if (kinematics != NULL) {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            receivedNs = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+        }
+        unsigned long decoded = 0;
+        unsigned long errors = 0;
+        for (int i = 0; i < n; ++i) {
+            ngps_output msg;
+            INSTRUMENT(uint64_t t1 = instrNow());
+            if (!(headers[i].msg_hdr.msg_flags & MSG_TRUNC) &&
+                worker.validator.check((const char *)iovecs[i].iov_base, headers[i].msg_len, &msg) == NGPS_ACCEPT) {
+                INSTRUMENT(instrStage(STAGE_DECODE, t1));
+                table.update(msg);
+                if (kinematics != NULL) {
+                    kinematics->update(msg, receivedNs);
+                }
+                if (positions != NULL) {
+                    positions->update(trainKey(peers[i]), msg);
+                }
+                ++decoded;
+            }
+            else {
+                INSTRUMENT(instrCount((headers[i].msg_hdr.msg_flags & MSG_TRUNC) ? COUNTER_TRUNCATED
+                                                                                 : COUNTER_DECODE_ERRORS));
+                ++errors;
+            }
+            iovecs[i].iov_len = headers[i].msg_len;
+        }
+        worker.decoded.fetch_add(decoded, std::memory_order_relaxed);
+        worker.errors.fetch_add(errors, std::memory_order_relaxed);
+        INSTRUMENT(instrCount(COUNTER_MESSAGES, decoded));
+
+        if (config.echo) {
+            // The receive headers already hold each peer address and payload length
+            INSTRUMENT(uint64_t t2 = instrNow());
+            sendmmsg(worker.sockfd, headers.data(), (unsigned int)n, 0);
+            INSTRUMENT(instrStage(STAGE_SEND, t2));
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef UDPSERVER_H
+#define UDPSERVER_H
+
+#include <stdint.h>
+#include <netinet/in.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "ngpsOutput.h"
+#include "edgeStateTable.h"
+#include "kinematicCache.h"
+#include "positionIndex.h"
+#include "socketTuning.h"
+#include "ngpsValidator.h"
+
+struct UdpServerConfig
+{
+    uint16_t port = PORT;
+    unsigned int workers = 1;
+    SysBool pinCores = TRUE;        /* pin worker i to CPU (i % online CPUs) */
+    SysBool echo = TRUE;            /* echo every datagram back to its sender, as main.cpp expects */
+    unsigned int batchSize = 32;    /* datagrams per recvmmsg */
+    SocketTuning tuning;            /* buffer sizes and busy poll; workers do not read timestamps or drop counts */
+    NgpsLimits limits;              /* datagrams outside these are rejected (see NgpsValidator) */
+};
+
+/**
+ * Receive side for ngps_output traffic. Each worker thread owns its own SO_REUSEPORT socket on
+ * the same port, so the kernel spreads senders across workers without a shared queue. Workers
+ * screen and decode with an NgpsValidator (rejects are counted by reason, see rejects()) and
+ * publish into one shared EdgeStateTable and, if one is attached, a KinematicCache stamped with
+ * the CLOCK_MONOTONIC time each batch was received, and a PositionIndex keyed by the train a
+ * TrainKey maps each sender address to.
+ */
+class UdpServer
+{
+public:
+    /* Train reporting from a sender address; each sender always lands on one worker (SO_REUSEPORT) */
+    typedef TrainId (*TrainKey)(const sockaddr_in &from);
+
+    explicit UdpServer(const UdpServerConfig &config, EdgeStateTable &table);
+    ~UdpServer();
+
+    /* Open the worker sockets and start the threads. Returns RETURN_SUCCESS or RETURN_FAILURE */
+    int start();
+    void stop();
+
+    /* Also feed decoded reports to cache (NULL to detach). Call before start() */
+    void attach(KinematicCache *cache) { kinematics = cache; }
+
+    /* Also index decoded reports by train (NULL to detach). Call before start() */
+    void attach(PositionIndex *index, TrainKey key)
+    {
+        positions = index;
+        trainKey = key;
+    }
+
+    /* Port actually bound (useful when config.port is 0) */
+    uint16_t port() const { return boundPort; }
+
+    unsigned long decoded() const;
+    unsigned long decodeErrors() const;
+
+    /* Datagrams rejected for reason, summed over the workers */
+    unsigned long rejects(NgpsReject reason) const;
+
+private:
+    struct Worker
+    {
+        int sockfd = -1;
+        std::thread thread;
+        std::atomic<unsigned long> decoded{0};
+        std::atomic<unsigned long> errors{0};
+        NgpsValidator validator;
+    };
+
+    void run(unsigned int index);
+
+    UdpServerConfig config;
+    EdgeStateTable &table;
+    KinematicCache *kinematics = NULL;
+    PositionIndex *positions = NULL;
+    TrainKey trainKey = NULL;
+    std::vector<Worker> workers;
+    std::atomic<bool> running{false};
+    uint16_t boundPort = 0;
+};
+
+#endif //UDPSERVER_H
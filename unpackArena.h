@@ -0,0 +1,51 @@
+#ifndef UNPACKARENA_H
+#define UNPACKARENA_H
+
+#include <stddef.h>
+#include <msgpack.hpp>
+#include "ngpsOutput.h"
+
+/**
+ * Reusable msgpack::zone for decoding one datagram at a time. msgpack::unpack(data, size) creates
+ * a zone for every object_handle and frees it when the handle goes out of scope: two or more heap
+ * calls per datagram. An UnpackArena keeps one zone for its owner's lifetime and clears it before
+ * each unpack, so the previous object is released and its memory reused.
+ *
+ * The first chunk is sized for the worst case of a MAXLINE datagram (one msgpack::object per byte,
+ * plus copied str/bin bytes and alignment), so any datagram the receivers accept decodes without
+ * touching the allocator. Not thread-safe: one arena per receiver, and a receiver per thread.
+ */
+
+#define UNPACK_ARENA_CHUNK_SIZE (MAXLINE * (sizeof(msgpack::object) + 1) * 2)
+
+class UnpackArena
+{
+public:
+    UnpackArena() : zone(UNPACK_ARENA_CHUNK_SIZE) {}
+
+    UnpackArena(const UnpackArena &) = delete;
+    UnpackArena &operator=(const UnpackArena &) = delete;
+
+    /**
+     * Unpack one object, invalidating the object returned by the previous call. Throws what
+     * msgpack::unpack throws on malformed input.
+     */
+    msgpack::object unpack(const char *data, size_t size)
+    {
+        zone.clear();
+        return msgpack::unpack(zone, data, size);
+    }
+
+    /* As above, advancing off past the object so bytes after it can be detected, within limit */
+    msgpack::object unpack(const char *data, size_t size, size_t &off,
+                           const msgpack::unpack_limit &limit = msgpack::unpack_limit())
+    {
+        zone.clear();
+        return msgpack::unpack(zone, data, size, off, NULL, NULL, limit);
+    }
+
+private:
+    msgpack::zone zone;
+};
+
+#endif //UNPACKARENA_H